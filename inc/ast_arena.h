@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+#include <memory_resource>
+
+namespace pparse {
+
+//
+// Ast_arena - memory resource for the AST nodes of a parse, with mark/release: memory is allocated by bumping a pointer in a list of chunks,
+// release rewinds the arena to a mark that has been taken before. PAny and PSeq take a mark when they start, and rewind to it if the rule fails,
+// so that the nodes of a failed attempt are reclaimed at once (see ParserBase::set_arena)
+//
+// deallocate does nothing; memory is reclaimed by release (or reset), the chunks are kept for the next allocations and are freed with the arena.
+//
+
+class Ast_arena : public std::pmr::memory_resource {
+public:
+	struct Mark {
+		size_t chunk_;
+		size_t offset_;
+	};
+
+	Ast_arena(size_t chunk_size = 64 * 1024, std::pmr::memory_resource *upstream = std::pmr::new_delete_resource()) : chunk_size_(chunk_size), upstream_(upstream), current_(0), offset_(0) {
+	}
+
+	Ast_arena(const Ast_arena &) = delete;
+	Ast_arena &operator=(const Ast_arena &) = delete;
+
+	~Ast_arena() {
+		for(auto &chunk : chunks_) {
+			upstream_->deallocate(chunk.data_, chunk.size_, alignof(std::max_align_t));
+		}
+	}
+
+	Mark mark() const {
+		return Mark{ current_, offset_ };
+	}
+
+	// free everything that has been allocated after the mark was taken; the objects in this memory must have been destroyed, or must not be used any more.
+	void release(Mark mark) {
+		current_ = mark.chunk_;
+		offset_ = mark.offset_;
+	}
+
+	void reset() {
+		release( Mark{0, 0} );
+	}
+
+	// number of bytes up to the current allocation position (including the unused ends of the chunks before the current one)
+	size_t bytes_in_use() const {
+		size_t ret = offset_;
+		for(size_t i = 0; i < current_ && i < chunks_.size(); ++i) {
+			ret += chunks_[i].size_;
+		}
+		return ret;
+	}
+
+protected:
+	void *do_allocate(size_t bytes, size_t alignment) override {
+
+		for(;;) {
+			if (current_ < chunks_.size()) {
+				size_t offset = (offset_ + alignment - 1) & ~(alignment - 1);
+				if (offset + bytes <= chunks_[ current_ ].size_) {
+					offset_ = offset + bytes;
+					return chunks_[ current_ ].data_ + offset;
+				}
+				if (offset_ != 0 || current_ + 1 < chunks_.size()) {
+					current_ += 1;
+					offset_ = 0;
+					continue;
+				}
+			}
+
+			// the current chunk is empty and too small, or there are no more chunks: replace it with a chunk that is big enough.
+			size_t size = std::max( chunk_size_, bytes + alignment );
+			Chunk chunk{ (char *) upstream_->allocate(size, alignof(std::max_align_t)), size };
+			if (current_ < chunks_.size()) {
+				upstream_->deallocate(chunks_[ current_ ].data_, chunks_[ current_ ].size_, alignof(std::max_align_t));
+				chunks_[ current_ ] = chunk;
+			} else {
+				chunks_.push_back(chunk);
+			}
+			offset_ = 0;
+		}
+	}
+
+	void do_deallocate(void *, size_t, size_t) override {
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &arg) const noexcept override {
+		return this == &arg;
+	}
+
+private:
+	struct Chunk {
+		char *data_;
+		size_t size_;
+	};
+
+	size_t chunk_size_;
+	std::pmr::memory_resource *upstream_;
+	std::vector<Chunk> chunks_;
+	size_t current_;
+	size_t offset_;
+};
+
+} // namespace pparse
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include "parsedef.h"
+
+namespace pparse {
+
+//
+// Parse_event - event of the Event_parser, that is buffered until it can't be undone by backtracking.
+//
+
+struct Parse_event {
+	enum class Kind {
+		enter,		// a rule starts parsing (start_ is the position before the whitespace)
+		exit,		// the rule has been parsed
+		token,		// a PTok or PTokVar has been parsed, text is the token
+		discard,	// the rule has failed: the events of the rule have been dropped (end_ is the error position)
+	};
+
+	Kind kind_;
+	RuleId rule_;
+	Position start_;
+	Position end_;
+	size_t text_offset_;	// text of a token event in the text buffer of the Event_parser
+	size_t text_size_;
+};
+
+//
+// Event_parser - base parser that reports the parse as a sequence of events to a Visitor, instead of building the AST (SAX style).
+//
+// Base is the base parser that reads the text (CharParser, MemoryCharParser, Token_parser ...). The Visitor has the functions
+//
+//		void on_enter(RuleId rule, Position start);
+//		void on_exit(RuleId rule, Position start, Position end);
+//		void on_token(RuleId rule, Position start, Position end, std::string_view text);
+//		void on_discard(RuleId rule, Position start, Position end);
+//
+// The combinators (PAny, PSeq, POpt, PRepeat, PPrecedence) report enter and exit, the tokens are reported between them; if a rule fails then
+// its events are dropped, and a discard event takes their place. The events are buffered and passed to the visitor once they can't be dropped any more:
+// when the parser can no longer backtrack (a PCut), and when the top level rule returns. With a PCut after each record the buffer stays small,
+// so that a huge input can be converted in one pass, in bounded memory. A rule that fails after a PCut is a syntax error: the events up to the
+// error have been passed on, and are followed by the discard events of the rules that fail.
+//
+// The packrat memo is not used (a memoized result doesn't have the events of the rule); left recursive rules are not supported.
+//
+
+template<typename Base, typename Visitor>
+struct Event_parser : Base {
+
+		static inline const bool emit_events = true;
+
+		template<typename Stream>
+		Event_parser(Stream &stream, Visitor &visitor) : Base(stream), visitor_(visitor), committed_(0), depth_(0), max_buffered_(0) {
+				this->build_ast_ = false;
+		}
+
+		// the events that have been passed to the visitor and the buffered events; the events after a mark are dropped if the rule fails.
+		size_t event_mark() const {
+				return committed_ + events_.size();
+		}
+
+		void enter_rule(RuleId rule, Position start) {
+				add( Parse_event{ Parse_event::Kind::enter, rule, start, start, text_.size(), 0 } );
+				depth_ += 1;
+		}
+
+		void exit_rule(RuleId rule, Position start, Position end) {
+				add( Parse_event{ Parse_event::Kind::exit, rule, start, end, text_.size(), 0 } );
+				leave_rule();
+		}
+
+		void discard_rule(size_t mark, RuleId rule, Position start, Position end) {
+				drop_after(mark);
+				add( Parse_event{ Parse_event::Kind::discard, rule, start, end, text_.size(), 0 } );
+				leave_rule();
+		}
+
+		void token(RuleId rule, Position start, Position end, std::string_view text) {
+				add( Parse_event{ Parse_event::Kind::token, rule, start, end, text_.size(), text.size() } );
+				text_.append( text.data(), text.size() );
+				if (depth_ == 0) {
+					commit();
+				}
+		}
+
+		// a lookahead may still drop the events: they are held back, even outside of a rule, until release_events is called.
+		size_t hold_events() {
+				depth_ += 1;
+				return event_mark();
+		}
+
+		// drop the held back events after the mark
+		void release_events(size_t mark) {
+				drop_after(mark);
+				leave_rule();
+		}
+
+		// pass the buffered events to the visitor
+		void commit() {
+				for(auto &event : events_) {
+					switch(event.kind_) {
+						case Parse_event::Kind::enter:
+							visitor_.on_enter(event.rule_, event.start_);
+							break;
+						case Parse_event::Kind::exit:
+							visitor_.on_exit(event.rule_, event.start_, event.end_);
+							break;
+						case Parse_event::Kind::token:
+							visitor_.on_token(event.rule_, event.start_, event.end_, std::string_view( text_.data() + event.text_offset_, event.text_size_ ));
+							break;
+						case Parse_event::Kind::discard:
+							visitor_.on_discard(event.rule_, event.start_, event.end_);
+							break;
+					}
+				}
+				committed_ += events_.size();
+				events_.clear();
+				text_.clear();
+		}
+
+		// the largest number of events that have been buffered
+		size_t max_buffered() const {
+				return max_buffered_;
+		}
+
+		// after a cut the parser can't backtrack before the cursor: the events up to here are final.
+		static inline void cut(Event_parser &parser) {
+				Base::cut(parser);
+				parser.commit();
+		}
+
+private:
+		void add(const Parse_event &event) {
+				events_.push_back(event);
+				if (events_.size() > max_buffered_) {
+					max_buffered_ = events_.size();
+				}
+		}
+
+		void leave_rule() {
+				depth_ -= 1;
+				if (depth_ == 0) {
+					commit();
+				}
+		}
+
+		// drop the buffered events after the mark; if the enter event of the rule has been passed to the visitor, then the rule has failed after a cut:
+		// that's an error, the events up to the error are kept.
+		void drop_after(size_t mark) {
+				if (mark < committed_) {
+					return;
+				}
+				size_t keep = mark - committed_;
+				if (keep < events_.size()) {
+					text_.resize( events_[ keep ].text_offset_ );
+					events_.resize(keep);
+				}
+		}
+
+		Visitor &visitor_;
+		std::vector<Parse_event> events_;
+		std::string text_;
+		size_t committed_;
+		int depth_;
+		size_t max_buffered_;
+};
+
+//
+// Event_rule - parse a rule with the Event_parser: the enter event, the events of the rule, then the exit event (or the discard event if the rule fails)
+//
+
+template<typename Type>
+struct Event_rule {
+
+	template<typename ParserBase>
+	static Parse_result parse(ParserBase &base, Parse_result (*parse_rule)(ParserBase &)) {
+
+		size_t mark = base.event_mark();
+		Position start = Position( ParserBase::current_pos(base) );
+
+		base.enter_rule(Type::RULE_ID, start);
+
+		Parse_result res = parse_rule(base);
+		if (res.success_) {
+			base.exit_rule(Type::RULE_ID, res.start_, res.end_);
+		} else {
+			base.discard_rule(mark, Type::RULE_ID, start, res.start_);
+		}
+		return res;
+	}
+};
+
+} // namespace pparse
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <set>
+#include <typeinfo>
+#include <type_traits>
+#include <utility>
+
+namespace pparse {
+
+//
+// First_set - the characters that the input accepted by a rule can start with (after the whitespace has been skipped),
+// and if the rule can succeed without consuming any input (nullable). PAny uses the first sets of its alternatives to skip the alternatives that can't start with the next character.
+//
+
+struct First_set {
+
+	First_set() : bits_{0, 0, 0, 0}, nullable_(false) {
+	}
+
+	// the first set of a rule that can't be analysed: it may start with any character.
+	static First_set any() {
+		First_set ret;
+		ret.bits_[0] = ret.bits_[1] = ret.bits_[2] = ret.bits_[3] = ~(uint64_t) 0;
+		ret.nullable_ = true;
+		return ret;
+	}
+
+	void add(unsigned char ch) {
+		bits_[ ch >> 6 ] |= (uint64_t) 1 << (ch & 63);
+	}
+
+	// union with the first set of another rule
+	void add(const First_set &arg) {
+		for(int i = 0; i < 4; ++i) {
+			bits_[i] |= arg.bits_[i];
+		}
+		nullable_ = nullable_ || arg.nullable_;
+	}
+
+	bool has(unsigned char ch) const {
+		return (bits_[ ch >> 6 ] & ((uint64_t) 1 << (ch & 63))) != 0;
+	}
+
+	uint64_t bits_[4];
+	bool nullable_;
+};
+
+// the rules that are being analysed; a rule that refers to itself before consuming any input (left recursion) is taken as First_set::any()
+using First_set_path = std::set<const std::type_info *>;
+
+template<typename Type, typename = void>
+struct Has_first_set : std::false_type {
+};
+
+template<typename Type>
+struct Has_first_set<Type, std::void_t< decltype( Type::first_set( std::declval<First_set_path &>() ) ) > > : std::true_type {
+};
+
+// first set of the rule Type; a rule that doesn't have a first_set function (like a parser written by the user) may start with any character.
+template<typename Type>
+First_set first_set_of(First_set_path &path) {
+
+	if constexpr (Has_first_set<Type>::value) {
+		if (path.insert( &typeid(Type) ).second) {
+			First_set ret = Type::first_set(path);
+			path.erase( &typeid(Type) );
+			return ret;
+		}
+	}
+	return First_set::any();
+}
+
+} // namespace pparse
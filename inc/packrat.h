@@ -0,0 +1,292 @@
+#pragma once
+
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include "parsedef.h"
+
+namespace pparse {
+
+//
+// Packrat memoization table.
+//
+// The result of parsing a rule at a given offset is stored per (rule, offset) - the rule is identified by the address of a static member
+// of Packrat_rule<RuleType>, the offset is Text_position::buffer_pos_ of the start position.
+//
+// The table is a sliding window over the lookahead buffer of the text stream: there is one slot for each offset in the window,
+// slots that are before the head of the text stream are evicted once the stream has moved on, so memory stays bounded by the size of the lookahead window.
+//
+// Left recursion (Expr : PAny<1, PSeq<2, Expr, Add, MultExpr>, MultExpr>) is supported by growing the seed (A. Warth et al, Packrat parsers can support left recursion):
+// a rule that is being parsed has an entry that is in progress, a recursive call at the same offset gets the result of the previous round (the seed), initially a failure.
+// If the rule turned out to be left recursive then it is parsed again, as long as the result gets longer; so a chain of operators is parsed in a loop, and the AST leans to the left.
+//
+// The table is keyed on the generation of the text stream as well, it is cleared when the parser is used with a stream that has been opened again.
+//
+// While the parser only recognizes the input (ParserBase::build_ast_ is false) a successful entry is a hit, with or without ast; the ast of the entry is left in the table.
+//
+
+using Packrat_key = const void *;
+
+struct Packrat_entry {
+	Packrat_key rule_;
+	bool success_;
+	Position start_;
+	Position end_;
+	Text_position end_pos_;
+	std::unique_ptr<AstEntryBase> ast_;
+	bool in_progress_ = false;		// the rule is being parsed at this offset
+	bool left_recursive_ = false;	// the rule has called itself at the same offset, while in progress
+};
+
+class Packrat_memo {
+public:
+	using Slot = std::vector<Packrat_entry>;
+
+	Packrat_memo() : window_start_(0), generation_(0), hits_(0), misses_(0) {
+	}
+
+	// the positions of the entries are positions in the text of one generation of the stream: if the stream has been opened again, then the entries are dropped.
+	void check_generation(uint32_t generation) {
+		if (generation != generation_) {
+			clear();
+			generation_ = generation;
+		}
+	}
+
+	Packrat_entry *find(Packrat_key rule, FilePos_t pos) {
+		if (pos < window_start_ || (size_t) (pos - window_start_) >= slots_.size()) {
+			return nullptr;
+		}
+		for(auto &entry : slots_[ pos - window_start_ ]) {
+			if (entry.rule_ == rule) {
+				return &entry;
+			}
+		}
+		return nullptr;
+	}
+
+	void store(FilePos_t pos, Packrat_entry &&entry) {
+		if (pos < window_start_) {
+			return;
+		}
+		size_t index = pos - window_start_;
+		if (index >= slots_.size()) {
+			slots_.resize(index + 1);
+		}
+		for(auto &slot_entry : slots_[ index ]) {
+			if (slot_entry.rule_ == entry.rule_) {
+				// the seed of a rule in progress is replaced (a seed that is given back), the rule stays in progress.
+				if (slot_entry.in_progress_) {
+					entry.in_progress_ = true;
+					entry.left_recursive_ = entry.left_recursive_ || slot_entry.left_recursive_;
+				}
+				slot_entry = std::move(entry);
+				return;
+			}
+		}
+		slots_[ index ].push_back( std::move(entry) );
+	}
+
+	// discard all entries before the argument position (that's the position of the head of the text stream)
+	void evict_before(FilePos_t head) {
+		if (head <= window_start_) {
+			return;
+		}
+		size_t to_drop = head - window_start_;
+		if (to_drop >= slots_.size()) {
+			slots_.clear();
+		} else {
+			slots_.erase(slots_.begin(), slots_.begin() + to_drop);
+		}
+		window_start_ = head;
+	}
+
+	void clear() {
+		slots_.clear();
+		window_start_ = 0;
+	}
+
+	size_t window_size() const {
+		return slots_.size();
+	}
+
+	size_t hits() const {
+		return hits_;
+	}
+
+	size_t misses() const {
+		return misses_;
+	}
+
+	// true if a left recursive rule is grown at the offset: the results of the previous round at this offset may depend on the seed, they are not used.
+	bool is_growing(FilePos_t pos) const {
+		return std::find(growing_.begin(), growing_.end(), pos) != growing_.end();
+	}
+
+private:
+	template<typename Type>
+	friend struct Packrat_rule;
+
+	std::deque<Slot> slots_;
+	std::vector<FilePos_t> growing_;
+	FilePos_t window_start_;
+	uint32_t generation_;
+	size_t hits_;
+	size_t misses_;
+};
+
+//
+// Is_packrat_rule - true if the parser type is memoized in packrat mode (the parser defines a type Packrat_type)
+//
+
+template<typename Type, typename = void>
+struct Is_packrat_rule : std::false_type {
+};
+
+template<typename Type>
+struct Is_packrat_rule<Type, std::void_t<typename Type::Packrat_type>> : std::true_type {
+};
+
+//
+// Packrat_rule - memoized invocation of the parse function of rule Type.
+//
+
+template<typename Type>
+struct Packrat_rule {
+
+	static inline const char key_ = 0;
+
+	template<typename ParserBase>
+	static Parse_result parse(ParserBase &base, Parse_result (*parse_rule)(ParserBase &)) {
+
+		Packrat_memo *memo = base.packrat_memo_.get();
+
+		memo->check_generation( ParserBase::generation(base) );
+		memo->evict_before( ParserBase::pos_at_head(base) );
+
+		Text_position start_pos = ParserBase::current_pos(base);
+
+		Packrat_entry *entry = memo->find( &key_, start_pos.buffer_pos_ );
+		if (entry != nullptr && entry->in_progress_) {
+			// left recursion: the rule calls itself at the same offset, that's the seed of the previous round.
+			memo->hits_ += 1;
+			entry->left_recursive_ = true;
+			if (entry->success_ && (entry->ast_ != nullptr || !base.build_ast_)) {
+				return hit(base, entry);
+			}
+			return Parse_result{false, entry->start_, entry->end_ };
+		}
+
+		if (entry != nullptr && !memo->is_growing(start_pos.buffer_pos_)) {
+			if (!entry->success_) {
+				memo->hits_ += 1;
+				return Parse_result{false, entry->start_, entry->end_ };
+			}
+			// the ast of a successful entry can be handed out once; after that the rule has to be parsed again (unless the parser doesn't need the ast).
+			if (entry->ast_ != nullptr || !base.build_ast_) {
+				memo->hits_ += 1;
+				return hit(base, entry);
+			}
+		}
+
+		memo->misses_ += 1;
+
+		memo->store( start_pos.buffer_pos_, Packrat_entry{ &key_, false, start_pos, start_pos, start_pos, nullptr, true, false } );
+
+		Parse_result res = parse_rule(base);
+
+		// (entries are looked up again, the parse may have added entries to the same slot)
+		entry = memo->find( &key_, start_pos.buffer_pos_ );
+		if (res.success_ && entry != nullptr && entry->left_recursive_) {
+			memo->growing_.push_back( start_pos.buffer_pos_ );
+			res = grow_seed(base, parse_rule, start_pos, std::move(res), -1);
+			memo->growing_.pop_back();
+
+			entry = memo->find( &key_, start_pos.buffer_pos_ );
+		}
+
+		if (entry != nullptr) {
+			// a successful entry without ast: the next attempt parses the rule again.
+			entry->in_progress_ = false;
+			entry->left_recursive_ = false;
+			entry->success_ = res.success_;
+			entry->start_ = res.start_;
+			entry->end_ = res.end_;
+			entry->end_pos_ = ParserBase::current_pos(base);
+			entry->ast_.reset();
+		}
+		return res;
+	}
+
+	// A rule has been parsed successfully, but the enclosing sequence failed: keep the ast in the table, for the next attempt to parse the same rule at the same offset.
+	template<typename ParserBase, typename AstType>
+	static void give_back(ParserBase &base, Text_position start_pos, Text_position end_pos, const Parse_result &res, std::unique_ptr<AstType> &ast) {
+
+		if (ast == nullptr) {
+			return;
+		}
+		base.packrat_memo_->store( start_pos.buffer_pos_, Packrat_entry{ &key_, true, res.start_, res.end_, end_pos, std::unique_ptr<AstEntryBase>( ast.release() ) } );
+	}
+
+private:
+	// the result of a successful entry: the ast is handed out, if the parser builds one.
+	template<typename ParserBase>
+	static Parse_result hit(ParserBase &base, Packrat_entry *entry) {
+		ParserBase::seek(base, entry->end_pos_);
+		if (!base.build_ast_) {
+			return Parse_result{true, entry->start_, entry->end_ };
+		}
+		return Parse_result{true, entry->start_, entry->end_, std::move(entry->ast_) };
+	}
+
+	// parse a left recursive rule again, with the result of the previous round as seed, until the result doesn't get longer.
+	// if replay_to is not -1: the rounds are repeated until the seed reaches this offset.
+	template<typename ParserBase>
+	static Parse_result grow_seed(ParserBase &base, Parse_result (*parse_rule)(ParserBase &), Text_position start_pos, Parse_result res, FilePos_t replay_to) {
+
+		Packrat_memo *memo = base.packrat_memo_.get();
+
+		for(;;) {
+			Text_position seed_end = ParserBase::current_pos(base);
+			if (replay_to != -1 && seed_end.buffer_pos_ >= replay_to) {
+				return res;
+			}
+
+			memo->store( start_pos.buffer_pos_, Packrat_entry{ &key_, true, res.start_, res.end_, seed_end, std::move(res.ast_), true, true } );
+			ParserBase::seek(base, start_pos);
+
+			Parse_result next = parse_rule(base);
+			if (next.success_ && ParserBase::current_pos(base).buffer_pos_ > seed_end.buffer_pos_) {
+				res = std::move(next);
+				continue;
+			}
+
+			// the result didn't get longer: the seed is the result.
+			Packrat_entry *entry = memo->find( &key_, start_pos.buffer_pos_ );
+			if (entry != nullptr && entry->success_ && (entry->ast_ != nullptr || !base.build_ast_)) {
+				entry->end_pos_ = seed_end;
+				return hit(base, entry);
+			}
+
+			if (entry == nullptr || replay_to != -1) {
+				ParserBase::seek(base, start_pos);
+				return Parse_result{false, next.start_, next.end_ };
+			}
+
+			// the last round has taken the ast of the seed and dropped it (the seed was used by a rule that is not memoized): repeat the rounds up to the end of the seed.
+			memo->store( start_pos.buffer_pos_, Packrat_entry{ &key_, false, Position(start_pos), Position(start_pos), start_pos, nullptr, true, true } );
+			ParserBase::seek(base, start_pos);
+
+			Parse_result first = parse_rule(base);
+			if (!first.success_) {
+				return first;
+			}
+			return grow_seed(base, parse_rule, start_pos, std::move(first), seed_end.buffer_pos_);
+		}
+	}
+};
+
+} // namespace pparse
+
@@ -5,16 +5,26 @@
 #include <tuple>
 #include <variant>
 #include <optional>
+#include <array>
 #include <iostream>
 #include <sstream>
 #include <cstring>
+#include <string_view>
 #include "parse_text.h"
+#include "text_pages.h"
+#include "skipper.h"
 #include "parsedef.h"
+#include "small_vector.h"
+#include "ast_arena.h"
 #include "tokencollisionhelper.h"
 #include "dhelper.h"
 #include "vhelper.h"
 #include "analyse.h"
 #include "json.h"
+#include "packrat.h"
+#include "event_parser.h"
+#include "value_parser.h"
+#include "first_set.h"
 
 namespace pparse {
 
@@ -24,6 +34,15 @@ struct ParserBase {
 
 		using Char_value = Text_stream::Next_char_value;
 
+		// true for a base parser that parses a token array (Token_parser), PTok and PTokVar then compare the current token.
+		static inline const bool token_mode = false;
+
+		// true for a base parser that reports the parse as events (Event_parser), instead of building the AST.
+		static inline const bool emit_events = false;
+
+		// true for a base parser that computes the values of PAction rules (Value_parser), instead of building the AST.
+		static inline const bool synthesize_values = false;
+
 		template<typename ParserBase>
 		static Char_value  next_char(ParserBase &) {
 				ERROR("Not implemented\n");
@@ -60,6 +79,57 @@ struct ParserBase {
 				return parser.backtrack(parser, pos);
 		}
 
+		template<typename ParserBase>
+		static inline bool seek(ParserBase &parser, Text_position pos) {
+				ERROR("Not implemented\n");
+				return false;
+		}
+
+		template<typename ParserBase>
+		static inline FilePos_t pos_at_head(ParserBase &parser) {
+				ERROR("Not implemented\n");
+				return 0;
+		}
+
+		template<typename ParserBase>
+		static inline uint32_t generation(ParserBase &parser) {
+				ERROR("Not implemented\n");
+				return 0;
+		}
+
+		template<typename ParserBase>
+		static inline std::string_view peek(ParserBase &parser, uint32_t len) {
+				ERROR("Not implemented\n");
+				return std::string_view();
+		}
+
+		template<typename ParserBase>
+		static inline std::string_view span(ParserBase &parser) {
+				ERROR("Not implemented\n");
+				return std::string_view();
+		}
+
+		template<typename ParserBase>
+		static inline void advance(ParserBase &parser, uint32_t len) {
+				ERROR("Not implemented\n");
+		}
+
+		template<typename ParserBase>
+		static inline void skip_whitespace(ParserBase &parser) {
+				ERROR("Not implemented\n");
+		}
+
+		template<typename ParserBase>
+		static inline bool can_backtrack(ParserBase &parser, Text_position pos) {
+				ERROR("Not implemented\n");
+				return true;
+		}
+
+		template<typename ParserBase>
+		static inline void cut(ParserBase &parser) {
+				ERROR("Not implemented\n");
+		}
+
 //		static inline Text_position dec_position_nesting(ParserBase &parser) {
 //				ERROR("Not implemented\n");
 //				return  parser.dec_position_nesting(parser);
@@ -96,9 +166,48 @@ struct ParserBase {
             colission_checker_.reset( ptr );
         }
 
+        // use a collision checker that has been built in advance by PTopLevelParser::make_collision_checker; 
+        // the top level parser then doesn't build its own checker. The checker is not modified while parsing, it can be shared between threads.
+        void set_collision_checker(std::shared_ptr<TokenCollisionChecker> checker) {
+            colission_checker_ = checker;
+            shared_collision_checker_ = checker != nullptr;
+        }
 
 
-        std::unique_ptr<TokenCollisionChecker> colission_checker_;
+
+        // enable packrat mode: results of PAny and PSeq rules are memoized per offset.
+        void init_packrat_memo() {
+            packrat_memo_.reset( new Packrat_memo() );
+        }
+
+        std::shared_ptr<TokenCollisionChecker> colission_checker_;
+
+        bool shared_collision_checker_ = false;
+
+        std::unique_ptr<Packrat_memo> packrat_memo_;
+
+        // the AST nodes and their token text are allocated from this resource (see make_ast); a std::pmr::monotonic_buffer_resource that is set
+        // for a whole parse releases all of the AST at once.
+        void set_memory_resource(std::pmr::memory_resource *resource) {
+            memory_resource_ = resource;
+        }
+
+        std::pmr::memory_resource *memory_resource_ = std::pmr::get_default_resource();
+
+        // allocate the AST from the arena; PAny and PSeq rewind the arena when they fail, the nodes of a failed attempt are reclaimed at once.
+        // (not with packrat parsing: the memo table keeps the results of rules that were part of a failed attempt)
+        void set_arena(Ast_arena *arena) {
+            arena_ = arena;
+            memory_resource_ = arena != nullptr ? arena : std::pmr::get_default_resource();
+        }
+
+        Ast_arena *arena_ = nullptr;
+
+        // false while the parser only recognizes the input (see recognize): the rules don't build an AST.
+        bool build_ast_ = true;
+
+        // the text of the PTokVar token that is being scanned
+        std::string token_buffer_;
 
 
         //must not be a polymorphic type, is accessed from static stuff only. don't have virtual functions here.
@@ -109,43 +218,140 @@ struct ParserBase {
 		
 
 
-struct CharParser : ParserBase {
+// allocate an AST node from the memory resource of the parser; nullptr if the parser doesn't build an AST (see recognize)
+template<typename AstType, typename ParserBase, typename ...Args>
+inline std::unique_ptr<AstType> make_ast(ParserBase &base, Args &&...args) {
+	if (!base.build_ast_) {
+		return nullptr;
+	}
+	return std::unique_ptr<AstType>( new (base.memory_resource_) AstType( std::forward<Args>(args)... ) );
+}
+
+// parse the input with rule Type without building the AST: the result has the success flag and the positions only, no AST nodes are allocated.
+// (a lookahead predicate recognizes its lookahead rule, the AST of the lookahead is not used)
+template<typename Type, typename ParserBase>
+inline Parse_result recognize(ParserBase &base) {
+	bool build_ast = base.build_ast_;
+	base.build_ast_ = false;
+	Parse_result res = Type::parse(base);
+	base.build_ast_ = build_ast;
+	return res;
+}
+
+// parse a rule with rule_parser, if it fails then the arena is rewound to where it was before the rule.
+// (the nodes of the failed attempt have been freed when rule_parser returns)
+template<typename ParserBase, typename RuleParser>
+inline Parse_result parse_in_arena(ParserBase &base, RuleParser rule_parser) {
+	Ast_arena::Mark mark = base.arena_->mark();
+	Parse_result res = rule_parser(base);
+	if (!res.success_ && res.ast_ == nullptr) {
+		base.arena_->release(mark);
+	}
+	return res;
+}
+
+//
+// CharStreamParser - base parser that reads characters from a text stream of type TextStream (Text_stream, Text_memory_stream, Text_mmap_stream, Text_paged_stream)
+// The Skipper policy skips the text before a token (Skip_whitespace, or Skip_whitespace_and_comments)
+//
+
+template<typename TextStream, typename Skipper = Skip_whitespace>
+struct CharStreamParser : ParserBase {
 
 		using AstType = void;
 
 
-		CharParser(Text_stream &stream) : text_(stream) {
+		CharStreamParser(TextStream &stream) : text_(stream), skip_from_(-1), skip_generation_(0) {
 		}
 
 
-		static Char_value  current_char(CharParser &parser) {
+		static Char_value  current_char(CharStreamParser &parser) {
 				auto ch = parser.text_.current_char();
 				return ch;
 		}
 
-		static Char_value  next_char(CharParser &parser) {
+		static Char_value  next_char(CharStreamParser &parser) {
 				auto ch = parser.text_.next_char();
 				return ch;
 		}
 
 
-		static inline Text_position current_pos(CharParser &parser) {
+		static inline Text_position current_pos(CharStreamParser &parser) {
 				return parser.text_.pos_at_cursor(); 
 		}
 
-		static inline Text_position current_pos_and_inc_nesting(CharParser&parser) {
+		static inline Text_position current_pos_and_inc_nesting(CharStreamParser &parser) {
 				return parser.text_.pos_at_cursor_and_inc_nesting(); 
 		}
 
 
-		static inline Text_position dec_position_nesting(CharParser &parser) {
+		static inline Text_position dec_position_nesting(CharStreamParser &parser) {
 				return parser.text_.pos_at_cursor();
 		}
 
-		static inline bool backtrack(CharParser &parser, Text_position pos) {
+		static inline bool backtrack(CharStreamParser &parser, Text_position pos) {
 				return parser.text_.backtrack(pos);
 		}
 
+		static inline bool seek(CharStreamParser &parser, Text_position pos) {
+				return parser.text_.seek(pos);
+		}
+
+		static inline FilePos_t pos_at_head(CharStreamParser &parser) {
+				return parser.text_.pos_at_head();
+		}
+
+		// changes when the stream is opened again
+		static inline uint32_t generation(CharStreamParser &parser) {
+				return parser.text_.generation();
+		}
+
+		// view of the next len characters at the cursor (contiguous memory), the cursor is not moved.
+		static inline std::string_view peek(CharStreamParser &parser, uint32_t len) {
+				return parser.text_.peek(len);
+		}
+
+		// view of the characters at the cursor that are available without reading from the input.
+		static inline std::string_view span(CharStreamParser &parser) {
+				return parser.text_.span();
+		}
+
+		static inline void advance(CharStreamParser &parser, uint32_t len) {
+				parser.text_.advance(len);
+		}
+
+		// false if the text at pos has been discarded by a PCut: a rule that started at pos can't backtrack, it has to fail.
+		static inline bool can_backtrack(CharStreamParser &parser, Text_position pos) {
+				return pos.buffer_pos_ >= parser.text_.pos_at_head();
+		}
+
+		// discard all text before the cursor, it is no longer possible to backtrack before the cursor position.
+		static inline void cut(CharStreamParser &parser) {
+				parser.text_.move_on( parser.text_.pos_at_cursor() );
+		}
+
+		// skip the text before a token; the end of the last skipped run is remembered, so that alternatives that are tried at the same offset don't scan it again.
+		// (the run is keyed on the generation of the stream, that changes when the stream is opened again; a run that ends at the end of the
+		// available text is not remembered, more text may continue it)
+		static inline void skip_whitespace(CharStreamParser &parser) {
+				FilePos_t from = parser.text_.pos_at_cursor().buffer_pos_;
+
+				if (from == parser.skip_from_ && parser.text_.generation() == parser.skip_generation_) {
+					parser.text_.seek( parser.skip_to_ );
+					return;
+				}
+
+				Skipper::skip(parser.text_);
+
+				if (parser.text_.span().empty()) {
+					parser.skip_from_ = -1;
+					return;
+				}
+				parser.skip_from_ = from;
+				parser.skip_to_ = parser.text_.pos_at_cursor();
+				parser.skip_generation_ = parser.text_.generation();
+		}
+
 
 
 #ifdef __PARSER_ANALYSE_
@@ -171,8 +377,40 @@ struct CharParser : ParserBase {
         }
 
 private:
-		Text_stream &text_;
-		Text_stream::Next_char_value ch_;
+		TextStream &text_;
+		FilePos_t skip_from_;
+		Text_position skip_to_;
+		uint32_t skip_generation_;
+};
+
+//
+// CharParser - base parser that reads characters from a Text_stream
+//
+
+struct CharParser : CharStreamParser<Text_stream> {
+
+		CharParser(Text_stream &stream) : CharStreamParser<Text_stream>(stream) {
+		}
+};
+
+//
+// MemoryCharParser - base parser that reads characters from a Text_memory_stream (text in a buffer of the caller, without copying it)
+//
+
+struct MemoryCharParser : CharStreamParser<Text_memory_stream> {
+
+		MemoryCharParser(Text_memory_stream &stream) : CharStreamParser<Text_memory_stream>(stream) {
+		}
+};
+
+//
+// PagedCharParser - base parser that reads characters from a Text_paged_stream
+//
+
+struct PagedCharParser : CharStreamParser<Text_paged_stream> {
+
+		PagedCharParser(Text_paged_stream &stream) : CharStreamParser<Text_paged_stream>(stream) {
+		}
 };
 
 
@@ -190,11 +428,24 @@ struct PTopLevelParser : ParserBase {
 		template<typename ParserBase>
 		static Parse_result  parse(ParserBase &base) {
          
-                PTopLevelParser<Type>::init_collision_checker(base);
+                if (!base.shared_collision_checker_) {
+                    PTopLevelParser<Type>::init_collision_checker(base);
+                }
                 //Type::init_collision_checker(base);
                 return Type::parse(base);
         }
 
+        // build the collision checker of the grammar once, for use with ParserBase::set_collision_checker
+        static std::shared_ptr<TokenCollisionChecker> make_collision_checker() {
+            ParserBase base;
+            init_collision_checker(base);
+            return base.colission_checker_;
+        }
+
+        static First_set first_set(First_set_path &path) {
+            return first_set_of<Type>(path);
+        }
+
        	template<typename ParserBase>
         static void init_collision_checker(ParserBase &base) {
 
@@ -220,22 +471,29 @@ struct PRequireEof : PTopLevelParser<Type>  {
 		template<typename ParserBase>
 		static Parse_result  parse(ParserBase &base) {
 
+				size_t value_mark = 0;
+				if constexpr (ParserBase::synthesize_values) {
+					value_mark = base.value_mark();
+				}
+
 				Parse_result res = PTopLevelParser<Type>::parse(base);
 				if (!res.success_) {
 					return res;
 				}
 
+				ParserBase::skip_whitespace(base);
+
                 typename ParserBase::Char_value  nchar = ParserBase::current_char(base);
-				while (nchar.first && isspace(nchar.second)) { 
-						ParserBase::next_char(base);
-						nchar = ParserBase::current_char(base);
-				}
 
 				Text_position end_pos = ParserBase::current_pos(base);
 
 				if (!nchar.first) {
 						return res;
 				}
+				// the value of Type is dropped, the parse has failed
+				if constexpr (ParserBase::synthesize_values) {
+					base.drop_values(value_mark);
+				}
 				return Parse_result{false, Position(end_pos), Position(end_pos) };
 		}
 
@@ -272,7 +530,122 @@ struct PRequireEof : PTopLevelParser<Type>  {
 		
 };
 
+//
+// PStream - top level parser for a stream of records: Type is parsed until the end of the input, and each record is passed to the sink
+// once it has been parsed; the AST of the record is freed when the sink returns (unless the sink has taken it from the result), and the
+// text before the cursor is discarded (a PCut after each record), and the line index of the stream drops the lines before the cursor.
+// Memory stays proportional to one record, not to the whole input.
+//
+//		Parse_result res = PStream<Record>::parse(base, [](Parse_result &record) { ... record.get_ast() ... });
+//
+
+template<typename Type>
+struct PStream : PTopLevelParser<Type>  {
+
+		static inline const RuleId RULE_ID = Type::RULE_ID;
+
+		// the result doesn't have an AST, the records are passed to the sink (AstType is an empty node that is never built)
+		struct AstType : AstEntryBase {
+				AstType() : AstEntryBase(RULE_ID) {
+				}
+		};
+
+		// the result is the position of the input, or the failed record
+		template<typename ParserBase, typename Sink>
+		static Parse_result  parse(ParserBase &base, Sink &&sink) {
+
+				if (!base.shared_collision_checker_) {
+					PTopLevelParser<Type>::init_collision_checker(base);
+				}
+
+				ParserBase::skip_whitespace(base);
+				Text_position start_pos = ParserBase::current_pos(base);
+
+				while( ParserBase::current_char(base).first ) {
 
+					Text_position record_pos = ParserBase::current_pos(base);
+
+					// the nodes of the record are reclaimed at once, if they are allocated from an arena.
+					Ast_arena::Mark mark{0, 0};
+					if (base.arena_ != nullptr) {
+						mark = base.arena_->mark();
+					}
+
+					Parse_result res = Type::parse(base);
+					if (!res.success_) {
+						return res;
+					}
+					if (ParserBase::current_pos(base).buffer_pos_ == record_pos.buffer_pos_) {
+						// the record is empty, the parser would not move on.
+						return Parse_result{false, Position(record_pos), Position(record_pos) };
+					}
+
+					sink(res);
+
+					// (if the sink has taken the AST then the arena can't be rewound)
+					if (res.ast_ != nullptr) {
+						res.ast_.reset();
+						if (base.arena_ != nullptr) {
+							base.arena_->release(mark);
+						}
+					}
+
+					ParserBase::cut(base);
+					ParserBase::skip_whitespace(base);
+				}
+
+				Text_position end_pos = ParserBase::current_pos(base);
+				return Parse_result{true, Position(start_pos), Position(end_pos) };
+		}
+
+		// parse the records, without passing them on
+		template<typename ParserBase>
+		static Parse_result  parse(ParserBase &base) {
+				return parse(base, [](Parse_result &) {});
+		}
+};
+
+
+
+//
+// Leading_rule - the first element of a sequence (PSeq), for any other rule: the rule itself.
+//
+
+template<typename Type, typename = void>
+struct Leading_rule {
+	using type = Type;
+};
+
+template<typename Type>
+struct Leading_rule<Type, std::void_t<typename Type::LeadingType> > {
+	using type = typename Type::LeadingType;
+};
+
+//
+// Shared_prefix - the first leading rule that is shared by two alternatives of a choice (void if there is none)
+//
+
+template<typename ...Types>
+struct Shared_prefix {
+	using type = void;
+};
+
+template<typename Type, typename ...Types>
+struct Shared_prefix<Type, Types...> {
+	using Lead = typename Leading_rule<Type>::type;
+
+	using type = std::conditional_t< (std::is_same_v<Lead, typename Leading_rule<Types>::type> || ...), Lead, typename Shared_prefix<Types...>::type >;
+};
+
+//
+// Prefix_result - result of the leading rule that is shared by alternatives of a PAny, the leading rule is parsed once for all of them.
+//
+
+struct Prefix_result {
+	bool parsed_ = false;
+	Parse_result res_{false};
+	Text_position end_pos_;
+};
 
 //
 //  PAny - ordered choice parser combinator
@@ -291,26 +664,74 @@ struct PAny : ParserBase  {
 			AstType() : AstEntryBase(ruleId) {
 			}
 
+			// (the alternative can be a left recursive chain)
+			~AstType() {
+				Ast_teardown::free_children( [this](std::vector< std::unique_ptr<AstEntryBase> > &nodes) {
+					std::visit( [&nodes](auto &entry) { Ast_teardown::take(nodes, entry); }, entry_ );
+				});
+			}
+
 			std::variant< typename std::unique_ptr<typename Types::AstType>...> entry_;
 	};
 
 
+    using Packrat_type = ThisClass;
+
     template<typename ParserBase>
 	static Parse_result  parse(ParserBase &base) {
 
+		if constexpr (ParserBase::emit_events) {
+			return Event_rule<ThisClass>::parse(base, parse_rule<ParserBase>);
+		}
+		if constexpr (ParserBase::synthesize_values) {
+			return Value_rule::parse(base, parse_rule<ParserBase>);
+		}
+		if (base.packrat_memo_ != nullptr) {
+			return Packrat_rule<ThisClass>::parse(base, parse_rule<ParserBase>);
+		}
+		if (base.arena_ != nullptr) {
+			return parse_in_arena(base, parse_rule<ParserBase>);
+		}
+		return parse_rule(base);
+	}
+
+    template<typename ParserBase>
+	static Parse_result  parse_rule(ParserBase &base) {
+
 		Position error_pos;
 
+		// alternatives that start with the same rule (like PAny<1, PSeq<2, MultExpr, Add, Expr>, MultExpr>): the leading rule is parsed once for all of them.
+		// (not needed with packrat parsing, the memo table keeps the result of the leading rule; not with the Event_parser, the events of an alternative start with its enter event;
+		// not with the Value_parser, the values of the leading rule are dropped when the alternative fails)
+		using Prefix = typename Shared_prefix<Types...>::type;
+		Prefix_result prefix_result;
+		Prefix_result *prefix = !std::is_void_v<Prefix> && base.packrat_memo_ == nullptr && !ParserBase::emit_events && !ParserBase::synthesize_values ? &prefix_result : nullptr;
+
+		// the text of the leading rule is kept, until the other alternatives have been tried.
+		Text_position start_pos = prefix != nullptr ? ParserBase::current_pos_and_inc_nesting(base) : ParserBase::current_pos(base); 
+
 #ifdef __PARSER_TRACE__
-		Text_position start_pos = ParserBase::current_pos(base); 
 		std::string short_name = VisualizeTrace<ThisClass>::trace_start_parsing(start_pos);
 #endif
 
-		auto ast = std::make_unique<AstType>(); 
+		auto ast = make_ast<AstType>(base);
 
-		Parse_result res = parse_helper<0,ParserBase,Types...>(base, ast.get(), error_pos); 
+		// the alternatives that can start with the next character, the other alternatives are not tried.
+		Position lookahead_pos;
+		uint64_t viable = viable_alternatives(base, start_pos, &lookahead_pos);
+
+		Parse_result res = parse_helper<0,ParserBase,Prefix,Types...>(base, ast.get(), start_pos, error_pos, viable, lookahead_pos, prefix); 
+
+		if (prefix != nullptr) {
+			if (res.success_) {
+				ParserBase::dec_position_nesting(base);
+			} else if (ParserBase::can_backtrack(base, start_pos)) {
+				ParserBase::backtrack(base, start_pos);
+			}
+		}
 
 #ifdef __PARSER_TRACE__
-		VisualizeTrace<ThisClass>::end_parsing_choice(short_name, res.success_, ParserBase::current_pos(base), ast.get()->entry_.index());
+		VisualizeTrace<ThisClass>::end_parsing_choice(short_name, res.success_, ParserBase::current_pos(base), ast != nullptr ? ast.get()->entry_.index() : 0);
 #endif
 
 		if (res.success_) {
@@ -353,34 +774,123 @@ struct PAny : ParserBase  {
             }
         }
 
+		static First_set first_set(First_set_path &path) {
+			First_set ret;
+			( ret.add( first_set_of<Types>(path) ), ... );
+			return ret;
+		}
+
+		// for each character (and for the end of input at index 256): the bit mask of the alternatives that can start with it; built once from the first sets of the alternatives.
+		static const uint64_t *dispatch_table() {
+
+			static const std::array<uint64_t, 257> table = []() {
+				std::array<uint64_t, 257> ret{};
+				First_set_path path;
+				First_set sets[] = { first_set_of<Types>(path)... };
+
+				for(size_t i = 0; i < sizeof...(Types); ++i) {
+					for(int ch = 0; ch < 256; ++ch) {
+						if (sets[i].nullable_ || sets[i].has( (unsigned char) ch )) {
+							ret[ ch ] |= (uint64_t) 1 << i;
+						}
+					}
+					if (sets[i].nullable_) {
+						ret[ 256 ] |= (uint64_t) 1 << i;
+					}
+				}
+				return ret;
+			}();
 
+			return table.data();
+		}
 
 private:
-    template<size_t FieldIndex, typename ParserBase, typename PType, typename ...PTypes>
-    static inline Parse_result parse_helper(ParserBase &base, AstType *ast, Position error_pos) {
+	// peek at the next character (after the whitespace), and look up the alternatives that can start with it; a choice of more than 64 alternatives tries all of them.
+    template<typename ParserBase>
+	static inline uint64_t viable_alternatives(ParserBase &base, Text_position start_pos, Position *lookahead_pos) {
 
-		Parse_result res = PType::parse(base);			
-		typedef std::unique_ptr<typename PType::AstType> PTypePtr; 
-        
-		if (res.success_) {
-			if (res.ast_.get() != nullptr) {
-				typename PType::AstType *retAst = (typename PType::AstType *) res.ast_.release();
-				typedef typename std::variant< typename std::unique_ptr<typename Types::AstType>...> VariantType;
+		if constexpr (sizeof...(Types) > 64) {
+			*lookahead_pos = Position(start_pos);
+			return ~(uint64_t) 0;
+		} else {
+			ParserBase::skip_whitespace(base);
+			typename ParserBase::Char_value next = ParserBase::current_char(base);
+			*lookahead_pos = Position( ParserBase::current_pos(base) );
+			ParserBase::seek(base, start_pos);
+
+			return dispatch_table()[ next.first ? (unsigned char) next.second : 256 ];
+		}
+	}
+
+	// parse an alternative; an alternative that starts with the shared leading rule Prefix (or that is the leading rule) uses the result of the leading rule, if an earlier alternative has parsed it.
+    template<typename ParserBase, typename Prefix, typename PType>
+	static inline Parse_result parse_alternative(ParserBase &base, Text_position start_pos, Prefix_result *prefix) {
+
+		if constexpr (!std::is_void_v<Prefix> && std::is_same_v<typename Leading_rule<PType>::type, Prefix>) {
+			if (prefix != nullptr) {
 
+				if (!prefix->parsed_) {
+					prefix->res_ = Prefix::parse(base);
+					prefix->end_pos_ = ParserBase::current_pos(base);
+					prefix->parsed_ = true;
+				} else if (prefix->res_.success_) {
+					ParserBase::seek(base, prefix->end_pos_);
+				}
+
+				if (!prefix->res_.success_) {
+					return Parse_result{false, prefix->res_.start_, prefix->res_.end_};
+				}
 
-				ast->entry_ = VariantType{ std::in_place_index<FieldIndex>, PTypePtr(retAst) };
+				if constexpr (std::is_same_v<PType, Prefix>) {
+					// the alternative is the leading rule: it takes over the ast (there is no next alternative, as it succeeds)
+					return std::move(prefix->res_);
+				} else {
+					auto parse_rest = [prefix](ParserBase &arg) { return PType::parse_after_first(arg, prefix->res_); };
+					Parse_result res = base.arena_ != nullptr ? parse_in_arena(base, parse_rest) : parse_rest(base);
+					if (!res.success_ && ParserBase::can_backtrack(base, start_pos)) {
+						ParserBase::seek(base, start_pos);
+					}
+					return res;
+				}
 			}
-			return res;
 		}
+		return PType::parse(base);
+	}
+
+    template<size_t FieldIndex, typename ParserBase, typename Prefix, typename PType, typename ...PTypes>
+    static inline Parse_result parse_helper(ParserBase &base, AstType *ast, Text_position start_pos, Position error_pos, uint64_t viable, Position lookahead_pos, Prefix_result *prefix) {
+
+		if (FieldIndex >= 64 || (viable & ((uint64_t) 1 << (FieldIndex % 64))) != 0) {
+
+			Parse_result res = parse_alternative<ParserBase, Prefix, PType>(base, start_pos, prefix);
+			typedef std::unique_ptr<typename PType::AstType> PTypePtr; 
+        
+			if (res.success_) {
+				if (res.ast_.get() != nullptr) {
+					typename PType::AstType *retAst = (typename PType::AstType *) res.ast_.release();
+					typedef typename std::variant< typename std::unique_ptr<typename Types::AstType>...> VariantType;
+
+
+					ast->entry_ = VariantType{ std::in_place_index<FieldIndex>, PTypePtr(retAst) };
+				}
+				return res;
+			}
 
-		if (!res.success_) {
 			if (error_pos < res.start_) {
 				error_pos = res.start_;
 			}
+
+			// the alternative failed after a PCut: don't try the other alternatives.
+			if (!ParserBase::can_backtrack(base, start_pos)) {
+				return res;
+			}
+		} else if (error_pos < lookahead_pos) {
+			// the alternative can't start with the next character, it would fail right there.
+			error_pos = lookahead_pos;
 		}
 
 		if constexpr (sizeof...(PTypes) > 0) {
-			return parse_helper<FieldIndex + 1, ParserBase, PTypes...>(base, ast, error_pos);
+			return parse_helper<FieldIndex + 1, ParserBase, Prefix, PTypes...>(base, ast, start_pos, error_pos, viable, lookahead_pos, prefix);
 		}         
 		return Parse_result{false, error_pos, error_pos};
     }
@@ -487,17 +997,32 @@ struct POpt : ParserBase  {
     template<typename ParserBase>
 	static Parse_result  parse(ParserBase &base) {
 
-#ifdef __PARSER_TRACE__
+		if constexpr (ParserBase::emit_events) {
+			return Event_rule<ThisClass>::parse(base, parse_rule<ParserBase>);
+		}
+		return parse_rule(base);
+	}
+
+    template<typename ParserBase>
+	static Parse_result  parse_rule(ParserBase &base) {
+
 		Text_position start_pos = ParserBase::current_pos(base); 
+
+#ifdef __PARSER_TRACE__
 		std::string short_name = VisualizeTrace<ThisClass>::trace_start_parsing(start_pos);
 #endif
 
 
-		auto ast = std::make_unique<AstType>(); 
+		auto ast = make_ast<AstType>(base);
 
 		Parse_result res = PType::parse(base);			
 
-		if (res.success_) {
+		// failed after a PCut: that's an error, not a missing optional part.
+		if (!res.success_ && !ParserBase::can_backtrack(base, start_pos)) {
+			return res;
+		}
+
+		if (res.success_ && ast != nullptr) {
 			typename PType::AstType *ptr = (typename PType::AstType *) res.ast_.release();
 			AstType *rval = ast.get();
 			rval->entry_ = OptionType(PTypePtr(ptr));
@@ -557,7 +1082,11 @@ struct POpt : ParserBase  {
             }
         }
 
-
+		static First_set first_set(First_set_path &path) {
+			First_set ret = first_set_of<PType>(path);
+			ret.nullable_ = true;
+			return ret;
+		}
 
 private:
 
@@ -574,18 +1103,47 @@ struct PSeq : ParserBase  {
     using ThisClass = PSeq<ruleId, Types...>;
 	
 	static inline const RuleId RULE_ID = ruleId;
+
+	using LeadingType = std::tuple_element_t<0, std::tuple<Types...> >;
 	
 	struct AstType : AstEntryBase {
 			AstType() : AstEntryBase(ruleId) {
 			}
 
+			// (the first element can be a left recursive chain)
+			~AstType() {
+				Ast_teardown::free_children( [this](std::vector< std::unique_ptr<AstEntryBase> > &nodes) {
+					std::apply( [&nodes](auto &...entry) { (Ast_teardown::take(nodes, entry), ...); }, entry_ );
+				});
+			}
+
 			std::tuple<typename std::unique_ptr<typename Types::AstType>...> entry_;
 	};
 
 
+    using Packrat_type = ThisClass;
+
     template<typename ParserBase>
 	static Parse_result  parse(ParserBase &base) {
 
+		if constexpr (ParserBase::emit_events) {
+			return Event_rule<ThisClass>::parse(base, parse_rule<ParserBase>);
+		}
+		if constexpr (ParserBase::synthesize_values) {
+			return Value_rule::parse(base, parse_rule<ParserBase>);
+		}
+		if (base.packrat_memo_ != nullptr) {
+			return Packrat_rule<ThisClass>::parse(base, parse_rule<ParserBase>);
+		}
+		if (base.arena_ != nullptr) {
+			return parse_in_arena(base, parse_rule<ParserBase>);
+		}
+		return parse_rule(base);
+	}
+
+    template<typename ParserBase>
+	static Parse_result  parse_rule(ParserBase &base) {
+
 
 		Text_position start_pos = ParserBase::current_pos_and_inc_nesting(base);
 		Position start_seq;
@@ -594,11 +1152,11 @@ struct PSeq : ParserBase  {
 		std::string short_name = VisualizeTrace<ThisClass>::trace_start_parsing(start_pos);
 #endif
 
-		auto ast = std::make_unique<AstType>(); 
+		auto ast = make_ast<AstType>(base);
 
 		Parse_result res = parse_helper<0, ParserBase, Types...>(base, ast.get(), start_seq); 
 
-        if (!res.success_ ) {
+        if (!res.success_ && ParserBase::can_backtrack(base, start_pos)) {
 			ParserBase::backtrack(base, start_pos);
         }
 
@@ -616,6 +1174,27 @@ struct PSeq : ParserBase  {
         return res;
     }
 
+	// parse the elements after the first one, the first element has already been parsed (by a PAny with several alternatives that start with it);
+	// if the sequence fails then the ast of the first element is given back in first.
+    template<typename ParserBase>
+	static Parse_result  parse_after_first(ParserBase &base, Parse_result &first) {
+
+		auto ast = make_ast<AstType>(base);
+		if (ast == nullptr) {
+			return parse_rest<ParserBase, Types...>(base, nullptr, first);
+		}
+		std::get<0>( ast->entry_ ).reset( (typename LeadingType::AstType *) first.ast_.release() );
+
+		Parse_result res = parse_rest<ParserBase, Types...>(base, ast.get(), first);
+
+		if (res.success_) {
+			res.ast_.reset( ast.release() );
+		} else {
+			first.ast_.reset( std::get<0>( ast->entry_ ).release() );
+		}
+		return res;
+	}
+
 #ifdef __PARSER_ANALYSE__
 		template<typename HelperType>
 		static bool verify_no_cycles(HelperType *,CycleDetectorHelper &helper, std::ostream &out) {
@@ -647,10 +1226,28 @@ struct PSeq : ParserBase  {
             }
         }
 
-
+		// the elements up to the first element that must consume input
+		static First_set first_set(First_set_path &path) {
+			return first_set_helper<Types...>(path);
+		}
 
 private:
 
+		template<typename PType, typename ...PTypes>
+		static First_set first_set_helper(First_set_path &path) {
+
+			First_set ret = first_set_of<PType>(path);
+
+			if constexpr (sizeof...(PTypes) > 0) {
+				if (ret.nullable_) {
+					First_set rest = first_set_helper<PTypes...>(path);
+					ret.add(rest);
+					ret.nullable_ = rest.nullable_;
+				}
+			}
+			return ret;
+		}
+
 		template<size_t FieldIndex, typename Stream,  typename PType, typename ...PTypes>
 		static inline bool dump_helper( Stream &stream, const AstType *ast ) {
 
@@ -669,6 +1266,11 @@ private:
 	template<size_t FieldIndex, typename ParserBase, typename PType, typename ...PTypes>
     static inline Parse_result parse_helper(ParserBase &base, AstType *ast, Position start_seq ) {
 
+		[[maybe_unused]] Text_position field_start_pos;
+		if constexpr (Is_packrat_rule<PType>::value) {
+			field_start_pos = ParserBase::current_pos(base);
+		}
+
 		Parse_result res = PType::parse(base);						
     	typedef std::unique_ptr<typename PType::AstType> PTypePtr; 
      
@@ -686,14 +1288,42 @@ private:
 		}
 		
 		if constexpr (sizeof...(PTypes) > 0) {
-			return parse_helper<FieldIndex + 1, ParserBase, PTypes...>( base, ast, start_seq );
+			if constexpr (Is_packrat_rule<PType>::value) {
+				Text_position field_end_pos = ParserBase::current_pos(base);
+
+				Parse_result next_res = parse_helper<FieldIndex + 1, ParserBase, PTypes...>( base, ast, start_seq );
+
+				// sequence failed: the memo table keeps the ast of this field, another alternative may start with the same rule.
+				if (!next_res.success_ && base.packrat_memo_ != nullptr && ast != nullptr) {
+					Packrat_rule<typename PType::Packrat_type>::give_back(base, field_start_pos, field_end_pos, res, std::get<FieldIndex>( ast->entry_ ) );
+				}
+				return next_res;
+			} else {
+				return parse_helper<FieldIndex + 1, ParserBase, PTypes...>( base, ast, start_seq );
+			}
 		} 
 
-		ast->start_ = start_seq;
-		ast->end_ = res.end_;
+		if (ast != nullptr) {
+			ast->start_ = start_seq;
+			ast->end_ = res.end_;
+		}
 		return Parse_result{true, start_seq, res.end_};
     }
 
+	template<typename ParserBase, typename PType, typename ...PTypes>
+    static inline Parse_result parse_rest(ParserBase &base, AstType *ast, const Parse_result &first) {
+
+		if constexpr (sizeof...(PTypes) > 0) {
+			return parse_helper<1, ParserBase, PTypes...>( base, ast, first.start_ );
+		}
+
+		if (ast != nullptr) {
+			ast->start_ = first.start_;
+			ast->end_ = first.end_;
+		}
+		return Parse_result{true, first.start_, first.end_};
+	}
+
 
 #ifdef __PARSER_ANALYSE__
 
@@ -742,6 +1372,65 @@ private:
 };
 
 
+//
+//  PCut - commit to the current alternative (PEG cut)
+//
+//  Always succeeds, without consuming any input. Once a PCut has been parsed, it is no longer possible to backtrack to a position before the cut:
+//  the text before the cut is discarded (the text stream moves on), and if a rule fails after the cut then all enclosing rules that started before
+//  the cut fail as well, instead of trying the next alternative. Put it into a PSeq, after the elements that decide on the alternative; 
+//  with a long stream of records, a cut in each record keeps the lookahead buffer bounded. (a cut must not be used inside a lookahead predicate)
+//
+
+struct PCut : ParserBase {
+
+	static inline const RuleId RULE_ID = 0;
+
+	using ThisClass = PCut;
+
+	struct AstType : AstEntryBase {
+			AstType() : AstEntryBase(RULE_ID) {
+			}
+	};
+
+	template<typename ParserBase>
+	static Parse_result  parse(ParserBase &base) {
+
+		Text_position pos = ParserBase::current_pos(base);
+
+		ParserBase::cut(base);
+
+		return Parse_result{true, Position(pos), Position(pos) };
+	}
+
+#ifdef __PARSER_ANALYSE__
+		template<typename HelperType>
+		static bool verify_no_cycles(HelperType *,CycleDetectorHelper &helper, std::ostream &out) {
+			return true;
+		}
+
+		template<typename HelperType>
+		static bool can_accept_empty_input(HelperType *) {
+			return true;
+		}
+#endif		
+
+		template<typename Stream>
+		static void dumpJson(Stream &out,  const AstType *ast) {
+			Json<Stream>::dumpRule(out, RULE_ID, "PCut", true );
+			Json<Stream>::jsonEndTag(out, true);
+		}
+
+     	template<typename ParserBase>
+        static void init_collision_checker(ParserBase &base) {
+        }
+
+		static First_set first_set(First_set_path &) {
+			First_set ret;
+			ret.nullable_ = true;
+			return ret;
+		}
+};
+
 //
 //  PRepeat - repetition of element parser combinators
 //
@@ -751,23 +1440,39 @@ struct PRepeat : ParserBase {
 
     using ThisClass = PRepeat<ruleId, Type>;
 
+	using ElementType = Type;
+
 	static inline const RuleId RULE_ID = ruleId;
+
+	static inline const int MIN_OCCURANCE = minOccurance;
+
+	static inline const int MAX_OCCURANCE = maxOccurance;
 	
 	typedef typename std::unique_ptr< typename Type::AstType> AstTypeEntry;
  
 	struct AstType : AstEntryBase {
-		AstType() : AstEntryBase(ruleId) {
+		AstType(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) : AstEntryBase(ruleId), entry_(resource) {
 		}
 
-		std::list<AstTypeEntry> entry_;
+		// the elements are stored contiguously, the first few of them in the AST node itself.
+		Small_vector<AstTypeEntry, 4> entry_;
 	};
 
 
     template<typename ParserBase>
 	static Parse_result  parse(ParserBase &base) {
 
-		auto ast = std::make_unique<AstType>(); 
-		return parse_helper(base, &ast);
+		if constexpr (ParserBase::emit_events) {
+			return Event_rule<ThisClass>::parse(base, parse_rule<ParserBase>);
+		}
+		return parse_rule(base);
+	}
+
+    template<typename ParserBase>
+	static Parse_result  parse_rule(ParserBase &base) {
+
+		auto ast = make_ast<AstType>(base, base.memory_resource_); 
+		return parse_helper(base, ast != nullptr ? &ast : nullptr);
 	}
 
 	template<typename Stream>
@@ -779,7 +1484,7 @@ struct PRepeat : ParserBase {
 			Json<Stream>::jsonStartNested(out, "content");
 
 			for(auto it=ast->entry_.begin(); it != ast->entry_.end(); ++it) {
-				Type::dumpJson(out, &it->entry_);	
+				Type::dumpJson(out, it->get());	
 			}
 			Json<Stream>::jsonEndNested(out,true);
 
@@ -795,6 +1500,14 @@ struct PRepeat : ParserBase {
             }
         }
 
+		static First_set first_set(First_set_path &path) {
+			First_set ret = first_set_of<Type>(path);
+			if (minOccurance == 0) {
+				ret.nullable_ = true;
+			}
+			return ret;
+		}
+
 #ifdef __PARSER_ANALYSE__
 		template<typename HelperType>
 		static bool verify_no_cycles(HelperType *,CycleDetectorHelper &helper, std::ostream &out) {
@@ -834,7 +1547,9 @@ private:
 		for(int i = 0; i < minOccurance; ++i) {
 			Parse_result res = Type::parse(base);
 			if (!res.success_) {
-				ParserBase::backtrack(base, start_pos);
+				if (ParserBase::can_backtrack(base, start_pos)) {
+					ParserBase::backtrack(base, start_pos);
+				}
 
 #ifdef __PARSER_TRACE__
 				VisualizeTrace<ThisClass>::end_parsing(short_name, res.success_, ParserBase::current_pos(base));
@@ -853,8 +1568,17 @@ private:
 
 		for(int i = minOccurance; ; ++i ) {
 
+			Text_position element_pos = ParserBase::current_pos(base);
+
 			Parse_result res = Type::parse(base);
 			if (!res.success_) {
+				// the element failed after a PCut: the repetition fails.
+				if (!ParserBase::can_backtrack(base, element_pos)) {
+#ifdef __PARSER_TRACE__
+					VisualizeTrace<ThisClass>::end_parsing(short_name, false, ParserBase::current_pos(base));
+#endif
+					return res;
+				}
 				break;
 			}
 			if (maxOccurance != 0 && i >= maxOccurance) {
@@ -899,6 +1623,34 @@ template<RuleId ruleId, typename Type>
 struct PPlus : PRepeat<ruleId, Type, 1, 0> {
 };
 
+//
+// PAction - semantic action: with the Value_parser, the values that Rule has pushed are replaced by the value of the functor F
+//
+// F is called as Value F()(Value_span<Value> values), with the values of the tokens and of the nested PAction rules in the order of the input.
+// With the other base parsers PAction parses Rule, and returns the AST of Rule.
+//
+
+template<typename Rule, typename F>
+struct PAction : Rule {
+
+    template<typename ParserBase>
+	static Parse_result  parse(ParserBase &base) {
+
+		if constexpr (ParserBase::synthesize_values) {
+			size_t mark = base.value_mark();
+
+			Parse_result res = Rule::parse(base);
+			if (res.success_) {
+				base.template reduce<F>(mark);
+			} else {
+				base.drop_values(mark);
+			}
+			return res;
+		}
+		return Rule::parse(base);
+	}
+};
+
 
 //
 // Parse TPrecondition, if parsing of TPrecondition fails then try to parse Type
@@ -997,15 +1749,41 @@ struct PWithAndLookaheadImpl : ParserBase {
 	static Parse_result  parse(ParserBase &base) {
 
 
+		// the events are held back until the lookahead decides if they are kept
+		size_t event_mark = 0;
+		if constexpr (ParserBase::emit_events) {
+			event_mark = base.hold_events();
+		}
+
+		size_t value_mark = 0;
+		if constexpr (ParserBase::synthesize_values) {
+			value_mark = base.value_mark();
+		}
+
 		Text_position start_pos = ParserBase::current_pos_and_inc_nesting(base);
 		Parse_result res = Type::parse(base);
 		if (!res.success_) {
 			ParserBase::dec_position_nesting(base);
+			if constexpr (ParserBase::emit_events) {
+				base.release_events(base.event_mark());
+			}
 			return res;
 		} 
 
 		Text_position lookahead_start_pos = ParserBase::current_pos(base);
-		Parse_result resLookahead = LookaheadType::parse(base);
+		size_t lookahead_event_mark = 0;
+		if constexpr (ParserBase::emit_events) {
+			lookahead_event_mark = base.event_mark();
+		}
+		Parse_result resLookahead;
+		if constexpr (ParserBase::synthesize_values) {
+			// the lookahead doesn't add values
+			size_t mark = base.value_mark();
+			resLookahead = recognize<LookaheadType>(base);
+			base.drop_values(mark);
+		} else {
+			resLookahead = recognize<LookaheadType>(base);
+		}
 
 		bool isfail;
 
@@ -1017,9 +1795,19 @@ struct PWithAndLookaheadImpl : ParserBase {
 
 		if (isfail) {
 			ParserBase::backtrack(base, start_pos);
+			if constexpr (ParserBase::emit_events) {
+				base.release_events(event_mark);
+			}
+			if constexpr (ParserBase::synthesize_values) {
+				base.drop_values(value_mark);
+			}
 			return Parse_result{false, resLookahead.start_, resLookahead.end_ };
 		}
 		ParserBase::backtrack(base, lookahead_start_pos);
+		if constexpr (ParserBase::emit_events) {
+			// the lookahead doesn't add events
+			base.release_events(lookahead_event_mark);
+		}
 
 		return res;
   	}
@@ -1076,6 +1864,11 @@ struct PWithAndLookaheadImpl : ParserBase {
             }
         }
 
+		// the lookahead starts after Type, the input starts with Type
+		static First_set first_set(First_set_path &path) {
+			return first_set_of<Type>(path);
+		}
+
 	
 };
 
@@ -1103,6 +1896,8 @@ struct PWithNotLookahead: PWithAndLookaheadImpl<false, Type, LookaheadType> {
 
 
 #include "parse_atomic.h"
+#include "token_stream.h"
+#include "parse_precedence.h"
 
 namespace pparse {
 
@@ -1126,3 +1921,8 @@ struct PNotPredicate: PWithAndLookaheadImpl<false, PAlways<true>, Type> {
 } // namespace pparse
 
     
+
+#include "push_parser.h"
+#include "parse_many.h"
+#include "parse_chunked.h"
+#include "parse_pipeline.h"
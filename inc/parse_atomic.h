@@ -1,5 +1,7 @@
 #pragma once
 
+#include <charconv>
+
 namespace pparse {
 
 //
@@ -40,13 +42,28 @@ struct PTok : ParserBase  {
 		template<typename ParserBase>
 		static Parse_result  parse(ParserBase &base) {
 
+				if constexpr (ParserBase::emit_events) {
+					static const Char_t text[] = { Cs... };
+
+					Parse_result res = parse_rule(base);
+					if (res.success_) {
+						base.token(RULE_ID, res.start_, res.end_, std::string_view(text, sizeof...(Cs)));
+					}
+					return res;
+				}
+				return parse_rule(base);
+		}
+
+		template<typename ParserBase>
+		static Parse_result  parse_rule(ParserBase &base) {
+
+				if constexpr (ParserBase::token_mode) {
+					return parse_token(base);
+				}
+
 				Text_position start_pos = ParserBase::current_pos_and_inc_nesting(base);
 
-				Char_value  nchar = ParserBase::current_char(base);
-				while (nchar.first && isspace(nchar.second)) { 
-						ParserBase::next_char(base);
-						nchar = ParserBase::current_char(base);
-				}	
+				ParserBase::skip_whitespace(base);
 
 				Text_position token_start_pos = ParserBase::current_pos(base);
 
@@ -55,7 +72,7 @@ struct PTok : ParserBase  {
 #endif
 
 
-				if (! parse_helper<ParserBase,Cs...>(base)) {
+				if (! match_token(base)) {
 					ParserBase::backtrack(base, start_pos);
 
 #ifdef __PARSER_TRACE__
@@ -76,9 +93,9 @@ struct PTok : ParserBase  {
 
 				Text_position end_pos = ParserBase::current_pos(base);
 
-				end_pos.column_ -= 1;
+				end_pos.prev_char();
 
-				return Parse_result{true, Position(token_start_pos), Position(end_pos), std::make_unique<AstType>( Position(token_start_pos), Position(end_pos) ) };
+				return Parse_result{true, Position(token_start_pos), Position(end_pos), make_ast<AstType>(base, Position(token_start_pos), Position(end_pos) ) };
 		}
 
 #ifdef __PARSER_ANALYSE__
@@ -116,7 +133,70 @@ struct PTok : ParserBase  {
             base.colission_checker_->insert(sval.c_str(), sval.size() );
         }
 
+		// the first character of the token; a token that starts with whitespace can't be checked after skipping the whitespace.
+		static First_set first_set(First_set_path &) {
+			static constexpr Char_t token[] = { Cs... };
+
+			if (isspace( (unsigned char) token[0] )) {
+				return First_set::any();
+			}
+			First_set ret;
+			ret.add( (unsigned char) token[0] );
+			return ret;
+		}
+
 private:
+		// token mode: the current token must be the same as the fixed token.
+		template<typename ParserBase>
+		static Parse_result  parse_token(ParserBase &base) {
+
+				static constexpr Char_t token[] = { Cs... };
+
+				auto next = ParserBase::current_token(base);
+				Text_position token_start_pos = ParserBase::token_pos(base);
+
+#ifdef __PARSER_TRACE__
+				std::string short_name = VisualizeTrace<ThisClass>::trace_start_parsing_token(token_start_pos);
+#endif
+
+				if (next == nullptr || ParserBase::token_text(base, *next) != std::string_view(token, sizeof...(Cs))) {
+#ifdef __PARSER_TRACE__
+					VisualizeTrace<ThisClass>::end_parsing(short_name, false, ParserBase::current_pos(base));
+#endif
+					return Parse_result{false, Position(token_start_pos), Position(token_start_pos) };
+				}
+
+				ParserBase::next_token(base);
+
+#ifdef __PARSER_TRACE__
+				VisualizeTrace<ThisClass>::end_parsing(short_name, true, ParserBase::current_pos(base));
+#endif
+
+				Text_position end_pos = ParserBase::current_pos(base);
+
+				end_pos.prev_char();
+
+				return Parse_result{true, Position(token_start_pos), Position(end_pos), make_ast<AstType>(base, Position(token_start_pos), Position(end_pos) ) };
+		}
+
+		// compare the whole token against a contiguous view of the lookahead buffer; 
+		// fall back to comparing char by char if the view is shorter than the token (near eof, or if the buffer is not mirrored)
+		template<typename ParserBase>
+		static inline bool match_token( ParserBase &text ) {
+
+				static constexpr Char_t token[] = { Cs... };
+
+				std::string_view view = ParserBase::peek(text, sizeof...(Cs));
+				if (view.size() == sizeof...(Cs)) {
+					if (memcmp(view.data(), token, sizeof...(Cs)) != 0) {
+						return false;
+					}
+					ParserBase::advance(text, sizeof...(Cs));
+					return true;
+				}
+				return parse_helper<ParserBase, Cs...>( text );
+		}
+
 		template<typename ParserBase, Char_t ch, Char_t ...Css>
 		static inline bool parse_helper( ParserBase &text ) {
 
@@ -170,47 +250,110 @@ enum class Char_checker_result {
 	acceptUnget,
 };
 
-typedef Char_checker_result (PTokVar_cb_t) (Char_t current_char, bool iseof, std::string &matched_so_far);
+// typedef Char_checker_result (PTokVar_cb_t) (Char_t current_char, bool iseof, std::string &matched_so_far);  - declared in tokencollisionhelper.h
 
 
 const int PTokVarCanAcceptEmptyInput = 1;
 const int PTokVarCheckTokenClash = 2;
 
-template<RuleId ruleId, PTokVar_cb_t checker, int TokVarFlags = 0>
+//
+// Token_text - the value of a PTokVar token for the Value_parser: the token text, valid while the token is accepted.
+//
+
+struct Token_text {
+	static bool valid(std::string_view) {
+		return true;
+	}
+
+	static std::string_view value(std::string_view text) {
+		return text;
+	}
+};
+
+//
+// Token_int - the value of a PTokInt token for the Value_parser: the number
+//
+
+struct Token_int {
+	// false if the number doesn't fit an int64_t
+	static bool valid(std::string_view text) {
+		int64_t ret = 0;
+		std::from_chars_result res = std::from_chars( text.data(), text.data() + text.size(), ret );
+		return res.ec == std::errc() && res.ptr == text.data() + text.size();
+	}
+
+	static int64_t value(std::string_view text) {
+		int64_t ret = 0;
+		std::from_chars( text.data(), text.data() + text.size(), ret );
+		return ret;
+	}
+};
+
+template<RuleId ruleId, PTokVar_cb_t checker, int TokVarFlags = 0, typename TokenValue = Token_text>
 struct PTokVar : ParserBase  { 
 		
-		using ThisClass = PTokVar<ruleId, checker, TokVarFlags>;
+		using ThisClass = PTokVar<ruleId, checker, TokVarFlags, TokenValue>;
 
 		static inline const RuleId RULE_ID = ruleId;
 
 		struct AstType : AstEntryBase {
-				AstType() : AstEntryBase(ruleId) {
+				AstType(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) : AstEntryBase(ruleId), entry_(resource) {
 				}
 
-				std::string entry_;
+				std::pmr::string entry_;
 		};
 
 
 		template<typename ParserBase>
 		static Parse_result  parse(ParserBase &base) {
+
+				if constexpr (ParserBase::token_mode) {
+					return parse_token(base);
+				}
 			
-				Char_value  nchar = ParserBase::current_char(base);
-				while (nchar.first && isspace(nchar.second)) { 
-						ParserBase::next_char(base);
-						nchar = ParserBase::current_char(base);
-				}	
+				ParserBase::skip_whitespace(base);
 
 				Text_position token_start_pos = ParserBase::current_pos(base);
 
-				auto ast = std::make_unique<AstType>();
-				while( nchar.first ) {
+				Char_value  nchar = ParserBase::current_char(base);
+
+				// the token is scanned into the buffer of the parser, the AST is allocated once the token has been accepted.
+				std::string &entry = base.token_buffer_;
+				entry.clear();
+
+				// the checker is called at the end of the input too (iseof is set): a token that can be empty is accepted there.
+				for(;;) {
+
+						// run the checker over the contiguous part of the lookahead buffer, the chars that continue the token are consumed at once.
+						std::string_view text = ParserBase::span(base);
+						size_t run = 0;
+						Char_checker_result res = Char_checker_result::proceed;
+
+						while(run < text.size()) {
+							res = checker((Char_t) text[run], false, entry);
+							if (res != Char_checker_result::proceed) {
+								break;
+							}
+							entry += text[run];
+							++run;
+						}
+						if (run > 0) {
+							ParserBase::advance(base, run);
+						}
+						if (run < text.size()) {
+							nchar = Char_value(true, (Char_t) text[run]);
+						} else {
+							nchar = ParserBase::current_char(base);
+							if (nchar.first && !text.empty()) {
+								continue;
+							}
+							res = checker(nchar.second, !nchar.first, entry);
+						}
 
-						nchar = ParserBase::current_char(base);
-						Char_checker_result res = checker(nchar.second, !nchar.first, ast.get()->entry_);
 						switch(res) {
 
 							case Char_checker_result::proceed:
-									ast.get()->entry_ += (char) nchar.second;
+									entry += (char) nchar.second;
 									break;
 
 							case Char_checker_result::error:
@@ -218,33 +361,27 @@ struct PTokVar : ParserBase  {
 									return Parse_result{false, token_start_pos, token_start_pos };	
 
 							case Char_checker_result::acceptNow: {
-									ast.get()->entry_ += (char) nchar.second;
+									entry += (char) nchar.second;
 									Text_position end_pos = ParserBase::current_pos(base);
 									ParserBase::next_char(base); 
 
-									AstEntryBase *ret = ast.release();
-									ret->start_ = token_start_pos;
-									ret->end_ = end_pos;
- 
-                                    if (has_collision(base, ast.get()->entry_)) {
+                                    if (rejected(base, entry)) {
 				                        return Parse_result{false, token_start_pos, token_start_pos};
                                     }
-            						return Parse_result{true, token_start_pos, end_pos, std::unique_ptr<AstEntryBase>(ret) };	
+
+            						return Parse_result{true, token_start_pos, end_pos, accept_token(base, entry, token_start_pos, end_pos) };
 
 							}
 
 							case Char_checker_result::acceptUnget: {
 									Text_position end_pos = ParserBase::current_pos(base);
-									end_pos.column_ -= 1;
+									end_pos.prev_char();
 
-									AstEntryBase *ret = ast.release();
-									ret->start_ = token_start_pos;
-									ret->end_ = end_pos;
-		    					    
-                                    if (has_collision(base, ast.get()->entry_)) {
+                                    if (rejected(base, entry)) {
 				                        return Parse_result{false, token_start_pos, token_start_pos};
                                     }
-                            		return Parse_result{true, token_start_pos, end_pos, std::unique_ptr<AstEntryBase>(ret) };	
+
+                            		return Parse_result{true, token_start_pos, end_pos, accept_token(base, entry, token_start_pos, end_pos) };
 							}
 
 						}
@@ -259,7 +396,7 @@ struct PTokVar : ParserBase  {
 		
 				Text_position end_pos = ParserBase::current_pos(base);
 
-				end_pos.column_ -= 1;
+				end_pos.prev_char();
 
 				return Parse_result{false, token_start_pos, token_start_pos};
 		}
@@ -289,14 +426,93 @@ struct PTokVar : ParserBase  {
 
      	template<typename ParserBase>
         static void init_collision_checker(ParserBase &base) {
+            if (base.colission_checker_ != nullptr) {
+                base.colission_checker_->insert_checker(checker);
+            }
+        }
+
+		// the characters that the checker accepts as first character of the token; the token is nullable if it can be empty (then it is also accepted at the end of the input).
+		static First_set first_set(First_set_path &) {
+			First_set ret;
+			std::string matched;
+
+			for(int ch = 0; ch < 256; ++ch) {
+				if (checker( (Char_t) ch, false, matched) != Char_checker_result::error) {
+					ret.add( (unsigned char) ch );
+				}
+			}
+			ret.nullable_ = (TokVarFlags & PTokVarCanAcceptEmptyInput) != 0 || checker( (Char_t) 0, true, matched) != Char_checker_result::error;
+			return ret;
+		}
+
+		// token mode: the current token must be accepted by the checker.
+		template<typename ParserBase>
+		static Parse_result  parse_token(ParserBase &base) {
+
+				auto next = ParserBase::current_token(base);
+				Text_position token_start_pos = ParserBase::token_pos(base);
+
+#ifdef __PARSER_TRACE__
+				std::string short_name = VisualizeTrace<ThisClass>::trace_start_parsing_token(token_start_pos);
+#endif
+
+				if (next == nullptr || !ParserBase::token_matches(base, *next, checker) || rejected(base, ParserBase::token_text(base, *next))) {
+#ifdef __PARSER_TRACE__
+					VisualizeTrace<ThisClass>::end_parsing(short_name, false, ParserBase::current_pos(base));
+#endif
+					return Parse_result{false, token_start_pos, token_start_pos};
+				}
+
+				std::string_view text = ParserBase::token_text(base, *next);
+
+				ParserBase::next_token(base);
+
+#ifdef __PARSER_TRACE__
+				VisualizeTrace<ThisClass>::end_parsing(short_name, true, ParserBase::current_pos(base));
+#endif
+
+				Text_position end_pos = ParserBase::current_pos(base);
+				end_pos.prev_char();
+
+				return Parse_result{true, token_start_pos, end_pos, accept_token(base, text, token_start_pos, end_pos) };
+		}
+
+		// the AST of an accepted token, the token text is copied to memory of the memory resource of the parser (the Event_parser gets a token event,
+		// the Value_parser gets the value of the token).
+		template<typename ParserBase>
+		static std::unique_ptr<AstEntryBase> accept_token(ParserBase &base, std::string_view text, Text_position start_pos, Text_position end_pos) {
+				if constexpr (ParserBase::emit_events) {
+					base.token(RULE_ID, Position(start_pos), Position(end_pos), text);
+				}
+				if constexpr (ParserBase::synthesize_values) {
+					base.token_value( TokenValue::value(text) );
+				}
+				auto ast = make_ast<AstType>(base, base.memory_resource_);
+				if (ast != nullptr) {
+					ast->entry_.assign( text.data(), text.size() );
+					ast->start_ = start_pos;
+					ast->end_ = end_pos;
+				}
+				return ast;
+		}
+
+        // the token is not accepted if it is a fixed token of the grammar, or (with the Value_parser) if its text is not a valid value
+        template<typename ParserBase>
+        inline static bool rejected(ParserBase &base, std::string_view entry) {
+            if constexpr (ParserBase::synthesize_values) {
+                if (!TokenValue::valid(entry)) {
+                    return true;
+                }
+            }
+            return has_collision(base, entry);
         }
 
-        inline static bool has_collision(ParserBase &base, std::string &entry) {
+        inline static bool has_collision(ParserBase &base, std::string_view entry) {
 
             if constexpr ((TokVarFlags & PTokVarCheckTokenClash) != 0) {
                 if (base.colission_checker_ != nullptr) {
 
-                    const Char_t *tok =  (const Char_t *) entry.c_str();
+                    const Char_t *tok =  (const Char_t *) entry.data();
                     int len = entry.size();
 
                     return base.colission_checker_->has_token(tok, len);
@@ -322,7 +538,7 @@ inline Char_checker_result pparse_is_digit(Char_t current_char, bool iseof, std:
 // PTokInt - sequence of digites
 //
 template<RuleId ruleId>
-struct PTokInt : PTokVar<ruleId, pparse_is_digit>  { 
+struct PTokInt : PTokVar<ruleId, pparse_is_digit, 0, Token_int>  { 
 };
 
 
@@ -378,7 +594,11 @@ struct  PAlways {
 		template<typename ParserBase>
 		static Parse_result  parse(ParserBase &base) {
 			Text_position token_start_pos = ParserBase::current_pos(base);
-		    return Parse_result{acceptOrReject, Position(token_start_pos), Position(token_start_pos), std::make_unique<AstType>( Position(token_start_pos), Position(token_start_pos) ) };
+			auto ast = make_ast<AstType>(base);
+			if (ast) {
+				ast->start_ = ast->end_ = Position(token_start_pos);
+			}
+		    return Parse_result{acceptOrReject, Position(token_start_pos), Position(token_start_pos), std::move(ast) };
 		}
 
 #ifdef __PARSER_ANALYSE__
@@ -403,6 +623,12 @@ struct  PAlways {
         static void init_collision_checker(ParserBase &base) {
         }
 
+		static First_set first_set(First_set_path &) {
+			First_set ret;
+			ret.nullable_ = acceptOrReject;
+			return ret;
+		}
+
 };
 
 
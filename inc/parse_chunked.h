@@ -0,0 +1,159 @@
+#pragma once
+
+#include <string.h>
+#include <ctype.h>
+#include <vector>
+#include <string_view>
+
+namespace pparse {
+
+//
+// Chunked_parse_stats - how parse_chunked has split the input
+//
+
+struct Chunked_parse_stats {
+	size_t chunks_;		// number of chunks that the input has been split into
+	size_t resyncs_;	// number of chunks that had to be parsed again, because the chunk boundary was not at the start of a record
+};
+
+//
+// parse_chunked - parse a large text that is a repetition of records (Repeat is a PStar or PPlus) in parallel.
+//
+// The text is split into chunks at a delimiter (default: newline); the boundary is moved back before the whitespace that ends at the delimiter,
+// so a whitespace delimiter and the whitespace before it belong to the next chunk, where they are skipped before its first record.
+// Each chunk is parsed on a Work_stealing_pool with its own Text_memory_stream, that starts at the offset of the chunk, so that all positions in the AST are offsets in the whole text.
+// A chunk parses records until the next record would start at or after the end of the chunk (the last record of a chunk may extend into the next chunk).
+//
+// The lists of records of all chunks are then stitched together in order: if the previous chunk didn't stop exactly at the start of the next chunk
+// (the delimiter was in the middle of a record), then the next chunk is parsed again, starting at the end of the last record of the previous chunk.
+// So the result is the same as that of Repeat::parse on the whole text; if a record fails to parse then the repetition ends at that record.
+//
+
+template<typename Repeat>
+Parse_result parse_chunked(Text_memory_stream &text, std::string_view delimiter = "\n", size_t num_threads = 0, size_t num_chunks = 0, Chunked_parse_stats *stats = nullptr) {
+
+	static_assert(Repeat::MAX_OCCURANCE == 0, "parse_chunked requires a repetition without a maximum number of occurances");
+
+	using Element = typename Repeat::ElementType;
+
+	struct Chunk {
+		FilePos_t begin_;
+		FilePos_t end_;
+		FilePos_t stop_;	// offset after the last record that has been parsed
+		bool failed_;		// the parse stopped at a record that failed to parse
+		std::unique_ptr<typename Repeat::AstType> ast_;
+	};
+
+	const Char_t *data = text.data();
+	FilePos_t size = text.size();
+
+	std::shared_ptr<TokenCollisionChecker> collision_checker = PTopLevelParser<Element>::make_collision_checker();
+
+	Work_stealing_pool pool(num_threads);
+	if (num_chunks == 0) {
+		// more chunks than workers, so that the workers are balanced by stealing.
+		num_chunks = 4 * pool.num_workers();
+	}
+
+	// split the text at a delimiter after each multiple of the chunk size.
+	std::vector<Chunk> chunks;
+	FilePos_t begin = 0;
+	for(size_t i = 1; i < num_chunks && !delimiter.empty(); ++i) {
+		FilePos_t target = (FilePos_t) (size * i / num_chunks);
+		if (target < begin) {
+			continue;
+		}
+		const Char_t *found = (const Char_t *) memmem(data + target, size - target, delimiter.data(), delimiter.size());
+		if (found == nullptr) {
+			break;
+		}
+		// the whitespace up to the end of the delimiter goes to the next chunk
+		FilePos_t end = (found - data) + delimiter.size();
+		while(end > begin && isspace((unsigned char) data[ end - 1 ])) {
+			--end;
+		}
+		if (end > begin) {
+			chunks.push_back( Chunk{ begin, end, begin, false, nullptr } );
+			begin = end;
+		}
+	}
+	chunks.push_back( Chunk{ begin, size, begin, false, nullptr } );
+
+	auto parse_chunk = [data, size, &collision_checker](Chunk &chunk, FilePos_t start) {
+
+		Text_memory_stream stream;
+		stream.open(data, size, start);
+
+		MemoryCharParser parser(stream);
+		parser.set_collision_checker(collision_checker);
+
+		chunk.ast_.reset( new typename Repeat::AstType() );
+		chunk.failed_ = false;
+
+		for(;;) {
+			Text_position pos = MemoryCharParser::current_pos(parser);
+
+			// stop if the next record starts at the end of the chunk.
+			MemoryCharParser::skip_whitespace(parser);
+			bool at_end = MemoryCharParser::current_pos(parser).buffer_pos_ >= chunk.end_ || !MemoryCharParser::current_char(parser).first;
+			MemoryCharParser::seek(parser, pos);
+
+			if (at_end) {
+				break;
+			}
+
+			Parse_result res = Element::parse(parser);
+			if (!res.success_) {
+				MemoryCharParser::seek(parser, pos);
+				chunk.failed_ = true;
+				break;
+			}
+			chunk.ast_->entry_.push_back( typename Repeat::AstTypeEntry( (typename Element::AstType *) res.ast_.release() ) );
+		}
+		chunk.stop_ = MemoryCharParser::current_pos(parser).buffer_pos_;
+	};
+
+	pool.run( chunks.size(), [&chunks, &parse_chunk](size_t, size_t index) {
+		parse_chunk( chunks[ index ], chunks[ index ].begin_ );
+	});
+
+	// stitch the chunks together
+	auto ast = std::make_unique<typename Repeat::AstType>();
+	FilePos_t stop = 0;
+	size_t resyncs = 0;
+
+	for(auto &chunk : chunks) {
+		if (chunk.begin_ != stop) {
+			if (stop > chunk.end_) {
+				// the last record of the previous chunk extends beyond this chunk.
+				continue;
+			}
+			parse_chunk(chunk, stop);
+			resyncs += 1;
+		}
+		ast->entry_.append( std::move(chunk.ast_->entry_) );
+		stop = chunk.stop_;
+		if (chunk.failed_) {
+			break;
+		}
+	}
+
+	if (stats != nullptr) {
+		stats->chunks_ = chunks.size();
+		stats->resyncs_ = resyncs;
+	}
+
+	Text_memory_stream stream;
+	stream.open(data, size, stop);
+	Position end_pos( stream.pos_at_cursor() );
+
+	if (ast->entry_.size() < (size_t) Repeat::MIN_OCCURANCE) {
+		return Parse_result{false, end_pos, end_pos};
+	}
+
+	ast->start_ = Position( Text_position() );
+	ast->end_ = end_pos;
+	return Parse_result{true, ast->start_, end_pos, std::unique_ptr<AstEntryBase>( ast.release() ) };
+}
+
+} // namespace pparse
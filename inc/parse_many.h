@@ -0,0 +1,229 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <vector>
+#include <string>
+#include <memory>
+
+namespace pparse {
+
+//
+// Work_stealing_pool - runs a batch of independent tasks on a number of worker threads
+//
+// Each worker has its own queue of task indexes, the tasks are distributed round robin between the queues. A worker takes tasks from the front of its own queue,
+// if its queue is empty then it steals a task from the back of the queue of another worker; a worker stops once all queues are empty (tasks don't create new tasks).
+// The calling thread is worker zero.
+//
+
+class Work_stealing_pool {
+public:
+
+	// num_workers == 0 means: one worker per hardware thread
+	Work_stealing_pool(size_t num_workers = 0) : num_workers_(num_workers != 0 ? num_workers : std::max( (size_t) std::thread::hardware_concurrency(), (size_t) 1)), queues_(num_workers_), steals_(0) {
+	}
+
+	Work_stealing_pool(const Work_stealing_pool &) = delete;
+	Work_stealing_pool &operator=(const Work_stealing_pool &) = delete;
+
+	// calls task(worker_index, task_index) for each task_index in [0, num_tasks), returns after all tasks have been run.
+	template<typename Task>
+	void run(size_t num_tasks, Task task) {
+
+		for(size_t index = 0; index < num_tasks; ++index) {
+			queues_[ index % num_workers_ ].tasks_.push_back( index );
+		}
+
+		std::vector<std::thread> threads;
+		for(size_t worker = 1; worker < num_workers_; ++worker) {
+			threads.emplace_back( [this, worker, &task]() { work(worker, task); } );
+		}
+		work(0, task);
+
+		for(auto &thread : threads) {
+			thread.join();
+		}
+	}
+
+	size_t num_workers() const {
+		return num_workers_;
+	}
+
+	// number of tasks that were run by a worker other than the one that it has been assigned to.
+	size_t steals() const {
+		return steals_.load();
+	}
+
+private:
+	struct Worker_queue {
+		std::mutex mutex_;
+		std::deque<size_t> tasks_;
+	};
+
+	template<typename Task>
+	void work(size_t worker, Task &task) {
+		size_t index;
+		while(pop(worker, &index) || steal(worker, &index)) {
+			task(worker, index);
+		}
+	}
+
+	bool pop(size_t worker, size_t *index) {
+		Worker_queue &queue = queues_[ worker ];
+		std::lock_guard<std::mutex> lock(queue.mutex_);
+		if (queue.tasks_.empty()) {
+			return false;
+		}
+		*index = queue.tasks_.front();
+		queue.tasks_.pop_front();
+		return true;
+	}
+
+	bool steal(size_t worker, size_t *index) {
+		for(size_t victim = (worker + 1) % num_workers_; victim != worker; victim = (victim + 1) % num_workers_) {
+			Worker_queue &queue = queues_[ victim ];
+			std::lock_guard<std::mutex> lock(queue.mutex_);
+			if (!queue.tasks_.empty()) {
+				*index = queue.tasks_.back();
+				queue.tasks_.pop_back();
+				steals_.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	size_t num_workers_;
+	std::vector<Worker_queue> queues_;
+	std::atomic<size_t> steals_;
+};
+
+enum class Parse_many_order {
+	in_order,		// results are passed to the sink in the order of the inputs
+	as_completed,	// results are passed to the sink as soon as the parse is finished
+};
+
+enum class Parse_many_memory {
+	default_resource,	// the AST nodes are allocated from the default memory resource, the sink can take over the AST
+	worker_arena,		// each worker allocates the AST nodes from its own Ast_arena; the AST is valid during the call of the sink only
+};
+
+//
+// Parse_many_stats - how the results of parse_many have been passed to the sink
+//
+
+struct Parse_many_stats {
+	size_t max_pending_;	// largest number of results that have been held back, because a preceding result was not finished (in_order)
+	size_t steals_;			// number of files that were parsed by a worker other than the one that they have been assigned to
+};
+
+//
+// parse_many - parse a batch of files with the grammar Parser, in parallel on a Work_stealing_pool.
+//
+// The sink is called as sink(size_t input_index, Parse_result &result) for each input file; calls of the sink are serialised (never concurrent),
+// the sink can take over the AST of the result (unless the memory is Parse_many_memory::worker_arena). With Parse_many_order::in_order the results
+// that are finished ahead of their turn are held back until all preceding results are delivered; a worker doesn't start a file that is more than
+// four files per worker ahead of the next result to deliver, so that the held back results stay bounded.
+// Each worker thread has its own Text_stream, the lookahead buffer of the stream is reused from file to file; with Parse_many_memory::worker_arena
+// each worker also has its own Ast_arena, that is reset once all results of the worker have been delivered (the workers don't contend for the heap).
+// The token collision checker of the grammar is built once and is shared (read only) by all workers.
+// Returns the number of inputs that have been parsed successfully.
+//
+
+template<typename Parser, typename Sink>
+size_t parse_many(const std::vector<std::string> &inputs, Sink sink, Parse_many_order order = Parse_many_order::in_order, size_t num_threads = 0, uint32_t buf_size = Text_stream::Default_buf_size,
+				  Parse_many_memory memory = Parse_many_memory::default_resource, Parse_many_stats *stats = nullptr) {
+
+	std::shared_ptr<TokenCollisionChecker> collision_checker = Parser::make_collision_checker();
+
+	Work_stealing_pool pool(num_threads);
+
+	std::vector< std::unique_ptr<Text_stream> > streams;
+	std::vector< std::unique_ptr<Ast_arena> > arenas;
+	for(size_t worker = 0; worker < pool.num_workers(); ++worker) {
+		streams.emplace_back( new Text_stream() );
+		arenas.emplace_back( memory == Parse_many_memory::worker_arena ? new Ast_arena() : nullptr );
+	}
+
+	struct Pending_result {
+		Parse_result result_;
+		size_t worker_;
+	};
+
+	std::mutex sink_mutex;
+	std::condition_variable delivered;
+	std::map<size_t, Pending_result> pending;
+	std::vector<size_t> undelivered( pool.num_workers(), 0 );
+	size_t next_index = 0;
+	size_t num_success = 0;
+	size_t max_pending = 0;
+	const size_t max_ahead = 4 * pool.num_workers();
+
+	// the sink is called with the lock held; the AST of an arena is freed before the arena can be reset.
+	auto deliver = [&](size_t index, Parse_result &result, size_t worker) {
+		sink(index, result);
+		if (arenas[ worker ] != nullptr) {
+			result.ast_.reset();
+		}
+		undelivered[ worker ] -= 1;
+	};
+
+	pool.run( inputs.size(), [&](size_t worker, size_t index) {
+
+		Text_stream &stream = *streams[ worker ];
+		Ast_arena *arena = arenas[ worker ].get();
+		Parse_result result{false, Text_position(), Text_position()};
+
+		{
+			std::unique_lock<std::mutex> lock(sink_mutex);
+			if (order == Parse_many_order::in_order) {
+				delivered.wait( lock, [&]() { return index < next_index + max_ahead; } );
+			}
+			if (arena != nullptr && undelivered[ worker ] == 0) {
+				arena->reset();
+			}
+			undelivered[ worker ] += 1;
+		}
+
+		if (stream.open( inputs[ index ].c_str(), buf_size )) {
+			CharParser parser(stream);
+			parser.set_collision_checker(collision_checker);
+			if (arena != nullptr) {
+				parser.set_arena(arena);
+			}
+
+			result = Parser::parse(parser);
+			stream.close(false);
+		}
+
+		std::lock_guard<std::mutex> lock(sink_mutex);
+
+		if (result.success()) {
+			num_success += 1;
+		}
+
+		if (order == Parse_many_order::as_completed) {
+			deliver(index, result, worker);
+			return;
+		}
+
+		pending.emplace( index, Pending_result{ std::move(result), worker } );
+		for(auto pos = pending.begin(); pos != pending.end() && pos->first == next_index; pos = pending.erase(pos), ++next_index) {
+			deliver(pos->first, pos->second.result_, pos->second.worker_);
+		}
+		max_pending = std::max(max_pending, pending.size());
+		delivered.notify_all();
+	});
+
+	if (stats != nullptr) {
+		stats->max_pending_ = max_pending;
+		stats->steals_ = pool.steals();
+	}
+	return num_success;
+}
+
+} // namespace pparse
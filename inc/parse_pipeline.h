@@ -0,0 +1,225 @@
+#pragma once
+
+#include <stdint.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+namespace pparse {
+
+//
+// Bounded_queue - lock-free bounded queue for any number of producer and consumer threads
+//
+// The queue is a ring of cells, each cell has a sequence number that says if the cell is free for the producer of a position, or holds the value
+// for the consumer of that position; producers and consumers claim a position with a compare and swap on the enqueue or dequeue counter.
+// (the capacity is rounded up to a power of two)
+//
+
+template<typename Type>
+class Bounded_queue {
+public:
+	Bounded_queue(size_t capacity) : mask_(round_up(capacity) - 1), cells_(new Cell[ mask_ + 1 ]), enqueue_pos_(0), dequeue_pos_(0) {
+		for(size_t i = 0; i <= mask_; ++i) {
+			cells_[i].sequence_.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	Bounded_queue(const Bounded_queue &) = delete;
+	Bounded_queue &operator=(const Bounded_queue &) = delete;
+
+	// false if the queue is full, then value is not moved from.
+	bool try_push(Type &value) {
+		size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+		for(;;) {
+			Cell &cell = cells_[ pos & mask_ ];
+			size_t sequence = cell.sequence_.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+			if (diff == 0) {
+				if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.value_ = std::move(value);
+					cell.sequence_.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = enqueue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// false if the queue is empty
+	bool try_pop(Type &value) {
+		size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+		for(;;) {
+			Cell &cell = cells_[ pos & mask_ ];
+			size_t sequence = cell.sequence_.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+			if (diff == 0) {
+				if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					value = std::move(cell.value_);
+					cell.sequence_.store(pos + mask_ + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = dequeue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// number of values in the queue (approximate while other threads use the queue)
+	size_t size() const {
+		size_t enqueued = enqueue_pos_.load(std::memory_order_relaxed);
+		size_t dequeued = dequeue_pos_.load(std::memory_order_relaxed);
+		return enqueued > dequeued ? enqueued - dequeued : 0;
+	}
+
+	size_t capacity() const {
+		return mask_ + 1;
+	}
+
+private:
+	static size_t round_up(size_t capacity) {
+		size_t ret = 2;
+		while(ret < capacity) {
+			ret *= 2;
+		}
+		return ret;
+	}
+
+	struct Cell {
+		std::atomic<size_t> sequence_;
+		Type value_;
+	};
+
+	size_t mask_;
+	std::unique_ptr<Cell[]> cells_;
+
+	// the counters are on their own cache lines, producers and consumers don't invalidate each others line
+	alignas(64) std::atomic<size_t> enqueue_pos_;
+	alignas(64) std::atomic<size_t> dequeue_pos_;
+};
+
+//
+// Pipeline_stats - how the records have passed between the parser thread and the consumer threads of parse_pipeline
+//
+
+struct Pipeline_stats {
+	size_t records_;			// number of records that have been parsed and processed
+	size_t max_depth_;			// largest number of records in the queue
+	double average_depth_;		// number of records in the queue after a push, on average
+	size_t stalls_;				// number of times that the parser had to wait, because the queue was full
+	double stall_secs_;			// time that the parser waited for the consumers (back-pressure)
+	double idle_secs_;			// time that the consumers waited for records (sum over all consumer threads)
+	double total_secs_;
+	double records_per_sec_;
+};
+
+//
+// parse_pipeline - parse a stream of records on the calling thread, and process the records on num_consumers consumer threads.
+//
+// The records are parsed with PStream<Record> and pushed into a Bounded_queue of queue_depth records; if the queue is full then the parser waits
+// for the consumers (back-pressure). The consumer is called as consumer(size_t consumer_index, Parse_result &record) on the consumer threads,
+// concurrently; it can take over the AST of the record, else the AST is freed after the call. The AST nodes are freed by the consumer threads,
+// so the memory resource of the parser must be thread safe (the default resource is).
+// Returns the result of PStream<Record>::parse, once all records have been processed.
+//
+
+template<typename Record, typename ParserBase, typename Consumer>
+Parse_result parse_pipeline(ParserBase &base, Consumer consumer, size_t num_consumers = 0, size_t queue_depth = 1024, Pipeline_stats *stats = nullptr) {
+
+	if (num_consumers == 0) {
+		num_consumers = std::max( (size_t) std::thread::hardware_concurrency(), (size_t) 2) - 1;
+	}
+
+	Bounded_queue<Parse_result> queue(queue_depth);
+	std::atomic<bool> done(false);
+	std::vector< std::chrono::steady_clock::duration > idle( num_consumers, std::chrono::steady_clock::duration::zero() );
+
+	// spin, then yield and sleep for longer periods
+	auto backoff = [](int count) {
+		if (count < 64) {
+			return;
+		}
+		if (count < 1024) {
+			std::this_thread::yield();
+		} else {
+			std::this_thread::sleep_for( std::chrono::microseconds(50) );
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for(size_t index = 0; index < num_consumers; ++index) {
+		threads.emplace_back( [&, index]() {
+			Parse_result record{false, Text_position(), Text_position()};
+			for(;;) {
+				if (queue.try_pop(record)) {
+					consumer(index, record);
+					record.ast_.reset();
+					continue;
+				}
+				// the parser is done once it has pushed the last record, so the queue is empty for good.
+				if (done.load(std::memory_order_acquire) && queue.size() == 0) {
+					return;
+				}
+				auto wait_start = std::chrono::steady_clock::now();
+				for(int count = 0; queue.size() == 0 && !done.load(std::memory_order_acquire); ++count) {
+					backoff(count);
+				}
+				idle[ index ] += std::chrono::steady_clock::now() - wait_start;
+			}
+		});
+	}
+
+	size_t records = 0;
+	size_t depth_sum = 0;
+	size_t max_depth = 0;
+	size_t stalls = 0;
+	std::chrono::steady_clock::duration stall_time = std::chrono::steady_clock::duration::zero();
+
+	Parse_result res = PStream<Record>::parse(base, [&](Parse_result &record) {
+		if (!queue.try_push(record)) {
+			auto wait_start = std::chrono::steady_clock::now();
+			for(int count = 0; !queue.try_push(record); ++count) {
+				backoff(count);
+			}
+			stall_time += std::chrono::steady_clock::now() - wait_start;
+			stalls += 1;
+		}
+		size_t depth = queue.size();
+		depth_sum += depth;
+		max_depth = std::max(max_depth, depth);
+		records += 1;
+	});
+
+	done.store(true, std::memory_order_release);
+	for(auto &thread : threads) {
+		thread.join();
+	}
+
+	if (stats != nullptr) {
+		std::chrono::steady_clock::duration idle_time = std::chrono::steady_clock::duration::zero();
+		for(auto &time : idle) {
+			idle_time += time;
+		}
+
+		stats->records_ = records;
+		stats->max_depth_ = max_depth;
+		stats->average_depth_ = records != 0 ? (double) depth_sum / records : 0;
+		stats->stalls_ = stalls;
+		stats->stall_secs_ = std::chrono::duration<double>(stall_time).count();
+		stats->idle_secs_ = std::chrono::duration<double>(idle_time).count();
+		stats->total_secs_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		stats->records_per_sec_ = stats->total_secs_ > 0 ? records / stats->total_secs_ : 0;
+	}
+	return res;
+}
+
+} // namespace pparse
@@ -0,0 +1,364 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+namespace pparse {
+
+enum class Associativity {
+	left,		// a - b - c is (a - b) - c
+	right,		// a ^ b ^ c is a ^ (b ^ c)
+};
+
+//
+// Binary_op - binary operator of a PPrecedence rule: the operator is parsed by Op (usually a PTok), operators with a higher precedence bind stronger.
+//
+
+template<typename Op, int precedence, Associativity associativity = Associativity::left>
+struct Binary_op {
+	using OpType = Op;
+
+	static constexpr int PRECEDENCE = precedence;
+
+	static constexpr bool RIGHT_ASSOCIATIVE = associativity == Associativity::right;
+
+	static constexpr bool PREFIX = false;
+};
+
+//
+// Prefix_op - unary prefix operator of a PPrecedence rule (like the minus sign in -a)
+//
+
+template<typename Op, int precedence>
+struct Prefix_op {
+	using OpType = Op;
+
+	static constexpr int PRECEDENCE = precedence;
+
+	static constexpr bool RIGHT_ASSOCIATIVE = true;
+
+	static constexpr bool PREFIX = true;
+};
+
+//
+// PPrecedence - expression with operators (Binary_op, Prefix_op) between operands, parsed by precedence climbing.
+//
+// Instead of a rule per precedence level (Expr, MultExpr, SimpleExpr ...) an expression is parsed in a loop over operands and operators, with a stack of the pending operators:
+// an operator on the stack is applied once the next operator binds less strongly. The stack depth of the parser doesn't grow with the length of an operator chain.
+// If a binary operator is not followed by an operand, then the expression ends before the operator.
+//
+// The AST is a binary tree: a node is either an operand (op_ is -1), or the application of the operator with index op_ in Ops (lhs_ is empty for a prefix operator).
+//
+
+template<RuleId ruleId, typename Operand, typename ...Ops>
+struct PPrecedence : ParserBase {
+
+	static inline const RuleId RULE_ID = ruleId;
+
+    using ThisClass = PPrecedence<ruleId, Operand, Ops...>;
+
+	struct AstType : AstEntryBase {
+		AstType() : AstEntryBase(ruleId), op_(-1) {
+		}
+
+		// the nodes of a long chain are freed in a loop, not recursively.
+		~AstType() {
+			if (lhs_ == nullptr && rhs_ == nullptr) {
+				return;
+			}
+
+			std::vector< std::unique_ptr<AstType> > nodes;
+			nodes.push_back( std::move(lhs_) );
+			nodes.push_back( std::move(rhs_) );
+
+			while(!nodes.empty()) {
+				std::unique_ptr<AstType> node = std::move( nodes.back() );
+				nodes.pop_back();
+				if (node != nullptr) {
+					nodes.push_back( std::move(node->lhs_) );
+					nodes.push_back( std::move(node->rhs_) );
+				}
+			}
+		}
+
+		bool is_operand() const {
+			return op_ == -1;
+		}
+
+		int op_;
+		std::unique_ptr<typename Operand::AstType> operand_;
+		std::unique_ptr<AstType> lhs_;
+		std::unique_ptr<AstType> rhs_;
+	};
+
+    template<typename ParserBase>
+	static Parse_result  parse(ParserBase &base) {
+
+		if constexpr (ParserBase::emit_events) {
+			return Event_rule<ThisClass>::parse(base, recognize_expression<ParserBase>);
+		}
+		if constexpr (ParserBase::synthesize_values) {
+			return Value_rule::parse(base, recognize_expression<ParserBase>);
+		}
+		if (!base.build_ast_) {
+			return recognize_expression(base);
+		}
+
+		Text_position start_pos = ParserBase::current_pos_and_inc_nesting(base);
+
+#ifdef __PARSER_TRACE__
+		std::string short_name = VisualizeTrace<ThisClass>::trace_start_parsing(start_pos);
+#endif
+
+		std::vector< std::unique_ptr<AstType> > operands;
+		std::vector<Pending_op> ops;
+
+		// position and size of the operator stack before the last binary operator
+		Text_position before_op;
+		size_t ops_before_op = 0;
+		bool after_binary_op = false;
+
+		for(;;) {
+			Pending_op op;
+
+			while((op.op_ = parse_op<true, 0, ParserBase, Ops...>(base, &op.start_)) != -1) {
+				ops.push_back(op);
+			}
+
+			Parse_result res = Operand::parse(base);
+			if (!res.success_) {
+				if (!after_binary_op || !ParserBase::can_backtrack(base, before_op)) {
+					if (ParserBase::can_backtrack(base, start_pos)) {
+						ParserBase::backtrack(base, start_pos);
+					}
+
+#ifdef __PARSER_TRACE__
+					VisualizeTrace<ThisClass>::end_parsing(short_name, false, ParserBase::current_pos(base));
+#endif
+					return Parse_result{false, res.start_, res.end_};
+				}
+
+				// the last binary operator is not followed by an operand: the expression ends before the operator.
+				ParserBase::seek(base, before_op);
+				ops.resize(ops_before_op);
+				break;
+			}
+
+			auto operand = make_ast<AstType>(base);
+			operand->operand_.reset( (typename Operand::AstType *) res.ast_.release() );
+			operand->start_ = res.start_;
+			operand->end_ = res.end_;
+			operands.push_back( std::move(operand) );
+
+			before_op = ParserBase::current_pos(base);
+
+			op.op_ = parse_op<false, 0, ParserBase, Ops...>(base, &op.start_);
+			if (op.op_ == -1) {
+				ParserBase::seek(base, before_op);
+				break;
+			}
+
+			while(!ops.empty() && applies_before(ops.back().op_, op.op_)) {
+				reduce(base, operands, ops);
+			}
+			ops_before_op = ops.size();
+			ops.push_back(op);
+			after_binary_op = true;
+		}
+
+		while(!ops.empty()) {
+			reduce(base, operands, ops);
+		}
+
+		ParserBase::dec_position_nesting(base);
+
+#ifdef __PARSER_TRACE__
+		VisualizeTrace<ThisClass>::end_parsing(short_name, true, ParserBase::current_pos(base));
+#endif
+
+		AstType *ast = operands.back().release();
+		return Parse_result{true, ast->start_, ast->end_, std::unique_ptr<AstEntryBase>(ast) };
+	}
+
+#ifdef __PARSER_ANALYSE__
+		template<typename HelperType>
+		static bool verify_no_cycles(HelperType *,CycleDetectorHelper &helper, std::ostream &out) {
+
+			if (!helper.push_and_check(out, get_tinfo((Operand *) nullptr), -1)) {
+                return false;
+            }
+
+			bool ret = Operand::verify_no_cycles((HelperType *) nullptr, helper, out) ;
+
+			helper.pop();
+
+			return ret;
+		}
+
+		template<typename HelperType>
+		static bool can_accept_empty_input(HelperType *arg) {
+			return Operand::can_accept_empty_input(arg);
+		}
+#endif
+
+	template<typename Stream>
+	static void dumpJson(Stream &out,  const AstType *ast) {
+			Json<Stream>::dumpRule(out, RULE_ID, "PPrecedence" );
+
+			if (ast->is_operand()) {
+				Json<Stream>::jsonStartNested(out, "operand");
+				Operand::dumpJson(out, ast->operand_.get());
+				Json<Stream>::jsonEndNested(out, true);
+			} else {
+				Json<Stream>::jsonAddField(out, "op", ast->op_);
+				if (ast->lhs_ != nullptr) {
+					Json<Stream>::jsonStartNested(out, "lhs");
+					dumpJson(out, ast->lhs_.get());
+					Json<Stream>::jsonEndNested(out, false);
+				}
+				Json<Stream>::jsonStartNested(out, "rhs");
+				dumpJson(out, ast->rhs_.get());
+				Json<Stream>::jsonEndNested(out, true);
+			}
+
+			Json<Stream>::jsonEndTag(out, true);
+	}
+
+     	template<typename ParserBase>
+        static void init_collision_checker(ParserBase &base) {
+
+           if (base.colission_checker_ != nullptr && base.colission_checker_->insert_type_info(&typeid(ThisClass))) {
+               Operand::init_collision_checker(base);
+               ( Ops::OpType::init_collision_checker(base), ... );
+               base.colission_checker_->remove_type_info(&typeid(ThisClass));
+            }
+        }
+
+		// an expression starts with a prefix operator or with an operand
+		static First_set first_set(First_set_path &path) {
+			First_set ret = first_set_of<Operand>(path);
+			( add_prefix_first_set<Ops>(ret, path), ... );
+			return ret;
+		}
+
+private:
+	struct Pending_op {
+		int op_;
+		Position start_;
+	};
+
+	static constexpr int precedence_[] = { Ops::PRECEDENCE... };
+
+	static constexpr bool right_associative_[] = { Ops::RIGHT_ASSOCIATIVE... };
+
+	static constexpr bool prefix_[] = { Ops::PREFIX... };
+
+	// the pending operator on the stack is applied before the next binary operator
+	static bool applies_before(int pending, int next) {
+		return precedence_[ pending ] > precedence_[ next ] || (precedence_[ pending ] == precedence_[ next ] && !right_associative_[ next ]);
+	}
+
+	// apply the operator on top of the operator stack to the operands on top of the operand stack.
+	template<typename ParserBase>
+	static void reduce(ParserBase &base, std::vector< std::unique_ptr<AstType> > &operands, std::vector<Pending_op> &ops) {
+
+		Pending_op op = ops.back();
+		ops.pop_back();
+
+		auto node = make_ast<AstType>(base);
+		node->op_ = op.op_;
+		node->rhs_ = std::move( operands.back() );
+		operands.pop_back();
+
+		if (prefix_[ op.op_ ]) {
+			node->start_ = op.start_;
+		} else {
+			node->lhs_ = std::move( operands.back() );
+			operands.pop_back();
+			node->start_ = node->lhs_->start_;
+		}
+		node->end_ = node->rhs_->end_;
+		operands.push_back( std::move(node) );
+	}
+
+	// parse one of the operators (prefix or binary), in the order of Ops; returns the index of the operator in Ops, -1 if none of them matches.
+	template<bool Prefix, size_t Index, typename ParserBase, typename Op, typename ...Rest>
+	static int parse_op(ParserBase &base, Position *start) {
+
+		if constexpr (Op::PREFIX == Prefix) {
+			Parse_result res = Op::OpType::parse(base);
+			if (res.success_) {
+				*start = res.start_;
+				return (int) Index;
+			}
+		}
+
+		if constexpr (sizeof...(Rest) > 0) {
+			return parse_op<Prefix, Index + 1, ParserBase, Rest...>(base, start);
+		}
+		return -1;
+	}
+
+	// the parser doesn't build an AST (see recognize): the precedence of the operators doesn't matter, the operands and operators are parsed without the stacks.
+	template<typename ParserBase>
+	static Parse_result recognize_expression(ParserBase &base) {
+
+		Text_position start_pos = ParserBase::current_pos_and_inc_nesting(base);
+
+		Position start;
+		Position end;
+		Position op_start;
+		Text_position before_op;
+		bool after_binary_op = false;
+
+		for(;;) {
+			bool is_first = !after_binary_op;
+			bool after_prefix_op = false;
+
+			while(parse_op<true, 0, ParserBase, Ops...>(base, &op_start) != -1) {
+				if (is_first && !after_prefix_op) {
+					start = op_start;
+				}
+				after_prefix_op = true;
+			}
+
+			Parse_result res = Operand::parse(base);
+			if (!res.success_) {
+				if (!after_binary_op || !ParserBase::can_backtrack(base, before_op)) {
+					if (ParserBase::can_backtrack(base, start_pos)) {
+						ParserBase::backtrack(base, start_pos);
+					}
+					return Parse_result{false, res.start_, res.end_};
+				}
+
+				// the last binary operator is not followed by an operand: the expression ends before the operator.
+				ParserBase::seek(base, before_op);
+				break;
+			}
+			if (is_first && !after_prefix_op) {
+				start = res.start_;
+			}
+			end = res.end_;
+
+			before_op = ParserBase::current_pos(base);
+
+			if (parse_op<false, 0, ParserBase, Ops...>(base, &op_start) == -1) {
+				ParserBase::seek(base, before_op);
+				break;
+			}
+			after_binary_op = true;
+		}
+
+		ParserBase::dec_position_nesting(base);
+		return Parse_result{true, start, end};
+	}
+
+	template<typename Op>
+	static void add_prefix_first_set(First_set &ret, First_set_path &path) {
+		if constexpr (Op::PREFIX) {
+			ret.add( first_set_of<typename Op::OpType>(path) );
+		}
+	}
+};
+
+} // namespace pparse
@@ -4,19 +4,31 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/uio.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <errno.h>
 #include <utility>
 #include <memory>
 #include <vector>
+#include <algorithm>
+#include <string_view>
 #include <errno.h>
 #include <stdlib.h>
 #include "parse_base.h"
+#include "read_ahead.h"
 #include <memory.h>
 
 namespace pparse {
 
+//
+// Text_position - position of the cursor in the text.
+//
+// By default only the offset in the text is tracked, the line and column of an offset are computed on demand from the Line_index of the text stream.
+// If __PARSER_EAGER_POSITION__ is defined then the line and column are also updated for each consumed character (that's slower)
+//
+
 struct Text_position {
+#ifdef __PARSER_EAGER_POSITION__
     Text_position() : line_(1), column_(0), buffer_pos_((FilePos_t) 0) { }
 
     void next_char(Char_t ch) {
@@ -29,59 +41,273 @@ struct Text_position {
         ++buffer_pos_;
     }
 
+    void next_chars(const Char_t *data, size_t len) {
+        const Char_t *last_newline = nullptr;
+        const Char_t *eof = data + len;
+
+        for(const Char_t *pos = data; pos < eof; ++pos) {
+            pos = (const Char_t *) memchr(pos, '\n', eof - pos);
+            if (pos == nullptr) {
+                break;
+            }
+            ++line_;
+            last_newline = pos;
+        }
+        if (last_newline != nullptr) {
+            column_ = eof - last_newline - 1;
+        } else {
+            column_ += len;
+        }
+        buffer_pos_ += len;
+    }
+
+    // step back to the previous character (used for the end position of a token, that's the position of its last character)
+    void prev_char() {
+        --column_;
+        --buffer_pos_;
+    }
+
     int line_;
     int column_;
+#else
+    Text_position() : buffer_pos_((FilePos_t) 0) { }
+
+    void next_char(Char_t) {
+        ++buffer_pos_;
+    }
+
+    void next_chars(const Char_t *, size_t len) {
+        buffer_pos_ += len;
+    }
+
+    // step back to the previous character (used for the end position of a token, that's the position of its last character)
+    void prev_char() {
+        --buffer_pos_;
+    }
+#endif
     FilePos_t buffer_pos_;
 };
 
+//
+// Line_column - line and column of an offset in the text; the first line is 1, the first column is 0.
+//
+
+struct Line_column {
+    Line_column(int line, int column) : line_(line), column_(column) {
+    }
+
+    bool operator==(const Line_column &arg) const {
+        return arg.line_ == line_ && arg.column_ == column_;
+    }
+
+    int line() const {
+        return line_;
+    }
+
+    int column() const {
+        return column_;
+    }
+
+    int line_;
+    int column_;
+};
+
+//
+// Line_index - offsets of the newline characters of the text.
+//
+// The text is added in order, as it enters the stream (memchr is used to find the newlines), 
+// the line of an offset is found by binary search over the newline offsets; the line of the last lookup is cached, as lookups tend to be close to each other.
+//
+// The stream calls discard_before with its head position, when it moves on: the newlines before the line of the head are dropped, and counted in
+// a base line number, so that the index of a long running stream stays bounded. The line of an offset before the head is then unknown,
+// line_column returns line 0 for it. (with keep_all(true) all newlines are kept, for lookups of any offset after the parse)
+//
+
+class Line_index {
+public:
+    Line_index() : indexed_(0), cached_line_(0), dropped_(0), first_(0), trimmed_(false), keep_all_(false) {
+    }
+
+    void add_text(const Char_t *data, size_t len) {
+        const Char_t *eof = data + len;
+
+        for(const Char_t *pos = data; pos < eof; ++pos) {
+            pos = (const Char_t *) memchr(pos, '\n', eof - pos);
+            if (pos == nullptr) {
+                break;
+            }
+            newlines_.push_back( indexed_ + (pos - data) );
+        }
+        indexed_ += len;
+    }
+
+    // number of characters that have been added to the index
+    FilePos_t indexed() const {
+        return indexed_;
+    }
+
+    // number of newline offsets in the index
+    size_t entries() const {
+        return newlines_.size();
+    }
+
+    void keep_all(bool keep) {
+        keep_all_ = keep;
+    }
+
+    // offsets before offset are no longer looked up: drop the newlines before the line of offset (the last newline before offset is kept, it's the start of the line)
+    void discard_before(FilePos_t offset) {
+        if (keep_all_) {
+            return;
+        }
+        size_t last = std::lower_bound(newlines_.begin() + first_, newlines_.end(), offset) - newlines_.begin();
+        if (last <= first_ + (trimmed_ ? 1 : 0)) {
+            return;
+        }
+        first_ = last - 1;
+        trimmed_ = true;
+
+        // the dropped entries are erased once they are the bigger part of the vector, so that erasing costs constant time per entry
+        if (first_ >= Min_erase && first_ * 2 >= newlines_.size()) {
+            newlines_.erase(newlines_.begin(), newlines_.begin() + first_);
+            dropped_ += first_;
+            first_ = 0;
+        }
+    }
+
+    Line_column line_column(FilePos_t offset) {
+
+        // the line of the first kept newline is the first line that can be looked up
+        size_t first_line = trimmed_ ? dropped_ + first_ + 1 : 0;
+        if (trimmed_ && offset <= newlines_[ first_ ]) {
+            return Line_column(0, 0);
+        }
+
+        size_t line = cached_line_;
+        if (line < first_line || offset < line_start(line) || (line - dropped_ < newlines_.size() && offset > newlines_[ line - dropped_ ])) {
+            line = dropped_ + (std::lower_bound(newlines_.begin() + first_, newlines_.end(), offset) - newlines_.begin());
+            cached_line_ = line;
+        }
+        return Line_column( (int) line + 1, (int) (offset - line_start(line)) );
+    }
+
+    void clear() {
+        newlines_.clear();
+        indexed_ = 0;
+        cached_line_ = 0;
+        dropped_ = 0;
+        first_ = 0;
+        trimmed_ = false;
+    }
+
+private:
+    static const size_t Min_erase = 1024;
+
+    // line is the number of newlines before the line (counting the dropped newlines)
+    FilePos_t line_start(size_t line) const {
+        return line == 0 ? 0 : newlines_[ line - 1 - dropped_ ] + 1;
+    }
+
+    std::vector<FilePos_t> newlines_;
+    FilePos_t indexed_;
+    size_t cached_line_;
+    size_t dropped_;	// number of newlines that have been erased from the front of newlines_
+    size_t first_;		// index of the first newline in newlines_ that is kept (if trimmed_)
+    bool trimmed_;
+    bool keep_all_;
+};
+
+
+//
+// Text_input_waiter - called by Text_stream if it has no input, but the end of input has not been reached yet:
+// that's the case if the file descriptor is non blocking, or if the text is written into the stream with write_tail.
+// wait_for_input returns once more input may be available; it returns false if there is no more input.
+//
+
+struct Text_input_waiter {
+    virtual ~Text_input_waiter() {
+    }
+
+    virtual bool wait_for_input() = 0;
+};
+
 
 // head_ == tail_ : buffer is empty
 // (tail+1) % size_ == head_ : buffer is full
 // cursor_ in range [ head_, (head_+1) % size_, ....  tail_ ]
 //
 // tail_ - doesn't hold any data. the buffer can therefore hold size() - 1 bytes.`
+//
+// The buffer is a memfd that is mapped twice, back to back (mirrored): the byte at buf_[ i + size_ ] is the same as the byte at buf_[ i ],
+// therefore any range of the buffer [ cursor_, cursor_ + n ) with n < size_ is contiguous memory, even if it wraps around the end of the buffer.
+// If the mirrored mapping can't be created then a plain array is used (mirrored_ is false), a contiguous range then ends at the end of the array.
+//
+// The position of a byte in the buffer is its offset in the text modulo size_ (see set_cursor)
 
 class Text_ringbuffer {
 public:
 
+    Text_ringbuffer() : size_(0), buf_(nullptr), head_(0), tail_(0), cursor_(0), mirrored_(false) {
+    }
+
+	// a buffer that has been kept by close(false) is reused, if it is large enough.
     bool init(uint32_t size) {
-        buf_ = new Char_t[ size ];
-        size_ = size;
+        if (buf_ == nullptr || size_ < size) {
+            release(buf_, size_, mirrored_);
+            buf_ = nullptr;
+            if (!alloc(size, &buf_, &size_, &mirrored_)) {
+                return false;
+            }
+        }
         head_ = tail_ = cursor_ = 0;
-        return buf_ != nullptr;
+        return true;
     }
 
-	void close() {
-		delete [] buf_;
-		buf_ = nullptr;
-        size_ = head_ = tail_ = cursor_ = 0;
+	void close(bool release_buffer = true) {
+		if (release_buffer) {
+			release(buf_, size_, mirrored_);
+			buf_ = nullptr;
+			size_ = 0;
+		}
+        head_ = tail_ = cursor_ = 0;
  
 	}
 
     ~Text_ringbuffer() {
-        delete [] buf_;
+		release(buf_, size_, mirrored_);
     }
 
-	bool resize(uint32_t must_have = 0) {
-		uint32_t newsize;
+	// grow the buffer, the text in the buffer starts at offset pos_at_head of the text.
+	bool resize(FilePos_t pos_at_head, uint32_t must_have = 0) {
+		uint32_t newsize = size_;
 
 		do {
-				if (size_ <= ON_RESIZE_DOUBLE_BUFFER_TILL) {
-					newsize = 2 * size_;
+				if (newsize <= ON_RESIZE_DOUBLE_BUFFER_TILL) {
+					newsize = 2 * newsize;
 				} else {
-					newsize = size_ + ON_RESIZE_DOUBLE_BUFFER_TILL;
+					newsize = newsize + ON_RESIZE_DOUBLE_BUFFER_TILL;
 				}
 		} while( newsize < must_have );
 
-		Char_t *newbuf = new Char_t[ newsize ];
-		if (newbuf == nullptr) {
+		Char_t *newbuf;
+		bool newmirrored;
+		if (!alloc(newsize, &newbuf, &newsize, &newmirrored)) {
 			return false;
 		}
 
-		memcpy(newbuf, buf_, size_);
-		delete [] buf_;
+		uint32_t len = size();
+		uint32_t cursor_offset = cursor_offset_from_head();
+		uint32_t newhead = pos_at_head % newsize;
+
+		copy_out(head_, len, newbuf, newsize, newhead);
+
+		release(buf_, size_, mirrored_);
 		buf_ = newbuf;
 		size_ = newsize;
+		mirrored_ = newmirrored;
+		head_ = newhead;
+		tail_ = (newhead + len) % newsize;
+		cursor_ = (newhead + cursor_offset) % newsize;
 		
 		return true;
 	}
@@ -135,6 +361,26 @@ public:
         return size_-head_ + tail_;
     }
 
+	// number of text bytes between the cursor and the tail of the buffer
+    uint32_t available_at_cursor() const {
+        if (cursor_ <= tail_) {
+            return tail_ - cursor_;
+        }
+        return size_ - cursor_ + tail_;
+    }
+
+	// number of text bytes at the cursor that are in contiguous memory
+    uint32_t contiguous_at_cursor() const {
+        uint32_t available = available_at_cursor();
+        if (mirrored_) {
+            return available;
+        }
+        return std::min(available, size_ - cursor_);
+    }
+
+    const Char_t *cursor_ptr() const {
+        return buf_ + cursor_;
+    }
 
     bool inc_cursor() {
         if (!is_valid_pos(cursor_)) {
@@ -144,6 +390,10 @@ public:
         return true;
     }
 
+    void inc_cursor(uint32_t inc_by) {
+        cursor_ = (cursor_ + inc_by) % size_;
+    }
+
     void set_cursor(FilePos_t  cursor_pos) {
         cursor_ = cursor_pos % size_;
     }
@@ -173,6 +423,88 @@ public:
     uint32_t size_;
     Char_t *buf_;
     uint32_t head_,tail_, cursor_;
+    bool mirrored_;
+
+private:
+    uint32_t cursor_offset_from_head() const {
+        if (head_ <= cursor_) {
+            return cursor_ - head_;
+        }
+        return size_ - head_ + cursor_;
+    }
+
+	// copy len bytes starting at index from of this buffer into the ring newbuf at index to
+    void copy_out(uint32_t from, uint32_t len, Char_t *newbuf, uint32_t newsize, uint32_t to) const {
+        while(len > 0) {
+            uint32_t chunk = std::min( { len, size_ - from, newsize - to } );
+            memcpy(newbuf + to, buf_ + from, chunk);
+            from = (from + chunk) % size_;
+            to = (to + chunk) % newsize;
+            len -= chunk;
+        }
+    }
+
+    static bool alloc(uint32_t size, Char_t **buf, uint32_t *buf_size, bool *mirrored) {
+
+        Char_t *mbuf = alloc_mirrored(size, buf_size);
+        if (mbuf != nullptr) {
+            *buf = mbuf;
+            *mirrored = true;
+            return true;
+        }
+
+        *buf = new Char_t[ size ];
+        *buf_size = size;
+        *mirrored = false;
+        return *buf != nullptr;
+    }
+
+    static Char_t *alloc_mirrored(uint32_t size, uint32_t *buf_size) {
+#ifdef MFD_CLOEXEC
+        uint32_t page_size = sysconf(_SC_PAGESIZE);
+        uint32_t map_size = (size + page_size - 1) / page_size * page_size;
+
+        int fd = memfd_create("pparse_ringbuffer", MFD_CLOEXEC);
+        if (fd == -1) {
+            return nullptr;
+        }
+        if (ftruncate(fd, map_size) != 0) {
+            ::close(fd);
+            return nullptr;
+        }
+
+        void *addr = mmap(nullptr, 2 * map_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            return nullptr;
+        }
+
+        Char_t *buf = (Char_t *) addr;
+        if (mmap(buf, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+            mmap(buf + map_size, map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            munmap(addr, 2 * map_size);
+            ::close(fd);
+            return nullptr;
+        }
+        ::close(fd);
+
+        *buf_size = map_size;
+        return buf;
+#else
+        return nullptr;
+#endif
+    }
+
+    static void release(Char_t *buf, uint32_t size, bool mirrored) {
+        if (buf == nullptr) {
+            return;
+        }
+        if (mirrored) {
+            munmap(buf, 2 * size);
+        } else {
+            delete [] buf;
+        }
+    }
 };
 
 class Text_stream {
@@ -181,10 +513,11 @@ public:
 
     using Next_char_value = std::pair<bool, Char_t>;
 
-    Text_stream(bool resize_if_full = true) : fd_(-1), error_(0), pos_at_head_(0), resize_if_full_(resize_if_full), position_nesting_(0) {
+    Text_stream(bool resize_if_full = true) : fd_(-1), error_(0), eof_(false), input_waiter_(nullptr), pos_at_head_(0), resize_if_full_(resize_if_full), position_nesting_(0), generation_(0) {
     }
 
     ~Text_stream() {
+        read_ahead_.stop();
         if (fd_ != -1) {
             ::close(fd_);
         }
@@ -213,6 +546,12 @@ public:
 
     bool open(int fd, uint32_t buf_size = Default_buf_size ) {
         fd_ = fd;
+        eof_ = false;
+        generation_ += 1;
+        pos_at_head_ = 0;
+        pos_at_cursor_ = Text_position();
+        position_nesting_ = 0;
+        lines_.clear();
         if (!buf_.init(buf_size)) {
             ERROR("Can't allocate buffer error %d\n", errno);
             ::close(fd_);
@@ -222,7 +561,28 @@ public:
         return true;
     }
 
-    bool close() {
+	// start a thread that reads the input ahead of the parser (call after open); 
+	// the parser then copies the input from the read-ahead segments, and doesn't wait for the read system call, unless the read-ahead thread is behind.
+    bool start_read_ahead(uint32_t segment_size = Text_read_ahead::Default_segment_size) {
+        if (fd_ == -1) {
+            ERROR("Can't start read-ahead without open file\n");
+            return false;
+        }
+        return read_ahead_.start(fd_, segment_size);
+    }
+
+    Read_ahead_stats read_ahead_stats() const {
+        return read_ahead_.stats();
+    }
+
+	// the input waiter is called if the stream runs out of input before the end of input is reached (see Push_parser)
+    void set_input_waiter(Text_input_waiter *waiter) {
+        input_waiter_ = waiter;
+    }
+
+	// with release_buffer == false the lookahead buffer is kept, and reused by the next call to open (saves the allocation when many small files are parsed one after the other)
+    bool close(bool release_buffer = true) {
+         read_ahead_.stop();
          if (fd_ != -1) {
             if (::close(fd_) != 0) {
 				ERROR("close failed. errno %d\n", errno);
@@ -230,14 +590,14 @@ public:
 			}
    			fd_ = -1;
      	} 
-		buf_.close();
+		buf_.close(release_buffer);
         return true;
     }
 
     bool write_tail(const Char_t *data, uint32_t data_len) {
         if (buf_.free() < data_len) {
 			if (resize_if_full_) {
-				if (!buf_.resize(buf_.size() + data_len + 1)) {
+				if (!buf_.resize(pos_at_head_, buf_.size() + data_len + 1)) {
 					return false;
 				}
 			} else {
@@ -259,6 +619,7 @@ public:
             memcpy((uint8_t *) buf_.buf_ + buf_.tail_, data, data_len ); 
         }
 
+        index_tail( data_len );
         return buf_.inc_tail( data_len );
     }
 
@@ -266,55 +627,50 @@ public:
 
         if (buf_.eof_cursor()) {
             // if out of data then read as much as possible.
-            if (buf_.empty()) {
-
-                if (!read_empty()) {
-                    // read error
-                    return Next_char_value(false,' ');
-                }
-
-
-            } else if (!buf_.full()) {
-                      
-                if (!read_next()) {
-                    // read error
-                    return Next_char_value(false,' ');
-                }
-
-            } else {
-				if (fd_ != -1) {
-					if (resize_if_full_) {
-						if (!buf_.resize()) {
-							ERROR("Failed to resize the buffer\n");
-							return Next_char_value(false,' ');
-						} 
-						if (!read_next()) {
-							// read error
-							return Next_char_value(false,' ');
-						}
-
-					} else {
-                		ERROR("buffer is full and can't read any more data\n");
-					}
-				}
+            if (!fill()) {
                 return Next_char_value(false,' ');
             }
         }         
 
-        if (buf_.empty()) {
-            // end of text has been reached.
-            return Next_char_value(false,' ');
+       auto cur_char = buf_.cursor_char();
+       return Next_char_value(true,cur_char);
+    }
+
+	// returns a view of the next len characters at the cursor; the view is shorter if the end of input is reached, 
+	// or if the buffer is not mirrored and the characters wrap around the end of the buffer.
+	// The cursor is not moved.
+    std::string_view peek(uint32_t len) {
+        while (buf_.available_at_cursor() < len) {
+            if (!fill()) {
+                break;
+            }
         }
+        return std::string_view( buf_.cursor_ptr(), std::min(len, buf_.contiguous_at_cursor()) );
+    }
 
+	// returns a view of all characters at the cursor that are available in the buffer; the view is empty at the end of input.
+    std::string_view span() {
         if (buf_.eof_cursor()) {
-            ERROR("HOW?\n");
-            exit(1);
-            exit(1);
+            if (!fill()) {
+                return std::string_view();
+            }
         }
-       auto cur_char = buf_.cursor_char();
-       return Next_char_value(true,cur_char);
+        return std::string_view( buf_.cursor_ptr(), buf_.contiguous_at_cursor() );
     }
 
+	// move the cursor by len characters, the characters must have been returned by peek or span.
+    void advance(uint32_t len) {
+        while (len > 0) {
+            uint32_t chunk = std::min(len, buf_.contiguous_at_cursor());
+            if (chunk == 0) {
+                ERROR("advance beyond end of buffer\n");
+                break;
+            }
+            pos_at_cursor_.next_chars(buf_.cursor_ptr(), chunk);
+            buf_.inc_cursor(chunk);
+            len -= chunk;
+        }
+    }
 
     Next_char_value next_char() {
 
@@ -352,6 +708,21 @@ public:
         return true;
     }
 
+	// set the cursor to a position that has already been read, the nesting level of positions is not changed.
+    bool seek(Text_position pos) {
+        if (pos.buffer_pos_ < pos_at_head_ || pos.buffer_pos_ > (pos_at_head_ + buf_.size()) ) {
+            ERROR("can't set text position - out of range pos %ld  head_pos %ld size %u\n", pos.buffer_pos_, pos_at_head_, buf_.size());
+            return false;
+        }
+        pos_at_cursor_ = pos;
+        buf_.set_cursor( pos_at_cursor_.buffer_pos_ );
+        return true;
+    }
+
+    FilePos_t pos_at_head() const {
+        return pos_at_head_;
+    }
+
 	bool dec_position_nesting() {
 		if (position_nesting_ == 0) {
 			ERROR("position nesting droppes to negative count. parser is wrong\n");
@@ -374,14 +745,55 @@ public:
         buf_.set_cursor_and_head(pos.buffer_pos_);
         pos_at_cursor_ = pos;
         pos_at_head_ = pos.buffer_pos_; 
+        lines_.discard_before(pos_at_head_);
         return true;
     }
 
     int error() { return error_; }
 
+	// size of the lookahead buffer (it grows if a rule needs a longer lookahead)
+    uint32_t buffer_size() const {
+        return buf_.size_;
+    }
+
+	// incremented each time that the stream is opened: a position of the previous text is no longer valid
+    uint32_t generation() const {
+        return generation_;
+    }
+
+	// by default the line index drops the newlines before the head of the stream, line_column then works for offsets after the head only;
+	// with keep == true the whole index is kept (it grows with the number of lines of the input)
+    void keep_line_index(bool keep) {
+        lines_.keep_all(keep);
+    }
+
+	// number of newline offsets in the line index
+    size_t line_index_entries() const {
+        return lines_.entries();
+    }
+
+	// line and column of an offset in the text
+    Line_column line_column(FilePos_t offset) {
+        return lines_.line_column(offset);
+    }
+
 private:
+	// add the len characters after the tail of the buffer to the line index (they are about to be added to the buffer)
+    void index_tail(uint32_t len) {
+        uint32_t first = buf_.mirrored_ ? len : std::min(len, buf_.size_ - buf_.tail_);
+
+        lines_.add_text(buf_.buf_ + buf_.tail_, first);
+        if (first < len) {
+            lines_.add_text(buf_.buf_, len - first);
+        }
+    }
+
     inline bool read_nextv( iovec  *vec, int num_vec ) {
-        ssize_t available = ::readv(fd_, vec, num_vec); 
+        ssize_t available;
+        do {
+            available = read_ahead_.started() ? read_segments(vec, num_vec) : ::readv(fd_, vec, num_vec);
+        } while(available == -1 && errno == EINTR);	// interrupted by a signal: the read is retried
+
         if (available == -1) {
             if (errno != EAGAIN) {
                 error_ = errno;
@@ -390,80 +802,372 @@ private:
             return false;
         }
         if (available == 0) {
-            // select? non blocking fd?
+            eof_ = true;
             return false;
         }
 
+        index_tail( available );
         if (!buf_.inc_tail(available)) {
             ERROR("HOW??\n");
 			return false;
 		}
         return available > 0; 
     }
-  
-    bool read_next() {
 
+	// copy the input from the read-ahead thread, same return value as readv
+    ssize_t read_segments( iovec *vec, int num_vec ) {
+        ssize_t available = 0;
+        int error = 0;
+
+        for(int i = 0; i < num_vec; ++i) {
+            size_t copied = read_ahead_.read( (Char_t *) vec[i].iov_base, vec[i].iov_len, &error );
+            available += copied;
+            if (copied < vec[i].iov_len) {
+                break;
+            }
+        }
+        if (available == 0 && error != 0) {
+            errno = error;
+            return -1;
+        }
+        return available;
+    }
+
+	// read more input into the buffer, the buffer grows if it is full.
+	// If no input is available yet (non blocking file descriptor, or text written with write_tail), then the input waiter is asked to wait for more input.
+    bool fill() {
+
+        while(true) {
+            if (fd_ != -1) {
+                if (buf_.full()) {
+                    if (!resize_if_full_) {
+                        ERROR("buffer is full and can't read any more data\n");
+                        return false;
+                    }
+                    if (!buf_.resize(pos_at_head_)) {
+                        ERROR("Failed to resize the buffer\n");
+                        return false;
+                    }
+                }
+                if (read_tail()) {
+                    return true;
+                }
+                if (eof_ || error_ != 0) {
+                    return false;
+                }
+            }
+
+            if (input_waiter_ == nullptr) {
+                return false;
+            }
+
+            uint32_t available = buf_.available_at_cursor();
+            if (!input_waiter_->wait_for_input()) {
+                return false;
+            }
+            if (buf_.available_at_cursor() > available) {
+                return true;
+            }
+        }
+    }
+
+	// read into the free space after the tail of the buffer
+    bool read_tail() {
         iovec  vec[2];
         int num_vec = 1;
+        uint32_t free = buf_.free();
 
-		if (fd_ == -1) {
-			return false;
-		}
+        vec[0].iov_base = buf_.buf_ + buf_.tail_;
+        vec[0].iov_len = free;
 
-        if (buf_.cursor_ < buf_.head_) {
+        if (!buf_.mirrored_ && buf_.tail_ + free > buf_.size_) {
+            vec[0].iov_len = buf_.size_ - buf_.tail_;
+            vec[1].iov_base = buf_.buf_;
+            vec[1].iov_len = free - vec[0].iov_len;
+            num_vec = 2;
+        }
 
-            vec[0].iov_base = buf_.buf_ + buf_.cursor_;
-            vec[0].iov_len = buf_.head_ - buf_.cursor_ - 1;
-        
-        } else {
+        return read_nextv(vec, num_vec);
+   }
 
-            vec[0].iov_base = buf_.buf_ + buf_.cursor_;
-            vec[0].iov_len = buf_.size_ - buf_.cursor_;
 
-            if (buf_.head_ > 0) {
-                vec[1].iov_base = buf_.buf_;
-                vec[1].iov_len = buf_.head_ - 1;
-                num_vec = 2;
+    int fd_;
+    int error_;
+    bool eof_;
+    Text_input_waiter *input_waiter_;
+    FilePos_t pos_at_head_;
+	bool resize_if_full_;
+    Text_position  pos_at_cursor_;
+    Text_ringbuffer buf_; 
+    Line_index lines_;
+	int position_nesting_;
+    uint32_t generation_;
+    Text_read_ahead read_ahead_;
+};
 
-            } else {
+//
+// Text_memory_stream - text stream over text that is already in memory (a buffer owned by the caller, or a string_view).
+//
+// The parser reads the caller's buffer directly: there is no lookahead buffer, nothing is allocated and the text is not copied; the buffer must stay valid while parsing.
+// The positions work the same way as with Text_stream: it is not possible to backtrack before the head position.
+//
 
-                vec[0].iov_len -= 1;
+class Text_memory_stream {
+public:
+    using Next_char_value = std::pair<bool, Char_t>;
 
-            }
+    Text_memory_stream() : error_(0), data_(nullptr), size_(0), pos_at_head_(0), release_pages_(false), pos_released_(0), position_nesting_(0), generation_(0) {
+    }
+
+    Text_memory_stream(const Char_t *data, size_t size) : Text_memory_stream() {
+        open(data, size);
+    }
+
+    Text_memory_stream(std::string_view text) : Text_memory_stream(text.data(), text.size()) {
+    }
+
+    bool open(const Char_t *data, size_t size) {
+        data_ = data;
+        size_ = (FilePos_t) size;
+        generation_ += 1;
+        reset();
+        return true;
+    }
+
+	// incremented each time that the stream is opened: a position of the previous text is no longer valid
+    uint32_t generation() const {
+        return generation_;
+    }
+
+    bool open(std::string_view text) {
+        return open(text.data(), text.size());
+    }
+
+	// parse the text starting at offset start (positions are still offsets from data, the text before start is not accessible)
+    bool open(const Char_t *data, size_t size, FilePos_t start) {
+        if (start > (FilePos_t) size) {
+            ERROR("start offset %ld beyond end of text %ld\n", start, (FilePos_t) size);
+            return false;
         }
+        open(data, size);
+#ifdef __PARSER_EAGER_POSITION__
+        Line_column line_column = this->line_column(start);
+        pos_at_cursor_.line_ = line_column.line();
+        pos_at_cursor_.column_ = line_column.column();
+#endif
+        pos_at_cursor_.buffer_pos_ = pos_at_head_ = start;
+        return true;
+    }
 
-        return read_nextv(vec, num_vec);
-     }
+    Next_char_value current_char() {
+        if (pos_at_cursor_.buffer_pos_ >= size_) {
+            return Next_char_value(false,' ');
+        }
+        return Next_char_value(true, data_[ pos_at_cursor_.buffer_pos_ ]);
+    }
 
+    Next_char_value next_char() {
+        auto rval = current_char();
+        if (rval.first) {
+            pos_at_cursor_.next_char(rval.second);
+        }
+        return rval;
+    }
 
-     bool read_empty() {
-        iovec  vec[2];
-        int num_vec = 1;
+    std::string_view peek(uint32_t len) {
+        FilePos_t available = size_ - pos_at_cursor_.buffer_pos_;
+        return std::string_view( data_ + pos_at_cursor_.buffer_pos_, std::min( (FilePos_t) len, available) );
+    }
+
+    std::string_view span() {
+        return std::string_view( data_ + pos_at_cursor_.buffer_pos_, size_ - pos_at_cursor_.buffer_pos_ );
+    }
+
+    void advance(uint32_t len) {
+        pos_at_cursor_.next_chars(data_ + pos_at_cursor_.buffer_pos_, len);
+    }
+
+    Text_position pos_at_cursor_and_inc_nesting() {
+		position_nesting_ += 1;
+        return pos_at_cursor_;
+    }
 
-        vec[0].iov_base = buf_.buf_ + buf_.head_;
-        vec[0].iov_len = buf_.size_ - buf_.head_;
+    Text_position pos_at_cursor() const {
+        return pos_at_cursor_;
+    }
 
-        if (buf_.head_ > 1) {
-           vec[1].iov_base = buf_.buf_;
-           vec[1].iov_len = buf_.head_ - 1;
-           num_vec = 2;
+    bool backtrack(Text_position pos) {
+        if (!seek(pos)) {
+            return true;
         }
-        if (buf_.head_ == 0) {
-           vec[0].iov_len -= 1;
+		dec_position_nesting();
+        return true;
+    }
+
+    bool seek(Text_position pos) {
+        if (pos.buffer_pos_ < pos_at_head_ || pos.buffer_pos_ > size_) {
+            ERROR("can't set text position - out of range pos %ld  head_pos %ld size %ld\n", pos.buffer_pos_, pos_at_head_, size_);
+            return false;
         }
-         
-        return read_nextv(vec, num_vec);
-   }
+        pos_at_cursor_ = pos;
+        return true;
+    }
 
+    FilePos_t pos_at_head() const {
+        return pos_at_head_;
+    }
+
+	bool dec_position_nesting() {
+		if (position_nesting_ == 0) {
+			ERROR("position nesting droppes to negative count. parser is wrong\n");
+			return false;
+		}
+		position_nesting_ -= 1;
+		if (position_nesting_ == 0) {
+			return move_on( pos_at_cursor() ); 
+		}
+		return true;
+	}
+
+	// discard all text up until the argument position; for a mapped file the pages before that position are released.
+    bool move_on(Text_position pos) {
+
+        if (pos.buffer_pos_ < pos_at_head_ || pos.buffer_pos_ > size_) {
+            ERROR("can't set text position - out of range pos %ld  head_pos %ld size %ld\n", pos.buffer_pos_, pos_at_head_, size_);
+            return true;
+        }
+        pos_at_cursor_ = pos;
+        pos_at_head_ = pos.buffer_pos_;
+
+        if (release_pages_) {
+            FilePos_t page_size = sysconf(_SC_PAGESIZE);
+            FilePos_t release_to = pos_at_head_ - pos_at_head_ % page_size;
+            if (release_to > pos_released_) {
+                index_to( release_to );
+                madvise((void *) (data_ + pos_released_), release_to - pos_released_, MADV_DONTNEED);
+                pos_released_ = release_to;
+            }
+        }
+        return true;
+    }
+
+    const Char_t *data() const {
+        return data_;
+    }
+
+    FilePos_t size() const {
+        return size_;
+    }
+
+    int error() { return error_; }
+
+	// line and column of an offset in the text; the text is added to the line index on demand (and before its pages are released)
+    Line_column line_column(FilePos_t offset) {
+        index_to( std::min(offset, size_) );
+        return lines_.line_column(offset);
+    }
+
+protected:
+    void reset() {
+        pos_at_head_ = pos_released_ = 0;
+        pos_at_cursor_ = Text_position();
+        lines_.clear();
+        position_nesting_ = 0;
+    }
+
+    void index_to(FilePos_t pos) {
+        if (pos > lines_.indexed()) {
+            lines_.add_text(data_ + lines_.indexed(), pos - lines_.indexed());
+        }
+    }
 
-    int fd_;
     int error_;
+    const Char_t *data_;
+    FilePos_t size_;
     FilePos_t pos_at_head_;
-	bool resize_if_full_;
+    bool release_pages_;
+    FilePos_t pos_released_;
     Text_position  pos_at_cursor_;
-    Text_ringbuffer buf_; 
+    Line_index lines_;
 	int position_nesting_;
+    uint32_t generation_;
 };
 
-} // namespace pparse
+//
+// Text_mmap_stream - text stream for regular files; the whole file is mapped into memory.
+//
+// This is a Text_memory_stream over the mapped file, the parser reads the mapped file directly.
+// move_on releases the mapped pages before the new head position (MADV_DONTNEED), so that the resident set of the mapping stays bounded while parsing the file.
+//
+
+class Text_mmap_stream : public Text_memory_stream {
+public:
+    Text_mmap_stream() : map_size_(0) {
+    }
+
+    ~Text_mmap_stream() {
+        close();
+    }
 
+    bool open(const char *fname) {
+
+        if (data_ != nullptr) {
+            ERROR("Can't open file twice\n");
+            return false;
+        }
+
+        int fd = ::open(fname, O_RDONLY);
+        if (fd == -1) {
+            error_ = errno;
+            ERROR("Can't open file %s error %d\n", fname, error_);
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            error_ = errno;
+            ERROR("Can't stat file %s error %d\n", fname, error_);
+            ::close(fd);
+            return false;
+        }
+
+        size_ = st.st_size;
+        if (size_ > 0) {
+            void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                error_ = errno;
+                ERROR("Can't map file %s error %d\n", fname, error_);
+                ::close(fd);
+                size_ = 0;
+                return false;
+            }
+            madvise(addr, size_, MADV_SEQUENTIAL);
+
+            data_ = (const Char_t *) addr;
+            map_size_ = size_;
+        }
+        ::close(fd);
+
+        release_pages_ = true;
+        generation_ += 1;
+        reset();
+        return true;
+    }
+
+    bool close() {
+        if (data_ != nullptr) {
+            if (munmap((void *) data_, map_size_) != 0) {
+                ERROR("munmap failed. errno %d\n", errno);
+                return false;
+            }
+            data_ = nullptr;
+        }
+        size_ = map_size_ = 0;
+        return true;
+    }
+
+private:
+    FilePos_t map_size_;
+};
+
+} // namespace pparse
@@ -5,49 +5,94 @@
 #include <list>
 #include <tuple>
 #include <variant>
+#include <vector>
+#include <memory_resource>
 
 namespace pparse {
 
 typedef int RuleId;
 
+//
+// Position - offset of a character in the text; the line and column of the offset are returned by the line_column method of the text stream.
+// (with __PARSER_EAGER_POSITION__ the line and column are also stored in the Position)
+//
+
 struct Position {
-	Position() : line_(0), column_(0) {
+#ifdef __PARSER_EAGER_POSITION__
+	Position() : offset_(0), line_(0), column_(0) {
 	}
 
-	Position(int line, int column) : line_(line), column_(column) {
+	Position(const Text_position &arg) : offset_(arg.buffer_pos_), line_(arg.line_), column_(arg.column_) {
 	}
 
-	Position(Text_position &arg) : line_(arg.line_), column_(arg.column_) {
+	int line() const {
+		return line_;
 	}
 
-	bool operator==(const Position  &arg) const {
-		return arg.line_ == line_ && arg.column_ == column_;
+	int column() const {
+		return column_;
+	}
+#else
+	Position() : offset_(0) {
 	}
 
-	bool operator<(const Position  &arg) const {
-		return line_ < arg.line_  || (line_ == arg.line_ && column_ < arg.column_);
+	Position(const Text_position &arg) : offset_(arg.buffer_pos_) {
 	}
+#endif
 
-	int line() const {
-		return line_;
+	bool operator==(const Position  &arg) const {
+		return arg.offset_ == offset_;
 	}
 
-	int column() const {
-		return column_;
+	bool operator<(const Position  &arg) const {
+		return offset_ < arg.offset_;
 	}
 
+	FilePos_t offset() const {
+		return offset_;
+	}
 
-    int line_;
-    int column_;
+	FilePos_t offset_;
+#ifdef __PARSER_EAGER_POSITION__
+	int line_;
+	int column_;
+#endif
 };
 
 
+//
+// AstEntryBase - base class of all AST nodes.
+//
+// The nodes are allocated from a std::pmr::memory_resource (make_ast allocates from the resource of the parser, plain new from the default resource);
+// a header before the node remembers the resource and the size of the allocation, so that delete returns the node to the resource that allocated it.
+//
+
 struct AstEntryBase {
     AstEntryBase(RuleId ruleId) : ruleId_(ruleId) {
     }
 
     virtual ~AstEntryBase() {
     }
+
+	static void *operator new(size_t size) {
+		return allocate(size, std::pmr::get_default_resource());
+	}
+
+	static void *operator new(size_t size, std::pmr::memory_resource *resource) {
+		return allocate(size, resource);
+	}
+
+	static void operator delete(void *ptr) {
+		if (ptr != nullptr) {
+			Allocation_header *header = (Allocation_header *) ((char *) ptr - HEADER_SIZE);
+			header->resource_->deallocate(header, header->size_, alignof(std::max_align_t));
+		}
+	}
+
+	// called if the constructor of a node that has been allocated from a resource throws
+	static void operator delete(void *ptr, std::pmr::memory_resource *) {
+		operator delete(ptr);
+	}
     
 	RuleId getRuleId() const {
 		return ruleId_;
@@ -64,6 +109,65 @@ struct AstEntryBase {
 	Position start_;
 	Position end_;
 	RuleId ruleId_;
+
+private:
+	struct Allocation_header {
+		std::pmr::memory_resource *resource_;
+		size_t size_;
+	};
+
+	// the node follows the header, the header size keeps the alignment of the node.
+	static constexpr size_t HEADER_SIZE = (sizeof(Allocation_header) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+	static void *allocate(size_t size, std::pmr::memory_resource *resource) {
+		void *block = resource->allocate(size + HEADER_SIZE, alignof(std::max_align_t));
+		new (block) Allocation_header{ resource, size + HEADER_SIZE };
+		return (char *) block + HEADER_SIZE;
+	}
+};
+
+//
+// Ast_teardown - frees the child nodes of a node in a loop, not recursively.
+//
+// A left recursive rule builds a chain of nodes that leans to the left (see packrat.h), a long chain would overflow the stack if it were freed
+// recursively. The destructors of PSeq and PAny nodes pass their children to free_children: the outermost one frees the nodes from a list,
+// the destructors that run while the list is freed only append their children to the list.
+//
+
+struct Ast_teardown {
+
+	template<typename Take_children>
+	static void free_children(Take_children take_children) {
+
+		if (active_) {
+			take_children(nodes_);
+			return;
+		}
+
+		take_children(nodes_);
+		if (nodes_.empty()) {
+			return;
+		}
+
+		active_ = true;
+		while(!nodes_.empty()) {
+			std::unique_ptr<AstEntryBase> node = std::move( nodes_.back() );
+			nodes_.pop_back();
+			node.reset();
+		}
+		active_ = false;
+	}
+
+	template<typename Node>
+	static void take(std::vector< std::unique_ptr<AstEntryBase> > &nodes, std::unique_ptr<Node> &node) {
+		if (node != nullptr) {
+			nodes.push_back( std::unique_ptr<AstEntryBase>( node.release() ) );
+		}
+	}
+
+private:
+	static inline thread_local std::vector< std::unique_ptr<AstEntryBase> > nodes_;
+	static inline thread_local bool active_ = false;
 };
 
 
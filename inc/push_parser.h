@@ -0,0 +1,202 @@
+#pragma once
+
+#include <ucontext.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <memory>
+
+namespace pparse {
+
+enum class Push_status {
+	need_more_input,
+	success,
+	failure,
+};
+
+//
+// Push_stack - the stack of a Push_parser: a private anonymous mapping, with a PROT_NONE guard page below it (the stack grows down),
+// so that a stack overflow crashes on the guard page, instead of overwriting other memory. The pages are committed when they are touched,
+// a big stack costs address space only.
+//
+
+class Push_stack {
+public:
+	Push_stack() : mapping_(nullptr), mapping_size_(0), guard_size_(0) {
+	}
+
+	Push_stack(const Push_stack &) = delete;
+	Push_stack &operator=(const Push_stack &) = delete;
+
+	~Push_stack() {
+		release();
+	}
+
+	bool allocate(size_t size) {
+		release();
+
+		guard_size_ = (size_t) sysconf(_SC_PAGESIZE);
+		size_t stack_size = (size + guard_size_ - 1) / guard_size_ * guard_size_;
+
+		void *mapping = mmap(nullptr, stack_size + guard_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (mapping == MAP_FAILED) {
+			ERROR("can't map stack of %ld bytes. errno %d\n", (long) stack_size, errno);
+			return false;
+		}
+		mapping_ = (char *) mapping;
+		mapping_size_ = stack_size + guard_size_;
+
+		if (mprotect(mapping_, guard_size_, PROT_NONE) != 0) {
+			ERROR("can't protect guard page of stack. errno %d\n", errno);
+			release();
+			return false;
+		}
+		return true;
+	}
+
+	void release() {
+		if (mapping_ != nullptr) {
+			munmap(mapping_, mapping_size_);
+			mapping_ = nullptr;
+			mapping_size_ = 0;
+		}
+	}
+
+	// the usable stack, above the guard page
+	char *base() const {
+		return mapping_ + guard_size_;
+	}
+
+	size_t size() const {
+		return mapping_size_ - guard_size_;
+	}
+
+private:
+	char *mapping_;
+	size_t mapping_size_;
+	size_t guard_size_;
+};
+
+//
+// Push_parser - resumable parser, for input that arrives in pieces (non blocking sockets, event loops)
+//
+// The parser runs on its own stack. If the text stream runs out of input before the end of input is reached, then the parser is suspended,
+// and parse() returns Push_status::need_more_input; the caller adds more text with write_tail (or waits until the non blocking file descriptor is readable)
+// and calls parse() again, parsing then continues at the point where it has been suspended. Call end_of_input() once all input has been added.
+//
+
+template<typename Parser, typename ParserBase = CharParser, typename TextStream = Text_stream>
+class Push_parser : Text_input_waiter {
+public:
+	// address space of the stack; only the pages that the parser touches are committed. (deeply nested input needs about 2k of stack per level)
+	static const size_t Default_stack_size = 8 * 1024 * 1024;
+
+	Push_parser(TextStream &stream, size_t stack_size = Default_stack_size) : stream_(stream), parser_(stream), stack_size_(stack_size), state_(State::not_started), input_finished_(false) {
+		stream_.set_input_waiter(this);
+	}
+
+	~Push_parser() {
+		if (state_ == State::suspended) {
+			// let the parser run to completion, so that all objects on its stack are released.
+			input_finished_ = true;
+			parse();
+		}
+		stream_.set_input_waiter(nullptr);
+	}
+
+	// start or continue parsing.
+	Push_status parse() {
+
+		switch(state_) {
+			case State::finished:
+				return status();
+
+			case State::not_started: {
+				if (!stack_.allocate(stack_size_)) {
+					state_ = State::finished;
+					result_ = Parse_result{false, Text_position(), Text_position()};
+					return status();
+				}
+
+				getcontext(&parser_context_);
+				parser_context_.uc_stack.ss_sp = stack_.base();
+				parser_context_.uc_stack.ss_size = stack_.size();
+				parser_context_.uc_link = &caller_context_;
+
+				// makecontext passes int arguments: the pointer is split into two halves (the shift is done in two steps, so that it is defined if uintptr_t has 32 bits)
+				uintptr_t self = (uintptr_t) this;
+				makecontext(&parser_context_, (void (*)()) run, 2, (unsigned int) ((self >> 16) >> 16), (unsigned int) self);
+				break;
+			}
+
+			case State::running:
+			case State::suspended:
+				break;
+		}
+
+		state_ = State::running;
+		swapcontext(&caller_context_, &parser_context_);
+
+		if (state_ == State::finished) {
+			stack_.release();
+			return status();
+		}
+		return Push_status::need_more_input;
+	}
+
+	// no more input will be added; the next call to parse() completes the parse.
+	void end_of_input() {
+		input_finished_ = true;
+	}
+
+	Parse_result &result() {
+		return result_;
+	}
+
+	ParserBase &parser() {
+		return parser_;
+	}
+
+private:
+	enum class State {
+		not_started,
+		running,
+		suspended,
+		finished,
+	};
+
+	static void run(unsigned int self_high, unsigned int self_low) {
+		Push_parser *self = (Push_parser *) ( (((uintptr_t) self_high << 16) << 16) | (uintptr_t) self_low );
+
+		self->result_ = Parser::parse(self->parser_);
+		self->state_ = State::finished;
+		// returns to uc_link, that's the caller of parse()
+	}
+
+	// called on the stack of the parser, if the text stream has no more input.
+	bool wait_for_input() override {
+		if (input_finished_) {
+			return false;
+		}
+		state_ = State::suspended;
+		swapcontext(&parser_context_, &caller_context_);
+		return true;
+	}
+
+	Push_status status() const {
+		return result_.success() ? Push_status::success : Push_status::failure;
+	}
+
+	TextStream &stream_;
+	ParserBase parser_;
+	size_t stack_size_;
+	Push_stack stack_;
+	ucontext_t caller_context_;
+	ucontext_t parser_context_;
+	State state_;
+	bool input_finished_;
+	Parse_result result_;
+};
+
+} // namespace pparse
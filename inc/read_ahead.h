@@ -0,0 +1,262 @@
+#pragma once
+
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include "parse_base.h"
+
+namespace pparse {
+
+//
+// Read_ahead_stats - time spent by the parser waiting for input, versus time spent parsing.
+//
+
+struct Read_ahead_stats {
+	double blocked_secs_;	// time that the parser thread waited for the read-ahead thread
+	double parse_secs_;		// time since the read-ahead thread has been started, minus the time spent waiting
+	double read_secs_;		// time spent by the read-ahead thread in the read system call
+	size_t bytes_read_;
+	size_t waits_;			// number of times that the parser had to wait for input
+};
+
+//
+// Text_read_ahead - a thread that reads the input file ahead of the parser.
+//
+// There are two segments: the read-ahead thread reads into one of them, while the parser copies the text out of the other one.
+// The hand-off is a lock-free single producer/single consumer handshake, each segment has an atomic state (empty or full) that passes
+// the ownership of the segment between the two threads: the read-ahead thread only touches empty segments, the parser only touches full segments.
+// The read-ahead thread polls the file descriptor together with a wake-up pipe before each read, so that stop() doesn't block if the input is
+// a pipe or a socket that has no data.
+//
+
+class Text_read_ahead {
+public:
+	static const uint32_t Default_segment_size = 64 * 1024;
+
+	Text_read_ahead() : fd_(-1), wake_fds_{-1, -1}, stop_(false), consumer_segment_(0), blocked_(0), waits_(0), read_time_(0), bytes_read_(0) {
+	}
+
+	~Text_read_ahead() {
+		stop();
+	}
+
+	bool start(int fd, uint32_t segment_size = Default_segment_size) {
+
+		if (thread_.joinable()) {
+			ERROR("read-ahead thread already started\n");
+			return false;
+		}
+
+		if (::pipe(wake_fds_) == -1) {
+			ERROR("Can't create the wake-up pipe of the read-ahead thread, error %d\n", errno);
+			return false;
+		}
+
+		fd_ = fd;
+		stop_.store(false);
+		consumer_segment_ = 0;
+		blocked_ = std::chrono::steady_clock::duration::zero();
+		waits_ = 0;
+		bytes_read_.store(0);
+		read_time_.store(0);
+
+		for(auto &segment : segments_) {
+			segment.data_.reset( new Char_t[ segment_size ] );
+			segment.capacity_ = segment_size;
+			segment.size_ = segment.offset_ = 0;
+			segment.error_ = 0;
+			segment.state_.store(Segment_empty);
+		}
+
+		posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+		start_time_ = std::chrono::steady_clock::now();
+		thread_ = std::thread( [this]() { read_loop(); } );
+		return true;
+	}
+
+	void stop() {
+		if (thread_.joinable()) {
+			stop_.store(true);
+			char wake = 0;
+			while(::write(wake_fds_[1], &wake, 1) == -1 && errno == EINTR) {
+			}
+			thread_.join();
+		}
+		for(int &fd : wake_fds_) {
+			if (fd != -1) {
+				::close(fd);
+				fd = -1;
+			}
+		}
+	}
+
+	bool started() const {
+		return thread_.joinable();
+	}
+
+	// copy up to len characters of the input into dest; returns the number of characters copied, 0 on end of input or on error (the errno value of the failed read is returned in *error)
+	size_t read(Char_t *dest, size_t len, int *error) {
+
+		Segment &segment = segments_[ consumer_segment_ ];
+
+		if (segment.state_.load(std::memory_order_acquire) != Segment_full) {
+			auto start = std::chrono::steady_clock::now();
+			bool ready = wait_for( [&segment]() { return segment.state_.load(std::memory_order_acquire) == Segment_full; } );
+			blocked_ += std::chrono::steady_clock::now() - start;
+			waits_ += 1;
+			if (!ready) {
+				return 0;
+			}
+		}
+
+		if (segment.offset_ == segment.size_) {
+			// the segment at the end of input is empty and kept in full state, all further reads return eof.
+			*error = segment.error_;
+			return 0;
+		}
+
+		size_t to_copy = std::min(len, (size_t) (segment.size_ - segment.offset_));
+		memcpy(dest, segment.data_.get() + segment.offset_, to_copy);
+		segment.offset_ += to_copy;
+
+		if (segment.offset_ == segment.size_) {
+			segment.state_.store(Segment_empty, std::memory_order_release);
+			consumer_segment_ ^= 1;
+		}
+		return to_copy;
+	}
+
+	Read_ahead_stats stats() const {
+		Read_ahead_stats ret;
+		double total_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+
+		ret.blocked_secs_ = std::chrono::duration<double>(blocked_).count();
+		ret.parse_secs_ = total_secs - ret.blocked_secs_;
+		ret.read_secs_ = std::chrono::duration<double>( std::chrono::steady_clock::duration( read_time_.load() ) ).count();
+		ret.bytes_read_ = bytes_read_.load();
+		ret.waits_ = waits_;
+		return ret;
+	}
+
+private:
+	enum Segment_state {
+		Segment_empty,
+		Segment_full,
+	};
+
+	struct Segment {
+		std::unique_ptr<Char_t[]> data_;
+		uint32_t capacity_;
+		uint32_t size_;
+		uint32_t offset_;
+		int error_;
+		std::atomic<int> state_;
+	};
+
+	// runs in the read-ahead thread
+	void read_loop() {
+
+		off_t file_pos = lseek(fd_, 0, SEEK_CUR);
+
+		for(int producer_segment = 0; ; producer_segment ^= 1) {
+
+			Segment &segment = segments_[ producer_segment ];
+
+			if (!wait_for( [&segment]() { return segment.state_.load(std::memory_order_acquire) == Segment_empty; } )) {
+				return;
+			}
+
+			if (file_pos != -1) {
+				posix_fadvise(fd_, file_pos + segment.capacity_, segment.capacity_, POSIX_FADV_WILLNEED);
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			ssize_t available = read_input(segment.data_.get(), segment.capacity_);
+			read_time_.fetch_add( (std::chrono::steady_clock::now() - start).count() );
+			if (available == -1 && stop_.load()) {
+				return;
+			}
+
+			segment.offset_ = 0;
+			if (available <= 0) {
+				segment.size_ = 0;
+				segment.error_ = available == -1 ? errno : 0;
+				segment.state_.store(Segment_full, std::memory_order_release);
+				return;
+			}
+			if (file_pos != -1) {
+				file_pos += available;
+			}
+			bytes_read_.fetch_add(available);
+
+			segment.size_ = (uint32_t) available;
+			segment.state_.store(Segment_full, std::memory_order_release);
+		}
+	}
+
+	// read once the input is readable, the read is retried if it has been interrupted by a signal; returns -1 with errno set on error,
+	// or -1 if the thread has been stopped while it waited for input.
+	ssize_t read_input(Char_t *data, size_t size) {
+		for(;;) {
+			struct pollfd fds[2] = { { fd_, POLLIN, 0 }, { wake_fds_[0], POLLIN, 0 } };
+
+			if (::poll(fds, 2, -1) == -1) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return -1;
+			}
+			if (fds[1].revents != 0) {
+				return -1;
+			}
+
+			ssize_t available = ::read(fd_, data, size);
+			if (available == -1 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+				continue;
+			}
+			return available;
+		}
+	}
+
+	// spin until the condition is true, then yield and sleep for longer periods; returns false if the read-ahead thread has been stopped.
+	template<typename Condition>
+	bool wait_for(Condition cond) {
+		for(int count = 0; !cond(); ++count) {
+			if (stop_.load(std::memory_order_relaxed)) {
+				return false;
+			}
+			if (count < 64) {
+				continue;
+			}
+			if (count < 1024) {
+				std::this_thread::yield();
+			} else {
+				std::this_thread::sleep_for( std::chrono::microseconds(50) );
+			}
+		}
+		return true;
+	}
+
+	int fd_;
+	int wake_fds_[2];		// stop() writes to the pipe, to wake up the read-ahead thread
+	std::atomic<bool> stop_;
+	Segment segments_[2];
+	int consumer_segment_;
+	std::thread thread_;
+
+	std::chrono::steady_clock::time_point start_time_;
+	std::chrono::steady_clock::duration blocked_;
+	size_t waits_;
+	std::atomic<std::chrono::steady_clock::rep> read_time_;
+	std::atomic<size_t> bytes_read_;
+};
+
+} // namespace pparse
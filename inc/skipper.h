@@ -0,0 +1,157 @@
+#pragma once
+
+#include <string.h>
+#include <string_view>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "parse_text.h"
+
+namespace pparse {
+
+// length of the run of whitespace (space, \t, \n, \v, \f, \r) at the start of the text; with SSE2 sixteen characters are checked at once.
+inline size_t whitespace_run(const Char_t *text, size_t len) {
+	size_t pos = 0;
+
+#ifdef __SSE2__
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i range = _mm_set1_epi8('\r' - '\t');
+
+	for(; pos + 16 <= len; pos += 16) {
+		__m128i chars = _mm_loadu_si128( (const __m128i *) (text + pos) );
+
+		// \t to \r is a range: the character minus \t is at most \r - \t (unsigned compare)
+		__m128i off = _mm_sub_epi8(chars, tab);
+		__m128i is_control = _mm_cmpeq_epi8( _mm_min_epu8(off, range), off );
+		__m128i is_space = _mm_or_si128( is_control, _mm_cmpeq_epi8(chars, space) );
+
+		unsigned mask = (unsigned) _mm_movemask_epi8(is_space);
+		if (mask != 0xFFFF) {
+			return pos + __builtin_ctz( ~mask );
+		}
+	}
+#endif
+
+	for(; pos < len; ++pos) {
+		Char_t ch = text[pos];
+		if (ch != ' ' && (ch < '\t' || ch > '\r')) {
+			break;
+		}
+	}
+	return pos;
+}
+
+//
+// Skip_whitespace - skipper policy of the CharStreamParser, skips the whitespace before a token.
+//
+
+struct Skip_whitespace {
+
+	template<typename TextStream>
+	static void skip(TextStream &text) {
+		for(;;) {
+			std::string_view span = text.span();
+			size_t pos = whitespace_run(span.data(), span.size());
+
+			if (pos > 0) {
+				text.advance( (uint32_t) pos );
+			}
+			if (pos < span.size() || span.empty()) {
+				break;
+			}
+		}
+	}
+};
+
+//
+// Comment markers for Skip_whitespace_and_comments, nullptr if the language doesn't have this kind of comment.
+//
+
+struct C_comments {
+	static constexpr const char *line_comment = "//";
+	static constexpr const char *block_comment_start = "/*";
+	static constexpr const char *block_comment_end = "*/";
+};
+
+struct Shell_comments {
+	static constexpr const char *line_comment = "#";
+	static constexpr const char *block_comment_start = nullptr;
+	static constexpr const char *block_comment_end = nullptr;
+};
+
+struct Pascal_comments {
+	static constexpr const char *line_comment = "//";
+	static constexpr const char *block_comment_start = "{";
+	static constexpr const char *block_comment_end = "}";
+};
+
+//
+// Skip_whitespace_and_comments - skipper policy of the CharStreamParser, skips whitespace and comments before a token, so that the grammar doesn't have to deal with comments.
+// Block comments do not nest; a block comment that is not terminated is not skipped (the grammar will then fail on the start of the comment).
+//
+
+template<typename Comments>
+struct Skip_whitespace_and_comments {
+
+	template<typename TextStream>
+	static void skip(TextStream &text) {
+		do {
+			Skip_whitespace::skip(text);
+		} while(skip_comment(text));
+	}
+
+private:
+	template<typename TextStream>
+	static bool skip_comment(TextStream &text) {
+
+		if (Comments::line_comment != nullptr && starts_with(text, Comments::line_comment)) {
+			// the newline is skipped as whitespace
+			skip_to(text, "\n");
+			return true;
+		}
+
+		if (Comments::block_comment_start != nullptr && starts_with(text, Comments::block_comment_start)) {
+			Text_position start_pos = text.pos_at_cursor();
+
+			text.advance( (uint32_t) strlen(Comments::block_comment_start) );
+			if (!skip_to(text, Comments::block_comment_end)) {
+				text.seek(start_pos);
+				return false;
+			}
+			text.advance( (uint32_t) strlen(Comments::block_comment_end) );
+			return true;
+		}
+		return false;
+	}
+
+	template<typename TextStream>
+	static bool starts_with(TextStream &text, const char *marker) {
+		return text.peek( (uint32_t) strlen(marker) ) == std::string_view(marker);
+	}
+
+	// move the cursor to the next occurance of marker; returns false if the end of input has been reached.
+	template<typename TextStream>
+	static bool skip_to(TextStream &text, const char *marker) {
+		for(;;) {
+			std::string_view span = text.span();
+			if (span.empty()) {
+				return false;
+			}
+
+			const Char_t *found = (const Char_t *) memchr(span.data(), marker[0], span.size());
+			if (found == nullptr) {
+				text.advance( (uint32_t) span.size() );
+				continue;
+			}
+
+			text.advance( (uint32_t) (found - span.data()) );
+			if (starts_with(text, marker)) {
+				return true;
+			}
+			text.advance(1);
+		}
+	}
+};
+
+} // namespace pparse
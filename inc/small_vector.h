@@ -0,0 +1,212 @@
+#pragma once
+
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <memory_resource>
+
+namespace pparse {
+
+//
+// Small_vector - vector with inline capacity: the first InlineCapacity elements are stored in the object itself, without heap allocation;
+// once the vector grows beyond that, the elements are moved to a contiguous heap array (the capacity is doubled).
+// Elements are only moved (the vector holds the unique_ptr of AST nodes), the vector can be moved but not copied.
+// The heap array is allocated from a std::pmr::memory_resource (the resource of the parser for the AST of a PRepeat).
+//
+
+template<typename T, size_t InlineCapacity>
+class Small_vector {
+public:
+	using value_type = T;
+	using iterator = T *;
+	using const_iterator = const T *;
+
+	explicit Small_vector(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) : data_(inline_data()), size_(0), capacity_(InlineCapacity), resource_(resource) {
+	}
+
+	// the moved vector keeps the memory resource of arg
+	Small_vector(Small_vector &&arg) : data_(inline_data()), size_(0), capacity_(InlineCapacity), resource_(arg.resource_) {
+		take(arg);
+	}
+
+	// the vector keeps its memory resource; the heap array of arg is taken over if it has been allocated from the same resource.
+	Small_vector &operator=(Small_vector &&arg) {
+		if (this != &arg) {
+			clear();
+			release();
+			take(arg);
+		}
+		return *this;
+	}
+
+	Small_vector(const Small_vector &) = delete;
+	Small_vector &operator=(const Small_vector &) = delete;
+
+	~Small_vector() {
+		clear();
+		release();
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+	bool empty() const {
+		return size_ == 0;
+	}
+
+	size_t capacity() const {
+		return capacity_;
+	}
+
+	std::pmr::memory_resource *resource() const {
+		return resource_;
+	}
+
+	// true if the elements are stored in the object itself
+	bool is_inline() const {
+		return data_ == inline_data();
+	}
+
+	iterator begin() {
+		return data_;
+	}
+
+	iterator end() {
+		return data_ + size_;
+	}
+
+	const_iterator begin() const {
+		return data_;
+	}
+
+	const_iterator end() const {
+		return data_ + size_;
+	}
+
+	T &operator[](size_t index) {
+		return data_[ index ];
+	}
+
+	const T &operator[](size_t index) const {
+		return data_[ index ];
+	}
+
+	T &front() {
+		return data_[ 0 ];
+	}
+
+	T &back() {
+		return data_[ size_ - 1 ];
+	}
+
+	void push_back(T &&value) {
+		if (size_ == capacity_) {
+			grow();
+		}
+		new (data_ + size_) T( std::move(value) );
+		size_ += 1;
+	}
+
+	template<typename ...Args>
+	T &emplace_back(Args &&...args) {
+		if (size_ == capacity_) {
+			grow();
+		}
+		new (data_ + size_) T( std::forward<Args>(args)... );
+		return data_[ size_++ ];
+	}
+
+	void pop_back() {
+		size_ -= 1;
+		data_[ size_ ].~T();
+	}
+
+	void clear() {
+		for(size_t i = 0; i < size_; ++i) {
+			data_[ i ].~T();
+		}
+		size_ = 0;
+	}
+
+	void reserve(size_t capacity) {
+		if (capacity <= capacity_) {
+			return;
+		}
+		T *data = static_cast<T *>( resource_->allocate( capacity * sizeof(T), alignof(T) ) );
+		for(size_t i = 0; i < size_; ++i) {
+			new (data + i) T( std::move(data_[ i ]) );
+			data_[ i ].~T();
+		}
+		release();
+		data_ = data;
+		capacity_ = capacity;
+	}
+
+	// move all elements of arg to the end of this vector, arg is empty afterwards.
+	void append(Small_vector &&arg) {
+		if (empty()) {
+			*this = std::move(arg);
+			return;
+		}
+		if (size_ + arg.size_ > capacity_) {
+			reserve( std::max( size_ + arg.size_, capacity_ * 2 ) );
+		}
+		for(size_t i = 0; i < arg.size_; ++i) {
+			new (data_ + size_ + i) T( std::move(arg.data_[ i ]) );
+		}
+		size_ += arg.size_;
+		arg.clear();
+	}
+
+private:
+	void grow() {
+		reserve( capacity_ < 4 ? 8 : capacity_ * 2 );
+	}
+
+	T *inline_data() {
+		return reinterpret_cast<T *>( inline_ );
+	}
+
+	const T *inline_data() const {
+		return reinterpret_cast<const T *>( inline_ );
+	}
+
+	// free the heap array (the elements have been destroyed or moved)
+	void release() {
+		if (!is_inline()) {
+			resource_->deallocate( data_, capacity_ * sizeof(T), alignof(T) );
+			data_ = inline_data();
+			capacity_ = InlineCapacity;
+		}
+	}
+
+	// take over the elements of arg (this vector is empty): a heap array of the same resource is taken over as is, otherwise the elements are moved one by one.
+	void take(Small_vector &arg) {
+		if (!arg.is_inline() && *arg.resource_ == *resource_) {
+			data_ = arg.data_;
+			size_ = arg.size_;
+			capacity_ = arg.capacity_;
+			arg.data_ = arg.inline_data();
+			arg.size_ = 0;
+			arg.capacity_ = InlineCapacity;
+			return;
+		}
+		reserve( arg.size_ );
+		for(size_t i = 0; i < arg.size_; ++i) {
+			new (data_ + i) T( std::move(arg.data_[ i ]) );
+		}
+		size_ = arg.size_;
+		arg.clear();
+	}
+
+	alignas(T) unsigned char inline_[ sizeof(T) * (InlineCapacity > 0 ? InlineCapacity : 1) ];
+	T *data_;
+	size_t size_;
+	size_t capacity_;
+	std::pmr::memory_resource *resource_;
+};
+
+} // namespace pparse
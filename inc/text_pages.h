@@ -0,0 +1,368 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <string_view>
+#include "parse_text.h"
+
+namespace pparse {
+
+//
+// Text_page_pool - pool of fixed size pages for the Text_paged_stream; pages released by a stream are kept in the pool and are reused.
+// A pool can be shared between streams (not between threads)
+//
+
+class Text_page_pool {
+public:
+	static const uint32_t Default_page_size = 64 * 1024;
+
+	// the page size is rounded up to a power of two.
+	Text_page_pool(uint32_t page_size = Default_page_size) : page_size_(1), allocated_(0) {
+		while(page_size_ < page_size) {
+			page_size_ <<= 1;
+		}
+	}
+
+	~Text_page_pool() {
+		for(auto page : free_) {
+			delete [] page;
+		}
+	}
+
+	Text_page_pool(const Text_page_pool &) = delete;
+	Text_page_pool &operator=(const Text_page_pool &) = delete;
+
+	Char_t *get() {
+		if (free_.empty()) {
+			allocated_ += 1;
+			return new Char_t[ page_size_ ];
+		}
+		Char_t *page = free_.back();
+		free_.pop_back();
+		return page;
+	}
+
+	void put(Char_t *page) {
+		free_.push_back(page);
+	}
+
+	uint32_t page_size() const {
+		return page_size_;
+	}
+
+	// number of pages allocated by the pool
+	size_t allocated() const {
+		return allocated_;
+	}
+
+private:
+	uint32_t page_size_;
+	size_t allocated_;
+	std::vector<Char_t *> free_;
+};
+
+//
+// Text_paged_stream - text stream with a lookahead buffer that is a list of fixed size pages.
+//
+// The buffer grows by appending a page, the text in the buffer is never copied (unlike the Text_stream, which copies the whole buffer when it grows),
+// so backtracking over a very long rule doesn't cost any copying. move_on returns the pages before the head position to the page pool.
+// span() returns the text up to the end of the current page; peek() returns a view into the page, if the requested text crosses
+// the end of the page, then it is copied into a scratch buffer (the view is valid until the next call to peek)
+//
+
+class Text_paged_stream {
+public:
+    using Next_char_value = std::pair<bool, Char_t>;
+
+    Text_paged_stream(Text_page_pool *pool = nullptr) : fd_(-1), error_(0), eof_(false), own_pool_(pool == nullptr ? new Text_page_pool() : nullptr), pool_(pool == nullptr ? own_pool_.get() : pool),
+		page_shift_(0), first_page_pos_(0), tail_pos_(0), pos_at_head_(0), position_nesting_(0), generation_(0) {
+
+		while( ((uint32_t) 1 << page_shift_) < pool_->page_size()) {
+			++page_shift_;
+		}
+		page_mask_ = pool_->page_size() - 1;
+    }
+
+    ~Text_paged_stream() {
+        close();
+    }
+
+    bool open(const char *fname) {
+
+        if (fd_ != -1) {
+            ERROR("Can't open file twice\n");
+            return false;
+        }
+
+        int fd = ::open(fname, O_RDONLY);
+        if (fd == -1) {
+            error_ = errno;
+            ERROR("Can't open file %s error %d\n", fname, error_);
+            return false;
+        }
+        return open(fd);
+    }
+
+	// fd is -1 if the text is added with write_tail
+    bool open(int fd) {
+        fd_ = fd;
+        eof_ = false;
+        generation_ += 1;
+        lines_.clear();
+        return true;
+    }
+
+    bool close() {
+        release_pages( pages_.size() );
+        first_page_pos_ = tail_pos_ = pos_at_head_ = 0;
+        pos_at_cursor_ = Text_position();
+        position_nesting_ = 0;
+
+        if (fd_ != -1) {
+            if (::close(fd_) != 0) {
+				ERROR("close failed. errno %d\n", errno);
+				return false;
+			}
+   			fd_ = -1;
+     	}
+        return true;
+    }
+
+    bool write_tail(const Char_t *data, uint32_t data_len) {
+        while(data_len > 0) {
+            uint32_t to_copy;
+            Char_t *dest = tail_space(&to_copy);
+
+            to_copy = std::min(to_copy, data_len);
+            memcpy(dest, data, to_copy);
+            add_tail(dest, to_copy);
+
+            data += to_copy;
+            data_len -= to_copy;
+        }
+        return true;
+    }
+
+    Next_char_value current_char() {
+        if (pos_at_cursor_.buffer_pos_ == tail_pos_) {
+            if (!fill()) {
+                return Next_char_value(false,' ');
+            }
+        }
+        return Next_char_value(true, *char_ptr(pos_at_cursor_.buffer_pos_));
+    }
+
+    Next_char_value next_char() {
+        auto rval = current_char();
+        if (rval.first) {
+            pos_at_cursor_.next_char(rval.second);
+        }
+        return rval;
+    }
+
+    std::string_view peek(uint32_t len) {
+        while(tail_pos_ - pos_at_cursor_.buffer_pos_ < len) {
+            if (!fill()) {
+                break;
+            }
+        }
+
+        FilePos_t pos = pos_at_cursor_.buffer_pos_;
+        uint32_t available = (uint32_t) std::min( (FilePos_t) len, tail_pos_ - pos);
+        uint32_t in_page = pool_->page_size() - (uint32_t) (pos & page_mask_);
+
+        if (available <= in_page) {
+            return std::string_view( char_ptr(pos), available );
+        }
+
+        scratch_.clear();
+        while(available > 0) {
+            uint32_t chunk = std::min(available, pool_->page_size() - (uint32_t) (pos & page_mask_));
+            scratch_.append( char_ptr(pos), chunk );
+            pos += chunk;
+            available -= chunk;
+        }
+        return std::string_view( scratch_ );
+    }
+
+	// the text at the cursor, up to the end of the current page
+    std::string_view span() {
+        if (pos_at_cursor_.buffer_pos_ == tail_pos_) {
+            if (!fill()) {
+                return std::string_view();
+            }
+        }
+        FilePos_t pos = pos_at_cursor_.buffer_pos_;
+        uint32_t in_page = pool_->page_size() - (uint32_t) (pos & page_mask_);
+        return std::string_view( char_ptr(pos), std::min( (FilePos_t) in_page, tail_pos_ - pos) );
+    }
+
+    void advance(uint32_t len) {
+        if (len > tail_pos_ - pos_at_cursor_.buffer_pos_) {
+            ERROR("advance beyond end of buffer\n");
+            len = (uint32_t) (tail_pos_ - pos_at_cursor_.buffer_pos_);
+        }
+        while(len > 0) {
+            FilePos_t pos = pos_at_cursor_.buffer_pos_;
+            uint32_t chunk = std::min(len, pool_->page_size() - (uint32_t) (pos & page_mask_));
+            pos_at_cursor_.next_chars(char_ptr(pos), chunk);
+            len -= chunk;
+        }
+    }
+
+    Text_position pos_at_cursor_and_inc_nesting() {
+		position_nesting_ += 1;
+        return pos_at_cursor_;
+    }
+
+    Text_position pos_at_cursor() const {
+        return pos_at_cursor_;
+    }
+
+    bool backtrack(Text_position pos) {
+        if (!seek(pos)) {
+            return true;
+        }
+		dec_position_nesting();
+        return true;
+    }
+
+    bool seek(Text_position pos) {
+        if (pos.buffer_pos_ < pos_at_head_ || pos.buffer_pos_ > tail_pos_) {
+            ERROR("can't set text position - out of range pos %ld  head_pos %ld tail_pos %ld\n", pos.buffer_pos_, pos_at_head_, tail_pos_);
+            return false;
+        }
+        pos_at_cursor_ = pos;
+        return true;
+    }
+
+    FilePos_t pos_at_head() const {
+        return pos_at_head_;
+    }
+
+	bool dec_position_nesting() {
+		if (position_nesting_ == 0) {
+			ERROR("position nesting droppes to negative count. parser is wrong\n");
+			return false;
+		}
+		position_nesting_ -= 1;
+		if (position_nesting_ == 0) {
+			return move_on( pos_at_cursor() );
+		}
+		return true;
+	}
+
+	// discard all text up until the argument position; pages before that position are returned to the page pool.
+    bool move_on(Text_position pos) {
+
+        if (pos.buffer_pos_ < pos_at_head_ || pos.buffer_pos_ > tail_pos_) {
+            ERROR("can't set text position - out of range pos %ld  head_pos %ld tail_pos %ld\n", pos.buffer_pos_, pos_at_head_, tail_pos_);
+            return true;
+        }
+        pos_at_cursor_ = pos;
+        pos_at_head_ = pos.buffer_pos_;
+        lines_.discard_before(pos_at_head_);
+
+        release_pages( (size_t) ((pos_at_head_ - first_page_pos_) >> page_shift_) );
+        return true;
+    }
+
+    int error() { return error_; }
+
+	// keep the whole line index (see Text_stream::keep_line_index)
+    void keep_line_index(bool keep) {
+        lines_.keep_all(keep);
+    }
+
+	// number of newline offsets in the line index
+    size_t line_index_entries() const {
+        return lines_.entries();
+    }
+
+	// line and column of an offset in the text
+    Line_column line_column(FilePos_t offset) {
+        return lines_.line_column(offset);
+    }
+
+	// incremented each time that the stream is opened: a position of the previous text is no longer valid
+    uint32_t generation() const {
+        return generation_;
+    }
+
+	// number of pages in the lookahead buffer
+    size_t num_pages() const {
+        return pages_.size();
+    }
+
+private:
+    Char_t *char_ptr(FilePos_t pos) const {
+        return pages_[ (size_t) ((pos - first_page_pos_) >> page_shift_) ] + (pos & page_mask_);
+    }
+
+	// free space after the tail, a page is appended if the last page is full.
+    Char_t *tail_space(uint32_t *len) {
+        uint32_t offset = (uint32_t) (tail_pos_ & page_mask_);
+        if (offset == 0 && (FilePos_t) (first_page_pos_ + (pages_.size() << page_shift_)) == tail_pos_) {
+            pages_.push_back( pool_->get() );
+        }
+        *len = pool_->page_size() - offset;
+        return char_ptr(tail_pos_);
+    }
+
+    void add_tail(const Char_t *data, uint32_t len) {
+        lines_.add_text(data, len);
+        tail_pos_ += len;
+    }
+
+    void release_pages(size_t num_pages) {
+        for(size_t i = 0; i < num_pages && !pages_.empty(); ++i) {
+            pool_->put( pages_.front() );
+            pages_.pop_front();
+            first_page_pos_ += pool_->page_size();
+        }
+    }
+
+    bool fill() {
+        if (fd_ == -1 || eof_) {
+            return false;
+        }
+
+        uint32_t len;
+        Char_t *dest = tail_space(&len);
+
+        ssize_t available = ::read(fd_, dest, len);
+        if (available == -1) {
+            if (errno != EAGAIN) {
+                error_ = errno;
+                ERROR("read error. error %d\n", error_);
+            }
+            return false;
+        }
+        if (available == 0) {
+            eof_ = true;
+            return false;
+        }
+        add_tail(dest, (uint32_t) available);
+        return true;
+    }
+
+    int fd_;
+    int error_;
+    bool eof_;
+    std::unique_ptr<Text_page_pool> own_pool_;
+    Text_page_pool *pool_;
+    uint32_t page_shift_;
+    FilePos_t page_mask_;
+    std::deque<Char_t *> pages_;
+    FilePos_t first_page_pos_;	// position of the first character of the first page
+    FilePos_t tail_pos_;		// position after the last character in the buffer
+    FilePos_t pos_at_head_;
+    Text_position  pos_at_cursor_;
+    Line_index lines_;
+    std::string scratch_;
+	int position_nesting_;
+    uint32_t generation_;
+};
+
+} // namespace pparse
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <memory>
+
+namespace pparse {
+
+//
+// Token - a token found by the Token_scanner
+//
+
+struct Token {
+	FilePos_t offset_;
+	uint32_t length_;
+	int32_t kind_;		// index of the PTokVar checker that matched the token, Token_literal_kind for a fixed token (PTok)
+};
+
+static const int32_t Token_literal_kind = -1;
+
+//
+// Token_scanner - splits the text into tokens, the terminals are the fixed tokens (PTok) and the checker callbacks (PTokVar) of a grammar.
+//
+// At each offset the longest token is chosen, if a fixed token and a checker match the same number of characters then it's a fixed token (keywords are not identifiers).
+//
+
+class Token_scanner {
+public:
+
+	Token_scanner(const TokenCollisionChecker &terminals) : literals_(terminals.tokens()), checkers_(terminals.token_checkers()) {
+
+		// longest fixed tokens first, so that the first fixed token that matches is the longest one.
+		std::sort(literals_.begin(), literals_.end(), [](const std::string &a, const std::string &b) { return a.size() > b.size(); });
+
+		for(size_t i = 0; i < literals_.size(); ++i) {
+			if (!literals_[i].empty()) {
+				by_first_char_[ (unsigned char) literals_[i][0] ].push_back( (uint32_t) i );
+			}
+		}
+	}
+
+	// tokenize all of the text, the text between the tokens is skipped by the Skipper; returns false if the text at *error_pos is not a token (the tokens up to that position are returned)
+	template<typename Skipper>
+	bool scan(Text_memory_stream &text, std::vector<Token> &tokens, FilePos_t *error_pos) {
+
+		tokens.clear();
+
+		for(;;) {
+			Skipper::skip(text);
+
+			FilePos_t pos = text.pos_at_cursor().buffer_pos_;
+			if (pos >= text.size()) {
+				return true;
+			}
+
+			Token token = match(text.data(), text.size(), pos);
+			if (token.length_ == 0) {
+				*error_pos = pos;
+				return false;
+			}
+			tokens.push_back(token);
+			text.advance(token.length_);
+		}
+	}
+
+	// number of characters at offset pos that are accepted by checker, zero if it doesn't match. (same rules as in PTokVar::parse)
+	static uint32_t match_checker(PTokVar_cb_t *checker, const Char_t *data, FilePos_t size, FilePos_t pos, std::string &matched) {
+
+		matched.clear();
+
+		for(FilePos_t cur = pos; ; ++cur) {
+			bool iseof = cur >= size;
+
+			switch(checker(iseof ? ' ' : data[cur], iseof, matched)) {
+				case Char_checker_result::proceed:
+					if (iseof) {
+						return 0;
+					}
+					matched += data[cur];
+					break;
+
+				case Char_checker_result::acceptNow:
+					return (uint32_t) (iseof ? cur - pos : cur + 1 - pos);
+
+				case Char_checker_result::acceptUnget:
+					return (uint32_t) (cur - pos);
+
+				case Char_checker_result::error:
+					return 0;
+			}
+		}
+	}
+
+private:
+	Token match(const Char_t *data, FilePos_t size, FilePos_t pos) {
+
+		Token ret{ pos, 0, Token_literal_kind };
+
+		for(uint32_t index : by_first_char_[ (unsigned char) data[pos] ]) {
+			const std::string &literal = literals_[ index ];
+			if ((FilePos_t) literal.size() <= size - pos && memcmp(data + pos, literal.data(), literal.size()) == 0) {
+				ret.length_ = (uint32_t) literal.size();
+				break;
+			}
+		}
+
+		for(size_t i = 0; i < checkers_.size(); ++i) {
+			uint32_t length = match_checker(checkers_[i], data, size, pos, matched_);
+			if (length > ret.length_) {
+				ret.length_ = length;
+				ret.kind_ = (int32_t) i;
+			}
+		}
+		return ret;
+	}
+
+	std::vector<std::string> literals_;
+	std::vector<PTokVar_cb_t *> checkers_;
+	std::vector<uint32_t> by_first_char_[256];
+	std::string matched_;
+};
+
+//
+// Token_stream - the text as an array of tokens, for the Token_parser.
+//
+// The text is tokenized once when the stream is opened, the parser then moves over the token array: backtracking sets the index of the current token.
+// Positions are still offsets in the text; the position after a token is the offset after its last character.
+//
+
+class Token_stream {
+public:
+
+	Token_stream() : text_(nullptr), cursor_(0), pos_at_head_(0), error_pos_(-1), generation_(0) {
+	}
+
+	// tokenize the text with the terminals of the grammar Parser, the whitespace (and comments) between the tokens are skipped by the Skipper.
+	// returns false if the text can't be tokenized: the tokens before scan_error_pos() are kept, the parser fails at the error position.
+	template<typename Parser, typename Skipper = Skip_whitespace>
+	bool open(Text_memory_stream &text) {
+
+		text_ = &text;
+		terminals_ = PTopLevelParser<Parser>::make_collision_checker();
+		cursor_ = 0;
+		pos_at_head_ = 0;
+		error_pos_ = -1;
+		generation_ += 1;
+
+		Token_scanner scanner(*terminals_);
+		Text_memory_stream scan_text(text.data(), text.size());
+
+		return scanner.scan<Skipper>(scan_text, tokens_, &error_pos_);
+	}
+
+	const std::shared_ptr<TokenCollisionChecker> &terminals() const {
+		return terminals_;
+	}
+
+	const std::vector<Token> &tokens() const {
+		return tokens_;
+	}
+
+	// offset of the text that is not a token, -1 if all of the text has been tokenized.
+	FilePos_t scan_error_pos() const {
+		return error_pos_;
+	}
+
+	const Token *current_token() const {
+		return cursor_ < tokens_.size() ? &tokens_[ cursor_ ] : nullptr;
+	}
+
+	void next_token() {
+		cursor_ += 1;
+	}
+
+	std::string_view token_text(const Token &token) const {
+		return std::string_view( text_->data() + token.offset_, token.length_ );
+	}
+
+	// true if the token is accepted by the checker of a PTokVar: either the checker has found the token,
+	// or it accepts the same text (a PTokVar that isn't checked for token clashes accepts a keyword as identifier).
+	bool token_matches(const Token &token, PTokVar_cb_t *checker) {
+		if (token.kind_ != Token_literal_kind && terminals_->token_checkers()[ token.kind_ ] == checker) {
+			return true;
+		}
+		return Token_scanner::match_checker(checker, text_->data(), text_->size(), token.offset_, matched_) == token.length_;
+	}
+
+	// the first character of the current token (or of the text that is not a token)
+    std::pair<bool, Char_t> current_char() const {
+		if (cursor_ < tokens_.size()) {
+			return std::pair<bool, Char_t>(true, text_->data()[ tokens_[ cursor_ ].offset_ ]);
+		}
+		if (error_pos_ != -1) {
+			return std::pair<bool, Char_t>(true, text_->data()[ error_pos_ ]);
+		}
+		return std::pair<bool, Char_t>(false, ' ');
+	}
+
+	Text_position pos_at_cursor() {
+		return position( cursor_ == 0 ? 0 : token_end( cursor_ - 1 ) );
+	}
+
+	// position of the start of the current token
+	Text_position pos_at_token() {
+		if (cursor_ < tokens_.size()) {
+			return position( tokens_[ cursor_ ].offset_ );
+		}
+		return pos_at_cursor();
+	}
+
+	bool seek(Text_position pos) {
+		if (pos.buffer_pos_ < pos_at_head_) {
+			ERROR("can't set text position - out of range pos %ld  head_pos %ld\n", pos.buffer_pos_, pos_at_head_);
+			return false;
+		}
+
+		// the position after the last token before the first token that starts at or after pos.
+		if (cursor_ > 0 && token_end( cursor_ - 1 ) == pos.buffer_pos_) {
+			return true;
+		}
+		cursor_ = std::lower_bound(tokens_.begin(), tokens_.end(), pos.buffer_pos_, [](const Token &token, FilePos_t offset) { return token.offset_ < offset; }) - tokens_.begin();
+		return true;
+	}
+
+	bool backtrack(Text_position pos) {
+		return seek(pos);
+	}
+
+    FilePos_t pos_at_head() const {
+        return pos_at_head_;
+    }
+
+    // changes when the stream is opened again
+    uint32_t generation() const {
+        return generation_;
+    }
+
+	// it is no longer possible to backtrack before the argument position
+	bool move_on(Text_position pos) {
+		if (!seek(pos)) {
+			return true;
+		}
+		pos_at_head_ = pos.buffer_pos_;
+		return true;
+	}
+
+    Line_column line_column(FilePos_t offset) {
+        return text_->line_column(offset);
+    }
+
+private:
+	FilePos_t token_end(size_t index) const {
+		return tokens_[ index ].offset_ + tokens_[ index ].length_;
+	}
+
+	Text_position position(FilePos_t offset) {
+		Text_position ret;
+		ret.buffer_pos_ = offset;
+#ifdef __PARSER_EAGER_POSITION__
+		Line_column line_column = text_->line_column(offset);
+		ret.line_ = line_column.line();
+		ret.column_ = line_column.column();
+#endif
+		return ret;
+	}
+
+	Text_memory_stream *text_;
+	std::shared_ptr<TokenCollisionChecker> terminals_;
+	std::vector<Token> tokens_;
+	size_t cursor_;
+	FilePos_t pos_at_head_;
+	FilePos_t error_pos_;
+	uint32_t generation_;
+	std::string matched_;
+};
+
+//
+// Token_parser - base parser that parses a Token_stream: PTok and PTokVar compare the current token, instead of scanning the characters of the text.
+//
+// The text is scanned only once, and backtracking doesn't scan the same text again; however a fixed token must match a whole token (PTok<1,CSTR1("<")> doesn't match the start of the token <=)
+//
+
+struct Token_parser : ParserBase {
+
+		using AstType = void;
+
+		static inline const bool token_mode = true;
+
+		Token_parser(Token_stream &stream) : tokens_(stream) {
+				set_collision_checker( stream.terminals() );
+		}
+
+		static Char_value  current_char(Token_parser &parser) {
+				return parser.tokens_.current_char();
+		}
+
+		static inline Text_position current_pos(Token_parser &parser) {
+				return parser.tokens_.pos_at_cursor();
+		}
+
+		static inline Text_position current_pos_and_inc_nesting(Token_parser &parser) {
+				return parser.tokens_.pos_at_cursor();
+		}
+
+		static inline Text_position dec_position_nesting(Token_parser &parser) {
+				return parser.tokens_.pos_at_cursor();
+		}
+
+		static inline bool backtrack(Token_parser &parser, Text_position pos) {
+				return parser.tokens_.backtrack(pos);
+		}
+
+		static inline bool seek(Token_parser &parser, Text_position pos) {
+				return parser.tokens_.seek(pos);
+		}
+
+		static inline FilePos_t pos_at_head(Token_parser &parser) {
+				return parser.tokens_.pos_at_head();
+		}
+
+		static inline uint32_t generation(Token_parser &parser) {
+				return parser.tokens_.generation();
+		}
+
+		// the whitespace has been skipped by the Token_scanner
+		static inline void skip_whitespace(Token_parser &parser) {
+		}
+
+		static inline bool can_backtrack(Token_parser &parser, Text_position pos) {
+				return pos.buffer_pos_ >= parser.tokens_.pos_at_head();
+		}
+
+		static inline void cut(Token_parser &parser) {
+				parser.tokens_.move_on( parser.tokens_.pos_at_cursor() );
+		}
+
+		static inline const Token *current_token(Token_parser &parser) {
+				return parser.tokens_.current_token();
+		}
+
+		static inline void next_token(Token_parser &parser) {
+				parser.tokens_.next_token();
+		}
+
+		static inline Text_position token_pos(Token_parser &parser) {
+				return parser.tokens_.pos_at_token();
+		}
+
+		static inline std::string_view token_text(Token_parser &parser, const Token &token) {
+				return parser.tokens_.token_text(token);
+		}
+
+		static inline bool token_matches(Token_parser &parser, const Token &token, PTokVar_cb_t *checker) {
+				return parser.tokens_.token_matches(token, checker);
+		}
+
+private:
+		Token_stream &tokens_;
+};
+
+} // namespace pparse
@@ -4,11 +4,18 @@
 #include <unordered_map>
 #include <set>
 #include <typeinfo>
+#include <vector>
+#include <algorithm>
 
 namespace pparse {
 
 using TokenHash = unsigned long;
 
+// callback of the PTokVar parser (see parse_atomic.h)
+enum class Char_checker_result;
+
+typedef Char_checker_result (PTokVar_cb_t) (Char_t current_char, bool iseof, std::string &matched_so_far);
+
 //
 // The collision checker is a helper object.
 // it is used to check that variables that have the string value of a token are not accepted as a variable;
@@ -58,7 +65,27 @@ struct TokenCollisionChecker {
         return true;
     }
 
-    bool has_token(const Char_t *token, uint32_t token_len) {
+    // the checker callbacks of the PTokVar parsers in the grammar are also collected (for the Token_scanner)
+    void insert_checker(PTokVar_cb_t *checker) {
+        if (std::find(checkers.begin(), checkers.end(), checker) == checkers.end()) {
+            checkers.push_back(checker);
+        }
+    }
+
+    // all fixed tokens of the grammar
+    std::vector<std::string> tokens() const {
+        std::vector<std::string> ret;
+        for(auto &entry : mapHashToToken) {
+            ret.push_back( entry.second );
+        }
+        return ret;
+    }
+
+    const std::vector<PTokVar_cb_t *> &token_checkers() const {
+        return checkers;
+    }
+
+    bool has_token(const Char_t *token, uint32_t token_len) const {
        TokenHash hash = calculate_hash( token, token_len );
        return has_token_imp( token, token_len, hash );
     } 
@@ -75,7 +102,7 @@ struct TokenCollisionChecker {
 
 private:
 
-    inline bool has_token_imp(const Char_t *token, uint32_t token_len, TokenHash hash) {
+    inline bool has_token_imp(const Char_t *token, uint32_t token_len, TokenHash hash) const {
         auto pos = mapHashToToken.find( hash );
        if (pos == mapHashToToken.end()) {
            return false;
@@ -93,6 +120,7 @@ private:
 
     Map_type mapHashToToken;
     Type_info_set_type tinfo_set;
+    std::vector<PTokVar_cb_t *> checkers;
 };
     
 
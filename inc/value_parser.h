@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vector>
+#include <type_traits>
+#include <cassert>
+#include "parsedef.h"
+
+namespace pparse {
+
+//
+// Value_span - the values that the rules of a PAction have pushed on the value stack, in the order of the input
+//
+
+template<typename Value>
+struct Value_span {
+
+	const Value *begin() const {
+		return data_;
+	}
+
+	const Value *end() const {
+		return data_ + size_;
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+	bool empty() const {
+		return size_ == 0;
+	}
+
+	const Value &operator[](size_t idx) const {
+		return data_[ idx ];
+	}
+
+	const Value *data_;
+	size_t size_;
+};
+
+//
+// Token_conversion - pushes the value of a token on the value stack of the Value_parser
+//
+// By default Value is constructed from the token value; if it can't be then that's a compile error. Specialize Token_conversion for the
+// Value and the token value to convert it, or derive the specialization from Ignore_token to push nothing for such tokens:
+//
+//		template<> struct Token_conversion<int64_t, std::string_view> : Ignore_token<int64_t, std::string_view> {};
+//
+
+template<typename Value, typename TokenValue>
+struct Token_conversion {
+
+	static_assert(std::is_constructible_v<Value, TokenValue>, "Value can't be constructed from the value of a token, specialize Token_conversion<Value, TokenValue>");
+
+	static void push(std::vector<Value> &values, TokenValue &&value) {
+		values.emplace_back( std::move(value) );
+	}
+};
+
+template<typename Value, typename TokenValue>
+struct Ignore_token {
+	static void push(std::vector<Value> &, TokenValue &&) {
+	}
+};
+
+//
+// Value_parser - base parser that computes a value of type Value for the input while parsing, instead of building the AST.
+//
+// Base is the base parser that reads the text (CharParser, MemoryCharParser, Token_parser ...). The values are kept on a value stack:
+// a token pushes its value with Token_conversion (PTokInt pushes an int64_t, the other PTokVar tokens push the token text as a
+// std::string_view that is valid during the call only; PTok pushes nothing), PAction<Rule, F> replaces the values that Rule has pushed with
+// the value of F. If a rule fails then the values that it has pushed are dropped. A PTokInt number that doesn't fit an int64_t is a parse error.
+//
+// The packrat memo is not used (a memoized result doesn't have the values of the rule).
+//
+
+template<typename Base, typename Value>
+struct Value_parser : Base {
+
+		static inline const bool synthesize_values = true;
+
+		using Value_type = Value;
+
+		template<typename Stream>
+		Value_parser(Stream &stream) : Base(stream) {
+				this->build_ast_ = false;
+				values_.reserve(64);
+		}
+
+		size_t value_mark() const {
+				return values_.size();
+		}
+
+		// drop the values after the mark (the rule that has pushed them has failed)
+		void drop_values(size_t mark) {
+				values_.erase( values_.begin() + mark, values_.end() );
+		}
+
+		template<typename TokenValue>
+		void token_value(TokenValue value) {
+				Token_conversion<Value, TokenValue>::push( values_, std::move(value) );
+		}
+
+		// replace the values after the mark with the value of Action
+		template<typename Action>
+		void reduce(size_t mark) {
+				Value value = Action()( Value_span<Value>{ values_.data() + mark, values_.size() - mark } );
+				drop_values(mark);
+				values_.push_back( std::move(value) );
+		}
+
+		// the value of the top level rule, after a successful parse (the value stack must not be empty)
+		const Value &value() const {
+				assert(!values_.empty());
+				return values_.back();
+		}
+
+		const std::vector<Value> &values() const {
+				return values_;
+		}
+
+		void clear_values() {
+				values_.clear();
+		}
+
+private:
+		std::vector<Value> values_;
+};
+
+//
+// Value_rule - parse a rule with the Value_parser: if the rule fails then the values that it has pushed are dropped
+//
+
+struct Value_rule {
+
+	template<typename ParserBase>
+	static Parse_result parse(ParserBase &base, Parse_result (*parse_rule)(ParserBase &)) {
+
+		size_t mark = base.value_mark();
+
+		Parse_result res = parse_rule(base);
+		if (!res.success_) {
+			base.drop_values(mark);
+		}
+		return res;
+	}
+};
+
+} // namespace pparse
@@ -16,24 +16,24 @@ struct VisualizeTrace {
 
 		static std::string  trace_start_parsing(Text_position pos) {
 			std::string short_name = make_short_name();
-			printf("(%03ld)%sstart parsing: %s at: (%d:%d offset: %ld)\n", nesting_, std::string( nesting_, ' ').c_str(), short_name.c_str(), pos.line_, pos.column_, pos.buffer_pos_);
+			printf("(%03ld)%sstart parsing: %s at: (%s)\n", nesting_, std::string( nesting_, ' ').c_str(), short_name.c_str(), format_pos(pos).c_str());
 			nesting_ += 1;
 			return short_name;
 		}
 
 		static void end_parsing(std::string &short_name, bool success,Text_position pos) {
 			nesting_ -= 1;
-			printf("(%03ld)%send parsing: %s %s at: (%d:%d offset: %ld)\n", nesting_, std::string( nesting_, ' ').c_str(), short_name.c_str(), success ? "SUCCESS" : "FAIL", pos.line_, pos.column_, pos.buffer_pos_ );
+			printf("(%03ld)%send parsing: %s %s at: (%s)\n", nesting_, std::string( nesting_, ' ').c_str(), short_name.c_str(), success ? "SUCCESS" : "FAIL", format_pos(pos).c_str() );
 		}
 
 		static void end_parsing_choice(std::string &short_name, bool success,Text_position pos, size_t index) {
 			nesting_ -= 1;
 
 			if (success) {
-				printf("(%03ld)%send parsing: %s SUCCESS choice-index: %ld at: (%d:%d offset: %ld)\n", nesting_, std::string( nesting_, ' ').c_str(), short_name.c_str(), index , pos.line_, pos.column_, pos.buffer_pos_ );
+				printf("(%03ld)%send parsing: %s SUCCESS choice-index: %ld at: (%s)\n", nesting_, std::string( nesting_, ' ').c_str(), short_name.c_str(), index , format_pos(pos).c_str() );
 			} else {
 
-				printf("(%03ld)%send parsing: %s FAIL at (%d:%d offset: %ld)\n", nesting_, std::string( nesting_, ' ').c_str(), short_name.c_str(), pos.line_, pos.column_, pos.buffer_pos_ );
+				printf("(%03ld)%send parsing: %s FAIL at (%s)\n", nesting_, std::string( nesting_, ' ').c_str(), short_name.c_str(), format_pos(pos).c_str() );
 			}
 		}
 
@@ -41,7 +41,7 @@ struct VisualizeTrace {
 		static std::string  trace_start_parsing_token(Text_position pos) {
 			std::string short_name = make_token_name();
 			
-			printf("(%03ld)%sstart parsing: %s at: (%d:%d offset: %ld)\n", nesting_, std::string( nesting_, ' ').c_str(), short_name.c_str(), pos.line_, pos.column_, pos.buffer_pos_);
+			printf("(%03ld)%sstart parsing: %s at: (%s)\n", nesting_, std::string( nesting_, ' ').c_str(), short_name.c_str(), format_pos(pos).c_str());
 			nesting_ += 1;
 			
 			return short_name;
@@ -51,6 +51,16 @@ struct VisualizeTrace {
 
 private:
 
+		static std::string format_pos(Text_position pos) {
+			char buf[80];
+#ifdef __PARSER_EAGER_POSITION__
+			snprintf(buf, sizeof(buf), "%d:%d offset: %ld", pos.line_, pos.column_, pos.buffer_pos_);
+#else
+			snprintf(buf, sizeof(buf), "offset: %ld", pos.buffer_pos_);
+#endif
+			return std::string(buf);
+		}
+
 		static std::string make_token_name() {
 
 			std::string rval("token: ");	
@@ -0,0 +1,270 @@
+#include "gtest/gtest.h"
+
+//enable execution trace with the next define
+//#define  __PARSER_TRACE__
+#include "parse.h"
+
+#include <string.h>
+#include <chrono>
+#include <map>
+
+namespace {
+
+using namespace pparse;
+
+// the actions of the arithmetic grammar, the value of a rule is an int64_t
+
+struct Sum {
+	int64_t operator()(Value_span<int64_t> values) const {
+		int64_t ret = 0;
+		for(auto value : values) {
+			ret += value;
+		}
+		return ret;
+	}
+};
+
+struct Product {
+	int64_t operator()(Value_span<int64_t> values) const {
+		int64_t ret = 1;
+		for(auto value : values) {
+			ret *= value;
+		}
+		return ret;
+	}
+};
+
+struct Negate {
+	int64_t operator()(Value_span<int64_t> values) const {
+		return -values[0];
+	}
+};
+
+struct Int : PTokInt<1> {};
+
+struct Expr;
+
+struct NestedExpr : PSeq<2, PTok<3, CSTR1("(")>, Expr, PTok<4, CSTR1(")")> > {};
+
+struct NegativeInt : PAction< PSeq<5, PTok<6, CSTR1("-")>, Int>, Negate > {};
+
+struct SimpleExpr : PAny<7, Int, NegativeInt, NestedExpr> {};
+
+struct MultExpr : PAction< PSeq<8, SimpleExpr, PStar<9, PSeq<10, PTok<11, CSTR1("*")>, SimpleExpr> > >, Product > {};
+
+// a term that is subtracted is negated, the expression is the sum of its terms
+struct AddTerm : PAny<12, PSeq<13, PTok<14, CSTR1("+")>, MultExpr>, PAction< PSeq<15, PTok<16, CSTR1("-")>, MultExpr>, Negate > > {};
+
+struct Expr : PAction< PSeq<17, MultExpr, PStar<18, AddTerm> >, Sum > {};
+
+struct ExprEof : PRequireEof<Expr> {};
+
+int64_t evaluate(const char *text) {
+	Text_memory_stream stream(text);
+	Value_parser<MemoryCharParser, int64_t> parser(stream);
+
+	Parse_result res = ExprEof::parse(parser);
+	EXPECT_TRUE(res.success());
+	EXPECT_TRUE(res.get_ast() == nullptr);
+	EXPECT_EQ(parser.values().size(), (size_t) 1);
+	return parser.value();
+}
+
+TEST(TestAction, testEvaluate) {
+
+	EXPECT_EQ(evaluate("42"), 42);
+	EXPECT_EQ(evaluate("1 + 2 * 3"), 7);
+	EXPECT_EQ(evaluate("10 - 2 - 3"), 5);
+	EXPECT_EQ(evaluate("(1 + 2) * (3 - -4)"), 21);
+	EXPECT_EQ(evaluate("2 * (3 + 4) * 5 - 1"), 69);
+}
+
+TEST(TestAction, testFailure) {
+
+	// the values of the rules that fail are dropped.
+	Text_memory_stream stream("1 + 2 * ");
+	Value_parser<MemoryCharParser, int64_t> parser(stream);
+
+	Parse_result res = ExprEof::parse(parser);
+	EXPECT_FALSE(res.success());
+	EXPECT_TRUE(parser.values().empty());
+
+	// the first alternative fails after the number has been pushed, the second alternative pushes it again.
+	using Alternatives = PAny<20, PSeq<21, Int, PTok<22, CSTR1(";")> >, PSeq<23, Int, PTok<24, CSTR1(",")> > >;
+
+	Text_memory_stream stream2("17 ,");
+	Value_parser<MemoryCharParser, int64_t> parser2(stream2);
+
+	Parse_result res2 = Alternatives::parse(parser2);
+	EXPECT_TRUE(res2.success());
+	EXPECT_EQ(parser2.values(), std::vector<int64_t>{ 17 });
+
+	// the number is followed by a comma: the lookahead fails, after the number has been pushed.
+	using NotLast = PWithNotLookahead<Int, PTok<25, CSTR1(",")> >;
+	using List = PSeq<26, PStar<27, NotLast>, Int, PTok<28, CSTR1(",")> >;
+
+	Text_memory_stream stream3("17 ,");
+	Value_parser<MemoryCharParser, int64_t> parser3(stream3);
+
+	Parse_result res3 = NotLast::parse(parser3);
+	EXPECT_FALSE(res3.success());
+	EXPECT_TRUE(parser3.values().empty());
+
+	Text_memory_stream stream4("1 2 3 ,");
+	Value_parser<MemoryCharParser, int64_t> parser4(stream4);
+
+	Parse_result res4 = List::parse(parser4);
+	EXPECT_TRUE(res4.success());
+	EXPECT_EQ(parser4.values(), (std::vector<int64_t>{ 1, 2, 3 }));
+}
+
+TEST(TestAction, testOverflow) {
+
+	// a number that doesn't fit an int64_t is a parse error
+	Text_memory_stream stream("1 + 99999999999999999999");
+	Value_parser<MemoryCharParser, int64_t> parser(stream);
+
+	Parse_result res = ExprEof::parse(parser);
+	EXPECT_FALSE(res.success());
+	EXPECT_TRUE(parser.values().empty());
+
+	EXPECT_EQ(evaluate("1 + 9223372036854775807 - 1"), 9223372036854775807);
+}
+
+// the value of an identifier is the value of a variable
+std::map<std::string, int64_t, std::less<> > variables;
+
+} // namespace
+
+namespace pparse {
+
+template<>
+struct Token_conversion<int64_t, std::string_view> {
+	static void push(std::vector<int64_t> &values, std::string_view &&text) {
+		auto pos = variables.find(text);
+		values.push_back( pos != variables.end() ? pos->second : 0 );
+	}
+};
+
+} // namespace pparse
+
+namespace {
+
+struct Operand : PAny<40, Int, PTokIdentifierCStyle<41> > {};
+
+struct OperandSum : PRequireEof< PAction< PSeq<42, Operand, PStar<43, PSeq<44, PTok<45, CSTR1("+")>, Operand> > >, Sum > > {};
+
+TEST(TestAction, testTokenConversion) {
+
+	variables = { { "x", 3 }, { "y", 4 } };
+
+	Text_memory_stream stream("x + 2 + y + z");
+	Value_parser<MemoryCharParser, int64_t> parser(stream);
+
+	Parse_result res = OperandSum::parse(parser);
+	EXPECT_TRUE(res.success());
+	EXPECT_EQ(parser.value(), 9);
+}
+
+// a configuration: the actions store the settings, the value of a token is its text.
+
+struct Config_value {
+	Config_value(std::string_view text) : text_(text) {
+	}
+
+	Config_value(int64_t number) : number_(number) {
+	}
+
+	std::string text_;
+	int64_t number_ = 0;
+};
+
+std::map<std::string, int64_t> settings;
+
+struct Store_setting {
+	Config_value operator()(Value_span<Config_value> values) const {
+		settings[ values[0].text_ ] = values[1].number_;
+		return values[1];
+	}
+};
+
+struct Setting : PAction< PSeq<30, PTokIdentifierCStyle<31>, PTok<32, CSTR1("=")>, PTokInt<33>, PTok<34, CSTR1(";")> >, Store_setting > {};
+
+struct Config : PRequireEof< PStar<35, Setting> > {};
+
+TEST(TestAction, testConfig) {
+
+	Text_memory_stream stream("width = 80; height = 25;\ndepth = 3;");
+	Value_parser<MemoryCharParser, Config_value> parser(stream);
+
+	settings.clear();
+	Parse_result res = Config::parse(parser);
+	EXPECT_TRUE(res.success());
+	EXPECT_EQ(parser.values().size(), (size_t) 3);
+	EXPECT_EQ(settings.size(), (size_t) 3);
+	EXPECT_EQ(settings["width"], 80);
+	EXPECT_EQ(settings["height"], 25);
+	EXPECT_EQ(settings["depth"], 3);
+}
+
+struct Counting_resource : std::pmr::memory_resource {
+
+	void *do_allocate(size_t bytes, size_t alignment) override {
+		allocations_ += 1;
+		return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void *ptr, size_t bytes, size_t alignment) override {
+		std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &arg) const noexcept override {
+		return this == &arg;
+	}
+
+	size_t allocations_ = 0;
+};
+
+TEST(TestAction, benchmarkEvaluate) {
+
+	const int num_terms = 200000;
+	std::string text;
+	int64_t expected = 0;
+	for(int i = 0; i < num_terms; ++i) {
+		int64_t term = (i % 7) * ((i % 3) + 1);
+		expected += i % 2 == 0 ? term : -term;
+		text += (i == 0 ? "" : i % 2 == 0 ? " + " : " - ") + std::to_string(i % 7) + " * (" + std::to_string(i % 3) + " + 1)";
+	}
+
+	Counting_resource value_counting;
+	Text_memory_stream stream(text);
+	Value_parser<MemoryCharParser, int64_t> parser(stream);
+	parser.set_memory_resource(&value_counting);
+
+	auto start = std::chrono::steady_clock::now();
+	Parse_result res = ExprEof::parse(parser);
+	auto end = std::chrono::steady_clock::now();
+	EXPECT_TRUE(res.success());
+	EXPECT_EQ(parser.value(), expected);
+
+	// the AST of the same input, that would then have to be walked to get the value.
+	Counting_resource ast_counting;
+	Text_memory_stream ast_stream(text);
+	MemoryCharParser ast_parser(ast_stream);
+	ast_parser.set_memory_resource(&ast_counting);
+
+	auto ast_start = std::chrono::steady_clock::now();
+	Parse_result ast_res = ExprEof::parse(ast_parser);
+	ast_res.ast_.reset();
+	auto ast_end = std::chrono::steady_clock::now();
+	EXPECT_TRUE(ast_res.success());
+
+	EXPECT_EQ(value_counting.allocations_, (size_t) 0);
+	EXPECT_TRUE(ast_counting.allocations_ > (size_t) num_terms * 10);
+
+	printf("%d terms: values %.4f s (%ld allocations) ast %.4f s (%ld allocations)\n", num_terms,
+			std::chrono::duration<double>(end - start).count(), (long) value_counting.allocations_,
+			std::chrono::duration<double>(ast_end - ast_start).count(), (long) ast_counting.allocations_);
+}
+
+} // namespace
@@ -23,7 +23,8 @@ Parse_result test_string(Char_t *test_string) {
 	Parse_result res = Parser::parse(chparser);
 	
 	if (!res.success()) {
-		printf("Error: parser error at: line: %d column: %d text: %s\n", res.get_start_pos().line(), res.get_start_pos().column(), test_string);
+		Line_column error_pos = text_stream.line_column(res.get_start_pos().offset());
+		printf("Error: parser error at: line: %d column: %d text: %s\n", error_pos.line(), error_pos.column(), test_string);
 	}
 
 	return res;
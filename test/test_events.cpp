@@ -0,0 +1,195 @@
+#include "gtest/gtest.h"
+
+//enable execution trace with the next define
+//#define  __PARSER_TRACE__
+#include "parse.h"
+
+#include <string.h>
+#include <sstream>
+#include <chrono>
+
+namespace {
+
+using namespace pparse;
+
+struct Ident : PTokIdentifierCStyle<1> {};
+
+struct Assign : PSeq<2, Ident, PTok<3, CSTR1("=")>, PTokInt<4>, PTok<5, CSTR1(";")> > {};
+
+struct Decl : PSeq<6, Ident, PTok<7, CSTR1(":")>, Ident, PTok<8, CSTR1(";")> > {};
+
+struct Stmt : PAny<9, Assign, Decl> {};
+
+struct Stmts : PStar<10, Stmt> {};
+
+// the same statements, the parser can't backtrack once the statement has been recognized
+struct CutStmt : PSeq<11, Stmt, PCut> {};
+
+struct CutStmts : PRequireEof< PStar<12, CutStmt> > {};
+
+// an assignment can't backtrack after the equal sign
+struct CutAssign : PSeq<13, Ident, PTok<14, CSTR1("=")>, PCut, PTokInt<15>, PTok<16, CSTR1(";")> > {};
+
+struct CutAssigns : PStar<17, CutAssign> {};
+
+// an identifier followed by an equal sign, the equal sign is not part of the rule
+struct AssignTarget : PWithAndLookahead<Ident, PTok<18, CSTR1("=")> > {};
+
+struct LookaheadAssign : PSeq<19, AssignTarget, PTok<3, CSTR1("=")>, PTokInt<4>, PTok<5, CSTR1(";")> > {};
+
+// visitor that writes the events as text
+struct Event_log {
+
+	void on_enter(RuleId rule, Position start) {
+		add("enter " + std::to_string(rule) + " " + std::to_string(start.offset()));
+	}
+
+	void on_exit(RuleId rule, Position start, Position end) {
+		add("exit " + std::to_string(rule) + " " + std::to_string(start.offset()) + "-" + std::to_string(end.offset()));
+	}
+
+	void on_token(RuleId rule, Position start, Position end, std::string_view text) {
+		add("token " + std::to_string(rule) + " " + std::string(text));
+		tokens_ += 1;
+	}
+
+	void on_discard(RuleId rule, Position start, Position end) {
+		add("discard " + std::to_string(rule) + " " + std::to_string(start.offset()) + "-" + std::to_string(end.offset()));
+	}
+
+	void add(const std::string &event) {
+		if (keep_) {
+			events_.push_back(event);
+		}
+	}
+
+	bool keep_ = true;
+	size_t tokens_ = 0;
+	std::vector<std::string> events_;
+};
+
+TEST(TestEvents, testEvents) {
+
+	Text_memory_stream stream("a = 1; b : int;");
+	Event_log log;
+	Event_parser<MemoryCharParser, Event_log> parser(stream, log);
+
+	Parse_result res = Stmts::parse(parser);
+	EXPECT_TRUE(res.success());
+	EXPECT_TRUE(res.get_ast() == nullptr);
+
+	// the failed Assign of the second statement (and the failed statement at the end of the input) are reported by their discard events only.
+	std::vector<std::string> expected = {
+		"enter 10 0",
+			"enter 9 0",
+				"enter 2 0",
+					"token 1 a", "token 3 =", "token 4 1", "token 5 ;",
+				"exit 2 0-5",
+			"exit 9 0-5",
+			"enter 9 6",
+				"discard 2 6-9",
+				"enter 6 6",
+					"token 1 b", "token 7 :", "token 1 int", "token 8 ;",
+				"exit 6 7-14",
+			"exit 9 7-14",
+			"discard 9 15-15",
+		"exit 10 0-15",
+	};
+	EXPECT_EQ(log.events_, expected);
+}
+
+TEST(TestEvents, testFailure) {
+
+	Text_memory_stream stream("a = 1; b = ;");
+	Event_log log;
+	Event_parser<MemoryCharParser, Event_log> parser(stream, log);
+
+	Parse_result res = CutAssigns::parse(parser);
+	EXPECT_FALSE(res.success());
+
+	// the events up to the cut have been passed to the visitor, then the rules that fail after the cut are discarded.
+	std::vector<std::string> expected = {
+		"enter 17 0",
+			"enter 13 0",
+				"token 1 a", "token 14 =", "token 15 1", "token 16 ;",
+			"exit 13 0-5",
+			"enter 13 6",
+				"token 1 b", "token 14 =",
+			"discard 13 6-11",
+		"discard 17 0-11",
+	};
+	EXPECT_EQ(log.events_, expected);
+}
+
+TEST(TestEvents, testLookahead) {
+
+	Text_memory_stream stream("a = 1;");
+	Event_log log;
+	Event_parser<MemoryCharParser, Event_log> parser(stream, log);
+
+	Parse_result res = LookaheadAssign::parse(parser);
+	EXPECT_TRUE(res.success());
+
+	// the token of the lookahead is not reported
+	std::vector<std::string> expected = {
+		"enter 19 0",
+			"token 1 a", "token 3 =", "token 4 1", "token 5 ;",
+		"exit 19 0-5",
+	};
+	EXPECT_EQ(log.events_, expected);
+
+	// outside of a rule, the tokens are passed to the visitor when the lookahead is done
+	Text_memory_stream top_stream("a = 1;");
+	Event_log top_log;
+	Event_parser<MemoryCharParser, Event_log> top_parser(top_stream, top_log);
+
+	res = AssignTarget::parse(top_parser);
+	EXPECT_TRUE(res.success());
+	EXPECT_EQ(top_log.events_, std::vector<std::string>{ "token 1 a" });
+
+	// the lookahead fails: the token of the identifier is dropped
+	Text_memory_stream fail_stream("a : int;");
+	Event_log fail_log;
+	Event_parser<MemoryCharParser, Event_log> fail_parser(fail_stream, fail_log);
+
+	res = AssignTarget::parse(fail_parser);
+	EXPECT_FALSE(res.success());
+	EXPECT_TRUE(fail_log.events_.empty());
+}
+
+TEST(TestEvents, testBoundedBuffer) {
+
+	const int num_records = 200000;
+	std::string text;
+	for(int i = 0; i < num_records; ++i) {
+		text += i % 2 == 0 ? "a" + std::to_string(i) + " = " + std::to_string(i) + ";\n" : "b" + std::to_string(i) + " : int;\n";
+	}
+
+	Text_memory_stream stream(text);
+	Event_log log;
+	log.keep_ = false;
+	Event_parser<MemoryCharParser, Event_log> parser(stream, log);
+
+	auto start = std::chrono::steady_clock::now();
+	Parse_result res = CutStmts::parse(parser);
+	auto end = std::chrono::steady_clock::now();
+	EXPECT_TRUE(res.success());
+
+	// the events of a statement are passed to the visitor at the cut after the statement.
+	EXPECT_EQ(log.tokens_, (size_t) num_records * 4);
+	EXPECT_TRUE(parser.max_buffered() < 20);
+
+	Text_memory_stream ast_stream(text);
+	MemoryCharParser ast_parser(ast_stream);
+
+	auto ast_start = std::chrono::steady_clock::now();
+	Parse_result ast_res = CutStmts::parse(ast_parser);
+	ast_res.ast_.reset();
+	auto ast_end = std::chrono::steady_clock::now();
+	EXPECT_TRUE(ast_res.success());
+
+	printf("%d statements: events %.4f s (at most %ld buffered events) ast %.4f s\n", num_records, std::chrono::duration<double>(end - start).count(), (long) parser.max_buffered(),
+			std::chrono::duration<double>(ast_end - ast_start).count());
+}
+
+} // namespace
@@ -8,6 +8,7 @@
 #include <fcntl.h>
 #include <fstream>
 #include <sstream>
+#include <chrono>
 
 
 namespace {
@@ -45,7 +46,8 @@ Parse_result test_string(Char_t *test_string) {
 	Parse_result res = Parser::parse(chparser);
 	
 	if (!res.success()) {
-		printf("Error: parser error at: line: %d column: %d text: %s\n", res.get_start_pos().line(), res.get_start_pos().column(), test_string);
+		Line_column error_pos = text_stream.line_column(res.get_start_pos().offset());
+		printf("Error: parser error at: line: %d column: %d text: %s\n", error_pos.line(), error_pos.column(), test_string);
 	}
 	EXPECT_TRUE(res.get_ast() != nullptr);
 
@@ -192,4 +194,333 @@ TEST(TestGrammar, testRegEx) {
 
 }
 
+
+TEST(TestGrammar, testArenaRewind) {
+
+	struct First : PSeq<1, PTok<2, CSTR1("a")>, PTok<3, CSTR1("b")>, PTok<4, CSTR1("c")> > {};
+	struct Second : PSeq<5, PTok<6, CSTR1("a")>, PTok<7, CSTR1("b")>, PTok<8, CSTR1("d")> > {};
+	struct Alternatives : PAny<9, First, Second> {};
+
+	std::string text = "a b d";
+
+	Ast_arena arena;
+	Text_memory_stream stream(text);
+	MemoryCharParser parser(stream);
+	parser.set_arena(&arena);
+
+	Parse_result res = Alternatives::parse(parser);
+	EXPECT_TRUE(res.success());
+	EXPECT_EQ(res.get_ast()->getRuleId(), 9);
+
+	// the nodes of the failed first alternative are gone, the arena holds the ast of the second one.
+	Ast_arena second_arena;
+	Text_memory_stream second_stream(text);
+	MemoryCharParser second_parser(second_stream);
+	second_parser.set_arena(&second_arena);
+
+	Parse_result second_res = Second::parse(second_parser);
+	EXPECT_TRUE(second_res.success());
+	EXPECT_TRUE(arena.bytes_in_use() > 0);
+	EXPECT_TRUE(arena.bytes_in_use() > second_arena.bytes_in_use());
+	EXPECT_TRUE(arena.bytes_in_use() < 2 * second_arena.bytes_in_use());
+
+	Ast_arena::Mark mark = arena.mark();
+	res.ast_.release();
+
+	Text_memory_stream failing_stream("a b e");
+	MemoryCharParser failing_parser(failing_stream);
+	failing_parser.set_arena(&arena);
+	EXPECT_FALSE(Alternatives::parse(failing_parser).success());
+	EXPECT_EQ(arena.mark().offset_, mark.offset_);
+}
+
+TEST(TestGrammar, benchmarkArenaBacktracking) {
+
+	// the expression grammar of the README
+	struct Int : PTokInt<1> {};
+
+	struct Expr;
+
+	struct Mult : PAny<2, PTok<3,CSTR1("*")>, PTok<4,CSTR1("/")> > {};
+
+	struct Add : PAny<4, PTok<5,CSTR1("+")>, PTok<6,CSTR1("-")> > {};
+
+	struct NestedExpr : PSeq<7, PTok<8, CSTR1("(")>, Expr, PTok<9, CSTR1(")")> > {};
+
+	struct NegativeInt : PSeq<10, PTok<11, CSTR1("-")>, Int> {};
+
+	struct SimpleExpr : PAny<12, Int, NegativeInt, NestedExpr> {};
+
+	struct MultExpr: PAny<13, PSeq<14, SimpleExpr, Mult, MultExpr >, SimpleExpr> {};
+
+	struct Expr: PAny<15, PSeq<16, MultExpr, Add, Expr >, MultExpr> {};
+
+	struct Stmts : PStar<17, PSeq<18, Expr, PTok<19, CSTR1(";")> > > {};
+
+	std::string text;
+	for(int i = 0; i < 40000; ++i) {
+		text += "(1 * 2 - 3) * (4 + -5) / 6 + 7 - 8 * 9;\n";
+	}
+
+	// the arena is freed after each run, so that the runs don't compete for memory
+	auto run = [&text](const char *name, bool use_arena, bool rewind) {
+		Ast_arena arena;
+		Text_memory_stream stream(text);
+		MemoryCharParser parser(stream);
+		if (use_arena) {
+			if (rewind) {
+				parser.set_arena(&arena);
+			} else {
+				parser.set_memory_resource(&arena);
+			}
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		Parse_result res = Stmts::parse(parser);
+		if (use_arena) {
+			res.ast_.release();
+		} else {
+			res.ast_.reset();
+		}
+		auto end = std::chrono::steady_clock::now();
+		EXPECT_TRUE(res.success());
+		EXPECT_EQ(res.get_end_pos().offset() + 1, (FilePos_t) text.size());
+
+		printf("%s: parse and free %.4f s, arena %ld bytes\n", name, std::chrono::duration<double>(end - start).count(), (long) arena.bytes_in_use());
+	};
+
+	run("heap", false, false);
+	run("arena without rewind", true, false);
+	run("arena with rewind", true, true);
+}
+
+
+TEST(TestGrammar, testRecognize) {
+
+	struct Int : PTokInt<1> {};
+
+	struct Expr;
+
+	struct Mult : PAny<2, PTok<3,CSTR1("*")>, PTok<4,CSTR1("/")> > {};
+
+	struct Add : PAny<4, PTok<5,CSTR1("+")>, PTok<6,CSTR1("-")> > {};
+
+	struct NestedExpr : PSeq<7, PTok<8, CSTR1("(")>, Expr, PTok<9, CSTR1(")")> > {};
+
+	struct NegativeInt : PSeq<10, PTok<11, CSTR1("-")>, Int> {};
+
+	struct SimpleExpr : PAny<12, Int, NegativeInt, NestedExpr> {};
+
+	struct MultExpr: PAny<13, PSeq<14, SimpleExpr, Mult, MultExpr >, SimpleExpr> {};
+
+	struct Expr: PAny<15, PSeq<16, MultExpr, Add, Expr >, MultExpr> {};
+
+	// a number that is not followed by an opening bracket
+	struct Call : PSeq<17, PTokIdentifierCStyle<18>, PTok<19, CSTR1("(")>, POpt<20, Expr>, PTok<21, CSTR1(")")> > {};
+
+	struct Term : PAny<22, Call, PWithNotLookahead<Expr, PTok<23, CSTR1("(")> > > {};
+
+	struct Terms : PRequireEof< PStar<24, PSeq<25, Term, PTok<26, CSTR1(";")> > > > {};
+
+	const char *inputs[] = { "1;", "(2*3) + 5; f(1 - 2); g();", "2 + 2 + 2 + 1 * 3;", "1 + 2;3 (;", "f(1;", "-1 * (2 + -3);" };
+
+	for(const char *input : inputs) {
+		Ast_arena arena;
+
+		Text_memory_stream stream(input);
+		MemoryCharParser parser(stream);
+		Parse_result res = Terms::parse(parser);
+
+		// no AST nodes are allocated
+		Text_memory_stream recognize_stream(input);
+		MemoryCharParser recognize_parser(recognize_stream);
+		recognize_parser.set_arena(&arena);
+		Parse_result recognized = recognize<Terms>(recognize_parser);
+
+		EXPECT_EQ(recognized.success(), res.success());
+		EXPECT_EQ(recognized.get_start_pos().offset(), res.get_start_pos().offset());
+		EXPECT_EQ(recognized.get_end_pos().offset(), res.get_end_pos().offset());
+		EXPECT_TRUE(recognized.get_ast() == nullptr);
+		EXPECT_EQ(arena.bytes_in_use(), (size_t) 0);
+		EXPECT_TRUE(recognize_parser.build_ast_);
+	}
+}
+
+TEST(TestGrammar, benchmarkRecognize) {
+
+	struct Int : PTokInt<1> {};
+
+	struct Expr;
+
+	struct Mult : PAny<2, PTok<3,CSTR1("*")>, PTok<4,CSTR1("/")> > {};
+
+	struct Add : PAny<4, PTok<5,CSTR1("+")>, PTok<6,CSTR1("-")> > {};
+
+	struct NestedExpr : PSeq<7, PTok<8, CSTR1("(")>, Expr, PTok<9, CSTR1(")")> > {};
+
+	struct NegativeInt : PSeq<10, PTok<11, CSTR1("-")>, Int> {};
+
+	struct SimpleExpr : PAny<12, Int, NegativeInt, NestedExpr> {};
+
+	struct MultExpr: PAny<13, PSeq<14, SimpleExpr, Mult, MultExpr >, SimpleExpr> {};
+
+	struct Expr: PAny<15, PSeq<16, MultExpr, Add, Expr >, MultExpr> {};
+
+	struct Stmts : PStar<17, PSeq<18, Expr, PTok<19, CSTR1(";")> > > {};
+
+	std::string text;
+	for(int i = 0; i < 40000; ++i) {
+		text += "(1 * 2 - 3) * (4 + -5) / 6 + 7 - 8 * 9;\n";
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	{
+		Text_memory_stream stream(text);
+		MemoryCharParser parser(stream);
+		Parse_result res = Stmts::parse(parser);
+		EXPECT_TRUE(res.success());
+	}
+	auto end = std::chrono::steady_clock::now();
+	double parse_time = std::chrono::duration<double>(end - start).count();
+
+	start = std::chrono::steady_clock::now();
+	{
+		Text_memory_stream stream(text);
+		MemoryCharParser parser(stream);
+		Parse_result res = recognize<Stmts>(parser);
+		EXPECT_TRUE(res.success());
+		EXPECT_EQ(res.get_end_pos().offset() + 1, (FilePos_t) text.size());
+	}
+	end = std::chrono::steady_clock::now();
+
+	printf("%ld bytes: parse %.4f s recognize %.4f s\n", (long) text.size(), parse_time, std::chrono::duration<double>(end - start).count());
+}
+
+// a log record: name = number, a list of words up to the semicolon
+struct Log_name : PTokIdentifierCStyle<1> {};
+
+struct Log_record : PSeq<2, Log_name, PTok<3, CSTR1("=")>, PTokInt<4>, PStar<5, PTokIdentifierCStyle<6> >, PTok<7, CSTR1(";")> > {};
+
+TEST(TestGrammar, testStream) {
+
+	Text_memory_stream stream("first = 1 a b;\nsecond = 2;\n third = 3 c;\n");
+	MemoryCharParser parser(stream);
+
+	std::vector<std::string> names;
+	std::vector<size_t> words;
+
+	Parse_result res = PStream<Log_record>::parse(parser, [&](Parse_result &record) {
+		Log_record::AstType *ast = (Log_record::AstType *) record.get_ast();
+		names.push_back( std::string( std::get<0>(ast->entry_)->entry_ ) );
+		words.push_back( std::get<3>(ast->entry_)->entry_.size() );
+	});
+	EXPECT_TRUE(res.success());
+	EXPECT_TRUE(res.get_ast() == nullptr);
+	EXPECT_EQ(names, (std::vector<std::string>{ "first", "second", "third" }));
+	EXPECT_EQ(words, (std::vector<size_t>{ 2, 0, 1 }));
+
+	// the records before the error have been passed on, the result is the error
+	Text_memory_stream failing_stream("first = 1;\nsecond = ;\n");
+	MemoryCharParser failing_parser(failing_stream);
+
+	size_t num_records = 0;
+	Parse_result failing_res = PStream<Log_record>::parse(failing_parser, [&](Parse_result &) { num_records += 1; });
+	EXPECT_FALSE(failing_res.success());
+	EXPECT_EQ(num_records, (size_t) 1);
+	EXPECT_EQ(failing_res.get_start_pos().offset(), (FilePos_t) 20);
+
+	// an input without records
+	Text_memory_stream empty_stream("  \n ");
+	MemoryCharParser empty_parser(empty_stream);
+	EXPECT_TRUE(PStream<Log_record>::parse(empty_parser).success());
+
+	// the sink can keep the AST of a record
+	Text_memory_stream keep_stream("first = 1;\nsecond = 2;\n");
+	MemoryCharParser keep_parser(keep_stream);
+
+	std::vector< std::unique_ptr<AstEntryBase> > kept;
+	EXPECT_TRUE(PStream<Log_record>::parse(keep_parser, [&](Parse_result &record) { kept.push_back( std::move(record.ast_) ); }).success());
+	EXPECT_EQ(kept.size(), (size_t) 2);
+	EXPECT_EQ(std::get<0>( ((Log_record::AstType *) kept[1].get())->entry_ )->entry_, "second");
+}
+
+// memory resource that tracks the largest number of bytes that are allocated at the same time
+struct Peak_resource : std::pmr::memory_resource {
+
+	void *do_allocate(size_t bytes, size_t alignment) override {
+		in_use_ += bytes;
+		peak_ = std::max(peak_, in_use_);
+		return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void *ptr, size_t bytes, size_t alignment) override {
+		in_use_ -= bytes;
+		std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &arg) const noexcept override {
+		return this == &arg;
+	}
+
+	size_t in_use_ = 0;
+	size_t peak_ = 0;
+};
+
+TEST(TestGrammar, benchmarkStream) {
+
+	char fname[] = "/tmp/test_log_streamXXXXXX";
+	int fd = mkstemp(fname);
+	EXPECT_TRUE(fd != -1);
+
+	const int num_records = 200000;
+	std::string text;
+	for(int i = 0; i < num_records; ++i) {
+		text += "record_" + std::to_string(i) + " = " + std::to_string(i) + " started by user" + std::to_string(i % 13) + ";\n";
+	}
+	EXPECT_EQ(write(fd, text.data(), text.size()), (ssize_t) text.size());
+	close(fd);
+
+	size_t line_index_entries[2] = { 0, 0 };
+
+	auto run = [&fname, &line_index_entries](bool stream_records) {
+		Text_stream stream;
+		EXPECT_TRUE(stream.open(fname));
+		CharParser parser(stream);
+		Peak_resource peak;
+		parser.set_memory_resource(&peak);
+
+		size_t num_parsed = 0;
+		auto start = std::chrono::steady_clock::now();
+		if (stream_records) {
+			Parse_result res = PStream<Log_record>::parse(parser, [&](Parse_result &) { num_parsed += 1; });
+			EXPECT_TRUE(res.success());
+		} else {
+			Parse_result res = PRequireEof< PStar<8, Log_record> >::parse(parser);
+			EXPECT_TRUE(res.success());
+			num_parsed = ((PStar<8, Log_record>::AstType *) res.get_ast())->entry_.size();
+		}
+		auto end = std::chrono::steady_clock::now();
+		EXPECT_EQ(num_parsed, (size_t) num_records);
+
+		line_index_entries[ stream_records ] = stream.line_index_entries();
+
+		printf("%s: %.4f s, peak AST memory %ld bytes, lookahead buffer %u bytes, line index %ld entries\n", stream_records ? "PStream" : "PStar",
+				std::chrono::duration<double>(end - start).count(), (long) peak.peak_, stream.buffer_size(), (long) stream.line_index_entries());
+		return peak.peak_;
+	};
+
+	size_t stream_peak = run(true);
+	size_t star_peak = run(false);
+
+	// the AST of one record is alive at a time
+	EXPECT_TRUE(stream_peak < 4096);
+	EXPECT_TRUE(star_peak > (size_t) num_records * 100);
+
+	// the line index is trimmed as PStream moves on, it would otherwise have an entry per record
+	EXPECT_TRUE(line_index_entries[1] < 4096);
+	EXPECT_EQ(line_index_entries[0], (size_t) num_records);
+
+	unlink(fname);
+}
+
 }
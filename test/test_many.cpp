@@ -0,0 +1,456 @@
+#include "gtest/gtest.h"
+
+//enable execution trace with the next define
+//#define  __PARSER_TRACE__
+#include "parse.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sstream>
+#include <chrono>
+
+namespace {
+
+using namespace pparse;
+
+struct Int : PTokInt<1> {};
+
+struct Ident : PTokIdentifierCStyle<2> {};
+
+struct Expr;
+
+struct Mult : PAny<3, PTok<4,CSTR1("*")>, PTok<5,CSTR1("/")> > {};
+
+struct Add : PAny<6, PTok<7,CSTR1("+")>, PTok<8,CSTR1("-")> > {};
+
+struct NestedExpr : PSeq<9, PTok<10, CSTR1("(")>, Expr, PTok<11, CSTR1(")")> > {};
+
+struct SimpleExpr : PAny<12, Int, Ident, NestedExpr> {};
+
+struct MultExpr: PAny<13, PSeq<14, SimpleExpr, Mult, MultExpr >, SimpleExpr> {};
+
+struct Expr: PAny<15, PSeq<16, MultExpr, Add, Expr >, MultExpr> {};
+
+// the keyword let is not accepted as identifier
+struct Let : PSeq<17, PTok<18, CSTR3("let")>, Ident, PTok<19,CSTR1("=")>, Expr > {};
+
+struct Lets : PStar<20, Let> {};
+
+struct Program : PRequireEof<Lets> {};
+
+
+std::string make_file(const std::string &text) {
+	char fname[] = "/tmp/test_manyXXXXXX";
+	int fd = mkstemp(fname);
+	EXPECT_TRUE(fd != -1);
+	ssize_t rt = write(fd, text.c_str(), text.size());
+	EXPECT_EQ(rt, (ssize_t) text.size());
+	close(fd);
+	return fname;
+}
+
+std::string make_program(int index, int num_lets) {
+	std::string text;
+	for(int i = 0; i < num_lets; ++i) {
+		text += "let a" + std::to_string(i) + " = (" + std::to_string(index) + " + b * " + std::to_string(i) + ") / c\n";
+	}
+	return text;
+}
+
+std::string to_json(Parse_result &result) {
+	std::stringstream sout;
+	Program::dumpJson(sout, (Program::AstType *) result.get_ast() );
+	return sout.str();
+}
+
+std::string parse_one(const std::string &fname) {
+	Text_stream text_stream;
+	bool isok = text_stream.open(fname.c_str());
+	EXPECT_EQ(isok, true);
+
+	CharParser chparser(text_stream);
+	Parse_result res = Program::parse(chparser);
+	EXPECT_TRUE(res.success());
+	return to_json(res);
+}
+
+TEST(TestMany, testWorkStealingPool) {
+
+	const size_t num_tasks = 1000;
+	std::vector< std::atomic<int> > runs(num_tasks);
+
+	Work_stealing_pool pool(4);
+	pool.run( num_tasks, [&runs](size_t worker, size_t index) {
+		EXPECT_TRUE(worker < 4);
+		// uneven tasks, so that the workers steal from each other
+		if (index % 4 == 0) {
+			std::this_thread::sleep_for( std::chrono::microseconds(100) );
+		}
+		runs[ index ].fetch_add(1);
+	});
+
+	for(size_t i = 0; i < num_tasks; ++i) {
+		EXPECT_EQ(runs[i].load(), 1);
+	}
+}
+
+TEST(TestMany, testInOrder) {
+
+	std::vector<std::string> inputs;
+	for(int i = 0; i < 40; ++i) {
+		inputs.push_back( make_file( make_program(i, 1 + i % 7) ) );
+	}
+	// a file that doesn't exist and a file with a syntax error (let is a keyword)
+	inputs.push_back( "/tmp/test_many_does_not_exist" );
+	inputs.push_back( make_file( "let let = 1\n" ) );
+
+	std::vector<size_t> order;
+	std::vector<std::string> json;
+	std::vector<bool> success;
+
+	size_t num_success = parse_many<Program>( inputs, [&](size_t index, Parse_result &result) {
+		order.push_back( index );
+		success.push_back( result.success() );
+		json.push_back( result.success() ? to_json(result) : "" );
+	}, Parse_many_order::in_order, 4);
+
+	EXPECT_EQ(num_success, (size_t) 40);
+	EXPECT_EQ(order.size(), inputs.size());
+
+	for(size_t i = 0; i < order.size(); ++i) {
+		EXPECT_EQ(order[i], i);
+		if (i < 40) {
+			EXPECT_TRUE(success[i]);
+			EXPECT_EQ(json[i], parse_one(inputs[i]));
+		} else {
+			EXPECT_FALSE(success[i]);
+		}
+	}
+
+	for(auto &fname : inputs) {
+		unlink(fname.c_str());
+	}
+
+	// the open of the file that doesn't exist has left ENOENT in errno
+	errno = 0;
+}
+
+TEST(TestMany, testWorkerArena) {
+
+	// the first file is big, the workers that parse the small files must not run too far ahead of it.
+	std::vector<std::string> inputs;
+	inputs.push_back( make_file( make_program(0, 20000) ) );
+	for(int i = 1; i < 100; ++i) {
+		inputs.push_back( make_file( make_program(i, 1 + i % 7) ) );
+	}
+
+	std::vector<size_t> order;
+	std::vector<std::string> json;
+
+	Parse_many_stats stats;
+	size_t num_success = parse_many<Program>( inputs, [&](size_t index, Parse_result &result) {
+		// the AST is allocated from the arena of the worker, it is used during the call only
+		order.push_back( index );
+		json.push_back( to_json(result) );
+	}, Parse_many_order::in_order, 4, Text_stream::Default_buf_size, Parse_many_memory::worker_arena, &stats);
+
+	EXPECT_EQ(num_success, inputs.size());
+	EXPECT_EQ(order.size(), inputs.size());
+	for(size_t i = 0; i < order.size(); ++i) {
+		EXPECT_EQ(order[i], i);
+		EXPECT_EQ(json[i], parse_one(inputs[i]));
+	}
+	EXPECT_TRUE(stats.max_pending_ <= (size_t) 4 * 4);
+	printf("worker arena: at most %ld results held back, %ld steals\n", (long) stats.max_pending_, (long) stats.steals_);
+
+	for(auto &fname : inputs) {
+		unlink(fname.c_str());
+	}
+}
+
+TEST(TestMany, testAsCompleted) {
+
+	std::vector<std::string> inputs;
+	for(int i = 0; i < 40; ++i) {
+		inputs.push_back( make_file( make_program(i, 1 + i % 5) ) );
+	}
+
+	std::vector<int> delivered(inputs.size(), 0);
+
+	size_t num_success = parse_many<Program>( inputs, [&](size_t index, Parse_result &result) {
+		EXPECT_TRUE(result.success());
+		delivered[ index ] += 1;
+	}, Parse_many_order::as_completed, 3);
+
+	EXPECT_EQ(num_success, inputs.size());
+	for(auto count : delivered) {
+		EXPECT_EQ(count, 1);
+	}
+
+	for(auto &fname : inputs) {
+		unlink(fname.c_str());
+	}
+}
+
+TEST(TestMany, benchmarkParseMany) {
+
+	std::vector<std::string> inputs;
+	for(int i = 0; i < 400; ++i) {
+		inputs.push_back( make_file( make_program(i, 50) ) );
+	}
+
+	size_t max_threads = std::max( (size_t) std::thread::hardware_concurrency(), (size_t) 2);
+
+	for(size_t num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+		auto start = std::chrono::steady_clock::now();
+
+		size_t num_success = parse_many<Program>( inputs, [](size_t, Parse_result &) {}, Parse_many_order::as_completed, num_threads);
+
+		auto end = std::chrono::steady_clock::now();
+		EXPECT_EQ(num_success, inputs.size());
+
+		printf("parse_many: %ld files with %ld threads %.3f s\n", (long) inputs.size(), (long) num_threads, std::chrono::duration<double>(end - start).count());
+	}
+
+	for(auto &fname : inputs) {
+		unlink(fname.c_str());
+	}
+}
+
+// records that span two lines: some chunk boundaries are in the middle of a record
+std::string make_records(int num_records) {
+	std::string text;
+	for(int i = 0; i < num_records; ++i) {
+		text += "let a" + std::to_string(i) + " = (" + std::to_string(i) + " + b * c) ";
+		text += (i % 2 == 0) ? "\n / (c -\n 1)\n" : "/ d\n";
+	}
+	return text;
+}
+
+void compare_chunked(const std::string &text, size_t num_threads, size_t num_chunks, Chunked_parse_stats *stats) {
+
+	Text_memory_stream stream(text);
+	MemoryCharParser chparser(stream);
+	Parse_result res = PTopLevelParser<Lets>::parse(chparser);
+	EXPECT_TRUE(res.success());
+
+	Text_memory_stream chunked_stream(text);
+	Parse_result chunked_res = parse_chunked<Lets>(chunked_stream, "\n", num_threads, num_chunks, stats);
+	EXPECT_TRUE(chunked_res.success());
+
+	Lets::AstType *ast = (Lets::AstType *) res.get_ast();
+	Lets::AstType *chunked_ast = (Lets::AstType *) chunked_res.get_ast();
+	EXPECT_EQ(ast->entry_.size(), chunked_ast->entry_.size());
+	EXPECT_TRUE(res.get_end_pos() == chunked_res.get_end_pos());
+
+	auto pos = ast->entry_.begin();
+	for(auto &entry : chunked_ast->entry_) {
+		EXPECT_TRUE(entry->get_start_pos() == (*pos)->get_start_pos());
+		EXPECT_TRUE(entry->get_end_pos() == (*pos)->get_end_pos());
+		++pos;
+	}
+
+	std::stringstream sout, chunked_sout;
+	Lets::dumpJson(sout, ast);
+	Lets::dumpJson(chunked_sout, chunked_ast);
+	EXPECT_EQ(sout.str(), chunked_sout.str());
+}
+
+TEST(TestMany, testChunked) {
+
+	Chunked_parse_stats stats;
+
+	compare_chunked( make_program(1, 500), 4, 16, &stats );
+	EXPECT_EQ(stats.chunks_, (size_t) 16);
+	EXPECT_EQ(stats.resyncs_, (size_t) 0);
+
+	compare_chunked( make_records(500), 3, 40, &stats );
+	EXPECT_EQ(stats.chunks_, (size_t) 40);
+	EXPECT_TRUE(stats.resyncs_ > 0);
+
+	// more chunks than lines, and a single chunk
+	compare_chunked( make_records(3), 2, 100, &stats );
+	compare_chunked( make_records(10), 1, 1, &stats );
+	EXPECT_EQ(stats.chunks_, (size_t) 1);
+}
+
+TEST(TestMany, testChunkedError) {
+
+	// the repetition ends at the record with the error, as with a sequential parse
+	std::string text = make_program(1, 200) + "let let = 1\n" + make_program(2, 200);
+
+	Text_memory_stream stream(text);
+	MemoryCharParser chparser(stream);
+	Parse_result res = PTopLevelParser<Lets>::parse(chparser);
+
+	Text_memory_stream chunked_stream(text);
+	Parse_result chunked_res = parse_chunked<Lets>(chunked_stream, "\n", 2, 8);
+	EXPECT_TRUE(chunked_res.success());
+
+	EXPECT_EQ(((Lets::AstType *) chunked_res.get_ast())->entry_.size(), (size_t) 200);
+	EXPECT_EQ(((Lets::AstType *) res.get_ast())->entry_.size(), (size_t) 200);
+	EXPECT_TRUE(res.get_end_pos() == chunked_res.get_end_pos());
+}
+
+TEST(TestMany, benchmarkChunked) {
+
+	std::string text = make_program(0, 100000);
+
+	auto start = std::chrono::steady_clock::now();
+	Text_memory_stream stream(text);
+	MemoryCharParser chparser(stream);
+	Parse_result res = PTopLevelParser<Lets>::parse(chparser);
+	EXPECT_TRUE(res.success());
+	auto end = std::chrono::steady_clock::now();
+
+	printf("sequential parse of %ld bytes %.3f s\n", (long) text.size(), std::chrono::duration<double>(end - start).count());
+
+	size_t max_threads = std::max( (size_t) std::thread::hardware_concurrency(), (size_t) 2);
+
+	for(size_t num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+		Chunked_parse_stats stats;
+
+		start = std::chrono::steady_clock::now();
+		Text_memory_stream chunked_stream(text);
+		Parse_result chunked_res = parse_chunked<Lets>(chunked_stream, "\n", num_threads, 0, &stats);
+		EXPECT_TRUE(chunked_res.success());
+		end = std::chrono::steady_clock::now();
+
+		printf("parse_chunked with %ld threads %ld chunks %ld resyncs %.3f s\n", (long) num_threads, (long) stats.chunks_, (long) stats.resyncs_, std::chrono::duration<double>(end - start).count());
+	}
+}
+
+TEST(TestMany, testBoundedQueue) {
+
+	// four producers and four consumers, each value arrives once
+	const size_t num_values = 100000;
+	Bounded_queue<size_t> queue(64);
+	EXPECT_EQ(queue.capacity(), (size_t) 64);
+
+	std::vector< std::atomic<int> > received(num_values);
+	std::atomic<size_t> num_received(0);
+
+	std::vector<std::thread> threads;
+	for(size_t producer = 0; producer < 4; ++producer) {
+		threads.emplace_back( [&, producer]() {
+			for(size_t value = producer; value < num_values; value += 4) {
+				size_t item = value;
+				while(!queue.try_push(item)) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	for(size_t consumer = 0; consumer < 4; ++consumer) {
+		threads.emplace_back( [&]() {
+			size_t item;
+			while(num_received.load() < num_values) {
+				if (queue.try_pop(item)) {
+					received[ item ].fetch_add(1);
+					num_received.fetch_add(1);
+				} else {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	for(auto &thread : threads) {
+		thread.join();
+	}
+
+	for(size_t i = 0; i < num_values; ++i) {
+		EXPECT_EQ(received[i].load(), 1);
+	}
+	EXPECT_EQ(queue.size(), (size_t) 0);
+
+	size_t item = 0;
+	EXPECT_FALSE(queue.try_pop(item));
+}
+
+// the processing of a record: hash the text of the let statement many times over
+size_t process_let(Parse_result &record, int rounds) {
+	Let::AstType *ast = (Let::AstType *) record.get_ast();
+	std::string name( std::get<1>(ast->entry_)->entry_ );
+	size_t hash = 0;
+	for(int i = 0; i < rounds; ++i) {
+		hash = std::hash<std::string>()( name + std::to_string(hash) );
+	}
+	return hash;
+}
+
+TEST(TestMany, testPipeline) {
+
+	std::string text = make_program(1, 2000);
+
+	Text_memory_stream stream(text);
+	MemoryCharParser chparser(stream);
+
+	std::vector< std::atomic<int> > seen(2000);
+	Pipeline_stats stats;
+
+	// a small queue and slow consumers: the parser has to wait
+	Parse_result res = parse_pipeline<Let>(chparser, [&](size_t consumer, Parse_result &record) {
+		EXPECT_TRUE(consumer < 2);
+		Let::AstType *ast = (Let::AstType *) record.get_ast();
+		int index = atoi( std::get<1>(ast->entry_)->entry_.c_str() + 1 );
+		seen[ index ].fetch_add(1);
+		process_let(record, 200);
+	}, 2, 4, &stats);
+
+	EXPECT_TRUE(res.success());
+	for(auto &count : seen) {
+		EXPECT_EQ(count.load(), 1);
+	}
+	EXPECT_EQ(stats.records_, (size_t) 2000);
+	EXPECT_TRUE(stats.max_depth_ <= 4);
+	EXPECT_TRUE(stats.stalls_ > 0);
+
+	// the records before the error are processed, the result is the error
+	std::string failing_text = make_program(1, 100) + "let let = 1\n";
+	Text_memory_stream failing_stream(failing_text);
+	MemoryCharParser failing_parser(failing_stream);
+
+	std::atomic<size_t> processed(0);
+	Parse_result failing_res = parse_pipeline<Let>(failing_parser, [&](size_t, Parse_result &) { processed.fetch_add(1); }, 3, 16, &stats);
+	EXPECT_FALSE(failing_res.success());
+	EXPECT_EQ(processed.load(), (size_t) 100);
+	EXPECT_EQ(stats.records_, (size_t) 100);
+}
+
+TEST(TestMany, benchmarkPipeline) {
+
+	std::string text = make_program(0, 50000);
+	const int rounds = 50;
+
+	// parse and process on one thread
+	auto start = std::chrono::steady_clock::now();
+	size_t serial_hash = 0;
+	{
+		Text_memory_stream stream(text);
+		MemoryCharParser chparser(stream);
+		Parse_result res = PStream<Let>::parse(chparser, [&](Parse_result &record) { serial_hash ^= process_let(record, rounds); });
+		EXPECT_TRUE(res.success());
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	printf("serial parse and process of %ld bytes %.3f s\n", (long) text.size(), std::chrono::duration<double>(end - start).count());
+
+	size_t max_threads = std::max( (size_t) std::thread::hardware_concurrency(), (size_t) 2);
+
+	for(size_t num_consumers = 1; num_consumers < max_threads; num_consumers *= 2) {
+		Pipeline_stats stats;
+		std::atomic<size_t> hash(0);
+
+		Text_memory_stream stream(text);
+		MemoryCharParser chparser(stream);
+		Parse_result res = parse_pipeline<Let>(chparser, [&](size_t, Parse_result &record) { hash.fetch_xor( process_let(record, rounds) ); }, num_consumers, 256, &stats);
+		EXPECT_TRUE(res.success());
+		EXPECT_EQ(hash.load(), serial_hash);
+
+		printf("pipeline with %ld consumers %.3f s, %.0f records/s, queue depth max %ld average %.1f, parser stalled %ld times %.3f s, consumers idle %.3f s\n",
+				(long) num_consumers, stats.total_secs_, stats.records_per_sec_, (long) stats.max_depth_, stats.average_depth_, (long) stats.stalls_, stats.stall_secs_, stats.idle_secs_);
+	}
+}
+
+} // namespace
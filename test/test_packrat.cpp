@@ -0,0 +1,392 @@
+#include "gtest/gtest.h"
+
+//enable execution trace with the next define
+//#define  __PARSER_TRACE__
+#include "parse.h"
+
+#include <string.h>
+#include <chrono>
+#include <sstream>
+
+namespace {
+
+using namespace pparse;
+
+struct Int : PTokInt<1> {};
+
+struct Expr;
+
+struct Mult : PAny<2, PTok<3,CSTR1("*")>, PTok<4,CSTR1("/")> > {};
+
+struct Add : PAny<4, PTok<5,CSTR1("+")>, PTok<6,CSTR1("-")> > {};
+
+struct NestedExpr : PSeq<7, PTok<8, CSTR1("(")>, Expr, PTok<9, CSTR1(")")> > {};
+
+struct NegativeInt : PSeq<10, PTok<11, CSTR1("-")>, Int> {};
+
+struct SimpleExpr : PAny<12, Int, NegativeInt, NestedExpr> {}; //
+
+struct MultExpr;
+
+struct MultExpr: PAny<13, PSeq<14, SimpleExpr, Mult, MultExpr >, SimpleExpr> {};
+
+struct Expr: PAny<15, PSeq<16, MultExpr, Add, Expr >, MultExpr> {};
+
+struct ExprEof : PRequireEof<Expr> {};
+
+// left recursive grammar: the operators are left associative
+struct LeftExpr;
+
+struct LeftSimpleExpr : PAny<20, Int, PSeq<21, PTok<22, CSTR1("(")>, LeftExpr, PTok<23, CSTR1(")")> > > {};
+
+struct LeftMultExpr : PAny<24, PSeq<25, LeftMultExpr, Mult, LeftSimpleExpr>, LeftSimpleExpr> {};
+
+struct LeftExpr : PAny<26, PSeq<27, LeftExpr, Add, LeftMultExpr>, LeftMultExpr> {};
+
+struct LeftExprEof : PRequireEof<LeftExpr> {};
+
+
+template<typename Parser>
+Parse_result test_string(const std::string &test_string, bool use_packrat, size_t *hits = nullptr, size_t *misses = nullptr) {
+	Text_stream text_stream;
+
+	bool isok = text_stream.open(-1);
+	EXPECT_EQ(isok, true);
+
+	isok = text_stream.write_tail(test_string.c_str(), test_string.size() );
+	EXPECT_EQ(isok, true);
+
+	CharParser chparser(text_stream);
+	if (use_packrat) {
+		chparser.init_packrat_memo();
+	}
+
+	Parse_result res = Parser::parse(chparser);
+
+	if (!res.success()) {
+		Line_column error_pos = text_stream.line_column(res.get_start_pos().offset());
+		printf("Error: parser error at: line: %d column: %d text: %s\n", error_pos.line(), error_pos.column(), test_string.c_str());
+	}
+	if (hits != nullptr && use_packrat) {
+		*hits = chparser.packrat_memo_->hits();
+	}
+	if (misses != nullptr && use_packrat) {
+		*misses = chparser.packrat_memo_->misses();
+	}
+
+	return res;
+}
+
+std::string nested_expr(int depth) {
+	std::string ret;
+	for(int i = 0; i < depth; ++i) {
+		ret += "(";
+	}
+	ret += "1";
+	for(int i = 0; i < depth; ++i) {
+		ret += i % 2 == 0 ? ")" : ")*2";
+	}
+	return ret;
+}
+
+TEST(TestPackrat, testSameAst) {
+
+	const char *inputs[] = { "-1", "1 * 3", "2 + 2 + 2 + 1 * 3", "(2*3) + 5", "((1+2)*(3-4))/-5" };
+
+	for(auto input : inputs) {
+
+		Parse_result result = test_string<ExprEof>(input, false);
+		EXPECT_TRUE(result.success());
+
+		size_t hits = 0;
+		Parse_result result_memo = test_string<ExprEof>(input, true, &hits);
+		EXPECT_TRUE(result_memo.success());
+
+		std::stringstream sout, sout_memo;
+		ExprEof::dumpJson(sout, (ExprEof::AstType *) result.get_ast() );
+		ExprEof::dumpJson(sout_memo, (ExprEof::AstType *) result_memo.get_ast() );
+		EXPECT_EQ(sout.str(), sout_memo.str());
+	}
+
+	size_t hits = 0;
+	Parse_result result = test_string<ExprEof>("(2*3) + 5", true, &hits);
+	EXPECT_TRUE(hits > 0);
+}
+
+TEST(TestPackrat, testFailure) {
+
+	Parse_result result = test_string<ExprEof>("(2*3) + ", false);
+	EXPECT_FALSE(result.success());
+
+	Parse_result result_memo = test_string<ExprEof>("(2*3) + ", true);
+	EXPECT_FALSE(result_memo.success());
+	EXPECT_TRUE(result.get_start_pos() == result_memo.get_start_pos());
+}
+
+TEST(TestPackrat, testEvict) {
+	Text_stream text_stream;
+
+	bool isok = text_stream.open(-1);
+	EXPECT_EQ(isok, true);
+
+	const char *input = "(1*2)+3 (4*5)+6";
+	isok = text_stream.write_tail(input, strlen(input));
+	EXPECT_EQ(isok, true);
+
+	CharParser chparser(text_stream);
+	chparser.init_packrat_memo();
+
+	Parse_result result = Expr::parse(chparser);
+	EXPECT_TRUE(result.success());
+	EXPECT_TRUE(chparser.packrat_memo_->window_size() > 0);
+
+	size_t window_size = chparser.packrat_memo_->window_size();
+
+	text_stream.move_on( text_stream.pos_at_cursor() );
+
+	result = Expr::parse(chparser);
+	EXPECT_TRUE(result.success());
+	EXPECT_TRUE(chparser.packrat_memo_->window_size() < 2 * window_size);
+}
+
+TEST(TestPackrat, benchmarkNestedExpr) {
+
+	for(int depth = 2; depth <= 8; depth += 2) {
+		std::string input = nested_expr(depth);
+
+		auto start = std::chrono::steady_clock::now();
+		Parse_result result = test_string<ExprEof>(input, false);
+		auto end = std::chrono::steady_clock::now();
+
+		EXPECT_TRUE(result.success());
+		printf("no memo depth %4d time %10ld us\n", depth, (long) std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+	}
+
+	// the rules are parsed once per offset: the number of rule invocations (memo misses) grows linearly with the depth
+	size_t prev_misses = 0;
+	for(int depth = 100; depth <= 800; depth *= 2) {
+		std::string input = nested_expr(depth);
+
+		size_t misses = 0;
+		auto start = std::chrono::steady_clock::now();
+		Parse_result result = test_string<ExprEof>(input, true, nullptr, &misses);
+		auto end = std::chrono::steady_clock::now();
+
+		EXPECT_TRUE(result.success());
+		if (prev_misses != 0) {
+			EXPECT_TRUE(misses <= prev_misses * 22 / 10);
+		}
+		prev_misses = misses;
+		printf("packrat depth %4d time %10ld us misses %ld\n", depth, (long) std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), (long) misses);
+	}
+}
+
+long eval(const LeftExpr::AstType *ast);
+
+long eval(const LeftSimpleExpr::AstType *ast) {
+	if (ast->entry_.index() == 0) {
+		return atol( std::get<0>(ast->entry_)->entry_.c_str() );
+	}
+	return eval( std::get<1>( std::get<1>(ast->entry_)->entry_ ).get() );
+}
+
+long eval(const LeftMultExpr::AstType *ast) {
+	if (ast->entry_.index() == 1) {
+		return eval( std::get<1>(ast->entry_).get() );
+	}
+	auto &seq = std::get<0>(ast->entry_)->entry_;
+	long lhs = eval( std::get<0>(seq).get() );
+	long rhs = eval( std::get<2>(seq).get() );
+	return std::get<1>(seq)->entry_.index() == 0 ? lhs * rhs : lhs / rhs;
+}
+
+long eval(const LeftExpr::AstType *ast) {
+	if (ast->entry_.index() == 1) {
+		return eval( std::get<1>(ast->entry_).get() );
+	}
+	auto &seq = std::get<0>(ast->entry_)->entry_;
+	long lhs = eval( std::get<0>(seq).get() );
+	long rhs = eval( std::get<2>(seq).get() );
+	return std::get<1>(seq)->entry_.index() == 0 ? lhs + rhs : lhs - rhs;
+}
+
+TEST(TestPackrat, testLeftRecursion) {
+
+	struct Input {
+		const char *text_;
+		long value_;
+	};
+
+	// evaluated left to right: 10 - 2 - 3 is (10 - 2) - 3
+	Input inputs[] = { { "7", 7 }, { "10 - 2 - 3", 5 }, { "100 / 10 / 5", 2 }, { "1 + 2 * 3 - 4", 3 }, { "(1 - 2) * (10 - 4 - 3) / 3 - 1", -2 }, { "2 * (8 - (4 - 1)) - 1 - 1", 8 } };
+
+	for(auto &input : inputs) {
+		Parse_result result = test_string<LeftExprEof>(input.text_, true);
+		EXPECT_TRUE(result.success());
+		if (result.success()) {
+			EXPECT_EQ(eval( (LeftExpr::AstType *) result.get_ast() ), input.value_);
+		}
+	}
+
+	Parse_result result = test_string<LeftExprEof>("1 - (2 * ", true);
+	EXPECT_FALSE(result.success());
+}
+
+TEST(TestPackrat, testRecognizeLeftRecursion) {
+
+	// without AST: a successful memo entry is used again, the seed of the left recursion has no AST
+	const char *inputs[] = { "7", "10 - 2 - 3", "1 + 2 * 3 - 4", "(1 - 2) * (10 - 4 - 3) / 3 - 1", "2 * (8 - (4 - 1)) - 1 - 1" };
+
+	for(const char *input : inputs) {
+		Text_memory_stream stream(input);
+		MemoryCharParser chparser(stream);
+		chparser.init_packrat_memo();
+
+		Parse_result result = recognize<LeftExprEof>(chparser);
+		EXPECT_TRUE(result.success());
+		EXPECT_TRUE(result.get_ast() == nullptr);
+		EXPECT_EQ(result.get_end_pos().offset() + 1, (FilePos_t) strlen(input));
+	}
+
+	Text_memory_stream stream("1 - (2 * ");
+	MemoryCharParser chparser(stream);
+	chparser.init_packrat_memo();
+	EXPECT_FALSE(recognize<LeftExprEof>(chparser).success());
+}
+
+TEST(TestPackrat, testReopenStream) {
+
+	// the parser is used again after the stream has been opened with another text: the entries of the previous text are not used.
+	const char *first = "1 + 2";
+	const char *second = "3 * 4 * 5";
+
+	Text_memory_stream stream(first);
+	MemoryCharParser chparser(stream);
+	chparser.init_packrat_memo();
+
+	Parse_result result = recognize<Expr>(chparser);
+	EXPECT_TRUE(result.success());
+	EXPECT_EQ(result.get_end_pos().offset() + 1, (FilePos_t) strlen(first));
+
+	stream.open(second, strlen(second));
+
+	result = recognize<Expr>(chparser);
+	EXPECT_TRUE(result.success());
+	EXPECT_EQ(result.get_end_pos().offset() + 1, (FilePos_t) strlen(second));
+
+	stream.open("x", 1);
+	EXPECT_FALSE(recognize<Expr>(chparser).success());
+
+	stream.open(first, strlen(first));
+	result = recognize<Expr>(chparser);
+	EXPECT_TRUE(result.success());
+	EXPECT_EQ(result.get_end_pos().offset() + 1, (FilePos_t) strlen(first));
+}
+
+TEST(TestPackrat, testLeftRecursionLongChain) {
+
+	// a long chain of operators is parsed in a loop, the stack depth of the parser doesn't grow with the length of the chain.
+	const int num_terms = 20000;
+	std::string input = "0";
+	long value = 0;
+	for(int i = 1; i < num_terms; ++i) {
+		input += i % 2 == 0 ? " + 3" : " - 1";
+		value += i % 2 == 0 ? 3 : -1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	Parse_result result = test_string<LeftExprEof>(input, true);
+	auto end = std::chrono::steady_clock::now();
+
+	EXPECT_TRUE(result.success());
+	EXPECT_EQ(eval( (LeftExpr::AstType *) result.get_ast() ), value);
+
+	printf("left recursion: %d terms %.3f s\n", num_terms, std::chrono::duration<double>(end - start).count());
+}
+
+TEST(TestPackrat, testLeftRecursionTeardown) {
+
+	// the AST of a chain of a million operators leans to the left, it is freed in a loop (a recursive teardown would overflow the stack).
+	const int num_terms = 1000000;
+	std::string input = "0";
+	for(int i = 1; i < num_terms; ++i) {
+		input += i % 2 == 0 ? "+3" : "-1";
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	Parse_result result = test_string<LeftExprEof>(input, true);
+	auto end = std::chrono::steady_clock::now();
+
+	EXPECT_TRUE(result.success());
+	EXPECT_EQ(result.get_end_pos().offset(), (FilePos_t) input.size() - 1);
+
+	// walk down the left edge of the chain: one PSeq per operator
+	size_t depth = 0;
+	const LeftExpr::AstType *ast = (const LeftExpr::AstType *) result.get_ast();
+	while(ast != nullptr && ast->entry_.index() == 0) {
+		ast = std::get<0>( std::get<0>(ast->entry_)->entry_ ).get();
+		depth += 1;
+	}
+	EXPECT_EQ(depth, (size_t) num_terms - 1);
+
+	result.ast_.reset();
+	auto freed = std::chrono::steady_clock::now();
+
+	printf("left recursion: %d terms parse %.3f s free %.3f s\n", num_terms, std::chrono::duration<double>(end - start).count(),
+			std::chrono::duration<double>(freed - end).count());
+}
+
+// counts the calls of parse, to see how often a rule has been parsed
+template<typename Type>
+struct Counted : Type {
+
+	static inline int calls_ = 0;
+
+	template<typename ParserBase>
+	static Parse_result parse(ParserBase &base) {
+		calls_ += 1;
+		return Type::parse(base);
+	}
+};
+
+struct Name : Counted< PTokIdentifierCStyle<40> > {};
+
+struct Call : PSeq<41, Name, PTok<42, CSTR1("(")>, PTok<43, CSTR1(")")> > {};
+
+struct Assign : PSeq<44, Name, PTok<45, CSTR1("=")>, PTokInt<46> > {};
+
+struct Declare : PSeq<47, Name, PTok<48, CSTR1(";")> > {};
+
+struct Statements : PRequireEof< PStar<49, PAny<50, Call, Assign, Declare> > > {};
+
+TEST(TestPackrat, testSharedPrefix) {
+
+	// the alternatives of the choice all start with Name, it is parsed once per choice, not once per alternative that is tried.
+	Name::calls_ = 0;
+	Parse_result statements = test_string<Statements>("a = 1 b() c; d = 2 e;", false);
+	EXPECT_TRUE(statements.success());
+	EXPECT_EQ(Name::calls_, 5);
+
+	// the leading rule MultExpr of both alternatives of Expr is parsed once: a deeply nested expression parses in linear time, without the memo table.
+	for(int depth = 100; depth <= 800; depth *= 2) {
+		std::string input = nested_expr(depth);
+
+		auto start = std::chrono::steady_clock::now();
+		Parse_result result = test_string<ExprEof>(input, false);
+		auto end = std::chrono::steady_clock::now();
+		EXPECT_TRUE(result.success());
+
+		Parse_result result_memo = test_string<ExprEof>(input, true);
+		EXPECT_TRUE(result_memo.success());
+
+		std::stringstream sout, sout_memo;
+		ExprEof::dumpJson(sout, (ExprEof::AstType *) result.get_ast() );
+		ExprEof::dumpJson(sout_memo, (ExprEof::AstType *) result_memo.get_ast() );
+		EXPECT_EQ(sout.str(), sout_memo.str());
+
+		printf("shared prefix depth %4d time %10ld us\n", depth, (long) std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+	}
+}
+
+} // namespace
+
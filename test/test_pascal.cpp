@@ -6,6 +6,8 @@
 
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sstream>
+#include <chrono>
 
 namespace {
 
@@ -27,7 +29,8 @@ Parse_result test_string(Char_t *test_string) {
 	Parse_result res = Parser::parse(chparser);
 	
 	if (!res.success()) {
-		printf("Error: parser error at: line: %d column: %d text: %s\n", res.get_start_pos().line(), res.get_start_pos().column(), test_string);
+		Line_column error_pos = text_stream.line_column(res.get_start_pos().offset());
+		printf("Error: parser error at: line: %d column: %d text: %s\n", error_pos.line(), error_pos.column(), test_string);
 	}
 
 	return res;
@@ -122,4 +125,75 @@ TEST(TestPascal, test) {
 
 }
 
+
+TEST(TestPascal, benchmarkTokenMode) {
+
+	// type declarations of the pascal grammar, the keyword alternatives of Type are tried before the identifier.
+	struct SimpleType : PAny<1, PascalIdentifier<2>, PSeq<3, PTok<4,CSTR1("(")>, PascalIdentifier<4>, PTok<5, CSTR1(")") > > > {};
+
+	struct PointerType : PSeq<1, PTok<2, CSTR1("^")>, PascalIdentifier<3> > {};
+
+	struct SimpleTypeList : PAny<1, PSeq<1, SimpleType,  PTok<2, CSTR1(",")> , SimpleTypeList >, SimpleType > {};
+
+	struct Type;
+
+	struct ArrayType : PSeq<1, PTok<2, CSTR5("array")>,  PTok<2, CSTR1("[")>, SimpleTypeList, PTok<4,CSTR1("]")>, PTok<5,CSTR2("of")>, Type > {};
+
+	struct FileType : PSeq<1 , PTok<2, CSTR4("file")>, PTok<3, CSTR2("of")>, Type > {};
+
+	struct SetType : PSeq<1 , PTok<2, CSTR3("set")>, PTok<3, CSTR2("of")>, SimpleType > {};
+
+	struct Type : PAny<1, PointerType, ArrayType, FileType, SetType, PascalIdentifier<2> > {};
+
+	struct TypeDecl : PSeq<1, PascalIdentifier<2>, PTok<3, CSTR1("=")>, Type, PTok<4, CSTR1(";")> > {};
+
+	struct TypeDecls : PRequireEof< PStar<1, TypeDecl> > {};
+
+	std::string text;
+	for(int i = 0; i < 20000; ++i) {
+		std::string num = std::to_string(i);
+		switch(i % 4) {
+			case 0: text += "t" + num + " = array [ index" + num + ", (color), arrayof ] of file of set of (bits);\n"; break;
+			case 1: text += "t" + num + " = ^ node" + num + ";\n"; break;
+			case 2: text += "t" + num + " = file of array [ (a), b ] of integer;\n"; break;
+			case 3: text += "t" + num + " = set of settype" + num + ";\n"; break;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	Text_memory_stream char_stream(text);
+	MemoryCharParser char_parser(char_stream);
+	Parse_result char_res = TypeDecls::parse(char_parser);
+	EXPECT_TRUE(char_res.success());
+
+	auto end = std::chrono::steady_clock::now();
+	double char_secs = std::chrono::duration<double>(end - start).count();
+
+	start = std::chrono::steady_clock::now();
+
+	Text_memory_stream token_text(text);
+	Token_stream token_stream;
+	bool isok = token_stream.open<TypeDecls>(token_text);
+	EXPECT_TRUE(isok);
+	EXPECT_EQ(token_stream.scan_error_pos(), -1);
+
+	auto scanned = std::chrono::steady_clock::now();
+
+	Token_parser token_parser(token_stream);
+	Parse_result token_res = TypeDecls::parse(token_parser);
+	EXPECT_TRUE(token_res.success());
+
+	end = std::chrono::steady_clock::now();
+	double token_secs = std::chrono::duration<double>(end - start).count();
+
+	printf("pascal type declarations %ld bytes: characters %.3f s tokens (%ld tokens) %.3f s (scan %.3f s)\n", (long) text.size(), char_secs, (long) token_stream.tokens().size(), token_secs, std::chrono::duration<double>(scanned - start).count());
+
+	std::stringstream char_json, token_json;
+	TypeDecls::dumpJson(char_json, (TypeDecls::AstType *) char_res.get_ast());
+	TypeDecls::dumpJson(token_json, (TypeDecls::AstType *) token_res.get_ast());
+	EXPECT_EQ(char_json.str(), token_json.str());
+	EXPECT_TRUE(char_res.get_end_pos() == token_res.get_end_pos());
+}
+
 }
@@ -0,0 +1,235 @@
+#include "gtest/gtest.h"
+
+//enable execution trace with the next define
+//#define  __PARSER_TRACE__
+#include "parse.h"
+
+#include <string.h>
+#include <sstream>
+#include <chrono>
+
+namespace {
+
+using namespace pparse;
+
+struct Int : PTokInt<1> {};
+
+struct Expr;
+
+struct NestedExpr : PSeq<2, PTok<3, CSTR1("(")>, Expr, PTok<4, CSTR1(")")> > {};
+
+struct Operand : PAny<5, Int, NestedExpr> {};
+
+struct Expr : PPrecedence<6, Operand,
+						Binary_op< PTok<7, CSTR1("+")>, 1>,
+						Binary_op< PTok<8, CSTR1("-")>, 1>,
+						Binary_op< PTok<9, CSTR1("*")>, 2>,
+						Binary_op< PTok<10, CSTR1("/")>, 2>,
+						Binary_op< PTok<11, CSTR1("^")>, 4, Associativity::right>,
+						Prefix_op< PTok<12, CSTR1("-")>, 3> > {};
+
+struct ExprEof : PRequireEof<Expr> {};
+
+// the expression grammar of the README: a rule per precedence level
+struct RMult : PAny<20, PTok<21,CSTR1("*")>, PTok<22,CSTR1("/")> > {};
+
+struct RAdd : PAny<23, PTok<24,CSTR1("+")>, PTok<25,CSTR1("-")> > {};
+
+struct RExpr;
+
+struct RNestedExpr : PSeq<26, PTok<27, CSTR1("(")>, RExpr, PTok<28, CSTR1(")")> > {};
+
+struct RNegativeInt : PSeq<29, PTok<30, CSTR1("-")>, Int> {};
+
+struct RSimpleExpr : PAny<31, Int, RNegativeInt, RNestedExpr> {};
+
+struct RMultExpr: PAny<32, PSeq<33, RSimpleExpr, RMult, RMultExpr >, RSimpleExpr> {};
+
+struct RExpr: PAny<34, PSeq<35, RMultExpr, RAdd, RExpr >, RMultExpr> {};
+
+struct RExprEof : PRequireEof<RExpr> {};
+
+
+long eval(const Expr::AstType *ast);
+
+long eval(const Operand::AstType *ast) {
+	if (ast->entry_.index() == 0) {
+		return atol( std::get<0>(ast->entry_)->entry_.c_str() );
+	}
+	return eval( std::get<1>( std::get<1>(ast->entry_)->entry_ ).get() );
+}
+
+long eval(const Expr::AstType *ast) {
+	if (ast->is_operand()) {
+		return eval( ast->operand_.get() );
+	}
+	long rhs = eval( ast->rhs_.get() );
+	if (ast->lhs_ == nullptr) {
+		return -rhs;
+	}
+	long lhs = eval( ast->lhs_.get() );
+
+	switch(ast->op_) {
+		case 0: return lhs + rhs;
+		case 1: return lhs - rhs;
+		case 2: return lhs * rhs;
+		case 3: return lhs / rhs;
+	}
+	long ret = 1;
+	for(long i = 0; i < rhs; ++i) {
+		ret *= lhs;
+	}
+	return ret;
+}
+
+Parse_result parse_text(const std::string &text, bool require_eof = true) {
+	Text_memory_stream stream(text);
+	MemoryCharParser chparser(stream);
+	return require_eof ? ExprEof::parse(chparser) : Expr::parse(chparser);
+}
+
+TEST(TestPrecedence, testEval) {
+
+	struct Input {
+		const char *text_;
+		long value_;
+	};
+
+	Input inputs[] = {
+		{ "42", 42 },
+		{ "10 - 2 - 3", 5 },
+		{ "100 / 10 / 5", 2 },
+		{ "1 + 2 * 3 - 4", 3 },
+		{ "2 ^ 3 ^ 2", 512 },			// right associative
+		{ "-2 ^ 2", -4 },				// ^ binds stronger than the prefix minus
+		{ "-2 * 3", -6 },
+		{ "- - 3 - -1", 4 },
+		{ "(1 - 2) * (10 - 4 - 3) / 3 - 1", -2 },
+		{ "2 * (8 - (4 - 1)) - 1 - 1", 8 },
+	};
+
+	for(auto &input : inputs) {
+		Parse_result res = parse_text(input.text_);
+		EXPECT_TRUE(res.success());
+		if (res.success()) {
+			EXPECT_EQ(eval( (Expr::AstType *) res.get_ast() ), input.value_);
+			EXPECT_EQ(res.get_end_pos().offset() + 1, (FilePos_t) strlen(input.text_));
+		}
+	}
+}
+
+TEST(TestPrecedence, testAst) {
+
+	Parse_result res = parse_text("1 - 2 * 3");
+	EXPECT_TRUE(res.success());
+
+	// (1 - (2 * 3))
+	Expr::AstType *ast = (Expr::AstType *) res.get_ast();
+	EXPECT_EQ(ast->op_, 1);
+	EXPECT_TRUE(ast->lhs_->is_operand());
+	EXPECT_EQ(ast->rhs_->op_, 2);
+	EXPECT_EQ(ast->rhs_->get_start_pos().offset(), 4);
+	EXPECT_EQ(ast->rhs_->get_end_pos().offset(), 8);
+
+	std::stringstream sout;
+	Expr::dumpJson(sout, ast);
+	EXPECT_TRUE(sout.str().find("\"op\": \"2\"") != std::string::npos);
+}
+
+TEST(TestPrecedence, testIncomplete) {
+
+	// a binary operator without operand is not part of the expression
+	Parse_result res = parse_text("1 + 2 * ", false);
+	EXPECT_TRUE(res.success());
+	EXPECT_EQ(eval( (Expr::AstType *) res.get_ast() ), 3);
+	EXPECT_EQ(res.get_end_pos().offset(), 4);
+
+	res = parse_text("1 + 2 * - ", false);
+	EXPECT_TRUE(res.success());
+	EXPECT_EQ(res.get_end_pos().offset(), 4);
+
+	EXPECT_FALSE(parse_text("1 + 2 * ").success());
+	EXPECT_FALSE(parse_text("- ").success());
+	EXPECT_FALSE(parse_text("* 2").success());
+}
+
+TEST(TestPrecedence, testRecognize) {
+
+	const char *inputs[] = { "42", "2 ^ 3 ^ 2", "- - 3 - -1", "(1 - 2) * (10 - 4 - 3) / 3 - 1", "1 + 2 * ", "1 + 2 * - ", "- ", "* 2" };
+
+	for(const char *input : inputs) {
+		Parse_result res = parse_text(input, false);
+
+		Text_memory_stream stream(input);
+		MemoryCharParser chparser(stream);
+		Parse_result recognized = recognize<Expr>(chparser);
+
+		EXPECT_EQ(recognized.success(), res.success());
+		EXPECT_TRUE(recognized.get_ast() == nullptr);
+		if (res.success()) {
+			EXPECT_EQ(recognized.get_start_pos().offset(), res.get_start_pos().offset());
+			EXPECT_EQ(recognized.get_end_pos().offset(), res.get_end_pos().offset());
+		}
+	}
+}
+
+std::string make_chain(int num_terms) {
+	std::string text = "1";
+	for(int i = 1; i < num_terms; ++i) {
+		text += i % 3 == 0 ? " * 1" : (i % 3 == 1 ? " + (2 - 1)" : " - 1");
+	}
+	return text;
+}
+
+TEST(TestPrecedence, testLongChain) {
+
+	// the stack depth of the parser doesn't grow with the length of the chain
+	const int num_terms = 200000;
+	std::string text = make_chain(num_terms);
+
+	Parse_result res = parse_text(text);
+	EXPECT_TRUE(res.success());
+	EXPECT_EQ(res.get_end_pos().offset() + 1, (FilePos_t) text.size());
+}
+
+TEST(TestPrecedence, benchmarkPrecedence) {
+
+	std::string text;
+	for(int i = 0; i < 5000; ++i) {
+		text += make_chain(20) + (i % 2 == 0 ? " + " : " * ");
+	}
+	text += "1";
+
+	auto start = std::chrono::steady_clock::now();
+	Parse_result res = parse_text(text);
+	auto end = std::chrono::steady_clock::now();
+	EXPECT_TRUE(res.success());
+
+	printf("PPrecedence: %ld bytes %.3f s\n", (long) text.size(), std::chrono::duration<double>(end - start).count());
+	res.ast_.reset();
+
+	// the same text with a rule per precedence level (a shorter chain, the rule per level recurses for each operator)
+	std::string short_text = make_chain(20);
+	for(int i = 0; i < 200; ++i) {
+		short_text += " + " + make_chain(20);
+	}
+
+	start = std::chrono::steady_clock::now();
+	res = parse_text(short_text);
+	end = std::chrono::steady_clock::now();
+	EXPECT_TRUE(res.success());
+	double precedence_time = std::chrono::duration<double>(end - start).count();
+	res.ast_.reset();
+
+	start = std::chrono::steady_clock::now();
+	Text_memory_stream stream(short_text);
+	MemoryCharParser chparser(stream);
+	res = RExprEof::parse(chparser);
+	end = std::chrono::steady_clock::now();
+	EXPECT_TRUE(res.success());
+
+	printf("%ld bytes: PPrecedence %.4f s rule per level %.4f s\n", (long) short_text.size(), precedence_time, std::chrono::duration<double>(end - start).count());
+}
+
+} // namespace
+
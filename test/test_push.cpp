@@ -0,0 +1,198 @@
+#include "gtest/gtest.h"
+
+//enable execution trace with the next define
+//#define  __PARSER_TRACE__
+#include "parse.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sstream>
+
+namespace {
+
+using namespace pparse;
+
+struct Int : PTokInt<1> {};
+
+struct Expr;
+
+struct Mult : PAny<2, PTok<3,CSTR1("*")>, PTok<4,CSTR1("/")> > {};
+
+struct Add : PAny<4, PTok<5,CSTR1("+")>, PTok<6,CSTR1("-")> > {};
+
+struct NestedExpr : PSeq<7, PTok<8, CSTR1("(")>, Expr, PTok<9, CSTR1(")")> > {};
+
+struct NegativeInt : PSeq<10, PTok<11, CSTR1("-")>, Int> {};
+
+struct SimpleExpr : PAny<12, Int, NegativeInt, NestedExpr> {};
+
+struct MultExpr;
+
+struct MultExpr: PAny<13, PSeq<14, SimpleExpr, Mult, MultExpr >, SimpleExpr> {};
+
+struct Expr: PAny<15, PSeq<16, MultExpr, Add, Expr >, MultExpr> {};
+
+struct ExprEof : PRequireEof<Expr> {};
+
+
+std::string parse_all(const char *input) {
+	Text_stream text_stream;
+
+	bool isok = text_stream.open(-1);
+	EXPECT_EQ(isok, true);
+
+	isok = text_stream.write_tail(input, strlen(input));
+	EXPECT_EQ(isok, true);
+
+	CharParser chparser(text_stream);
+	Parse_result res = ExprEof::parse(chparser);
+	EXPECT_TRUE(res.success());
+
+	std::stringstream sout;
+	ExprEof::dumpJson(sout, (ExprEof::AstType *) res.get_ast() );
+	return sout.str();
+}
+
+TEST(TestPush, testWriteTail) {
+
+	const char *input = "((1+2)*(3-4))/-5 + 22 * 7";
+
+	Text_stream text_stream;
+	bool isok = text_stream.open(-1);
+	EXPECT_EQ(isok, true);
+
+	Push_parser<ExprEof> push_parser(text_stream);
+
+	// one character at a time
+	for(const char *pos = input; *pos != '\0'; ++pos) {
+		Push_status status = push_parser.parse();
+		EXPECT_TRUE(status == Push_status::need_more_input);
+
+		isok = text_stream.write_tail(pos, 1);
+		EXPECT_EQ(isok, true);
+	}
+
+	Push_status status = push_parser.parse();
+	EXPECT_TRUE(status == Push_status::need_more_input);
+
+	push_parser.end_of_input();
+	status = push_parser.parse();
+	EXPECT_TRUE(status == Push_status::success);
+
+	std::stringstream sout;
+	ExprEof::dumpJson(sout, (ExprEof::AstType *) push_parser.result().get_ast() );
+	EXPECT_EQ(sout.str(), parse_all(input));
+
+	// parsing is finished, the status doesn't change.
+	EXPECT_TRUE(push_parser.parse() == Push_status::success);
+}
+
+TEST(TestPush, testFailure) {
+
+	Text_stream text_stream;
+	bool isok = text_stream.open(-1);
+	EXPECT_EQ(isok, true);
+
+	Push_parser<ExprEof> push_parser(text_stream);
+
+	EXPECT_TRUE(push_parser.parse() == Push_status::need_more_input);
+
+	isok = text_stream.write_tail("(2*3) + ", 8);
+	EXPECT_EQ(isok, true);
+	EXPECT_TRUE(push_parser.parse() == Push_status::need_more_input);
+
+	isok = text_stream.write_tail(")", 1);
+	EXPECT_EQ(isok, true);
+	EXPECT_TRUE(push_parser.parse() == Push_status::failure);
+}
+
+TEST(TestPush, testSuspendedDestroy) {
+
+	Text_stream text_stream;
+	bool isok = text_stream.open(-1);
+	EXPECT_EQ(isok, true);
+
+	{
+		Push_parser<ExprEof> push_parser(text_stream);
+
+		isok = text_stream.write_tail("(1 + (2 * ", 10);
+		EXPECT_EQ(isok, true);
+		EXPECT_TRUE(push_parser.parse() == Push_status::need_more_input);
+	}
+}
+
+TEST(TestPush, testDeepNesting) {
+
+	// the parser needs a couple of kilobytes of its stack per level of nesting
+	const int depth = 1000;
+	std::string input = std::string(depth, '(') + "1" + std::string(depth, ')') + " + 2";
+
+	Text_stream text_stream;
+	bool isok = text_stream.open(-1);
+	EXPECT_EQ(isok, true);
+
+	Push_parser<ExprEof> push_parser(text_stream);
+	EXPECT_TRUE(push_parser.parse() == Push_status::need_more_input);
+
+	for(size_t pos = 0; pos < input.size(); pos += 100) {
+		size_t len = std::min( (size_t) 100, input.size() - pos );
+		isok = text_stream.write_tail(input.c_str() + pos, len);
+		EXPECT_EQ(isok, true);
+		EXPECT_TRUE(push_parser.parse() == Push_status::need_more_input);
+	}
+
+	push_parser.end_of_input();
+	EXPECT_TRUE(push_parser.parse() == Push_status::success);
+
+	// with a small stack the parser runs into the guard page below its stack, and crashes (instead of overwriting the heap)
+	EXPECT_DEATH({
+		Text_stream small_stream;
+		small_stream.open(-1);
+		small_stream.write_tail(input.c_str(), input.size());
+
+		Push_parser<ExprEof> small_parser(small_stream, 64 * 1024);
+		small_parser.end_of_input();
+		small_parser.parse();
+	}, "");
+}
+
+TEST(TestPush, testNonBlockingPipe) {
+
+	const char *input = "(1*2)+3 * (4*5)-6";
+
+	int fds[2];
+	int rt = pipe(fds);
+	EXPECT_EQ(rt, 0);
+	rt = fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	EXPECT_EQ(rt, 0);
+
+	Text_stream text_stream;
+	bool isok = text_stream.open(fds[0]);
+	EXPECT_EQ(isok, true);
+
+	Push_parser<ExprEof> push_parser(text_stream);
+
+	Push_status status = Push_status::need_more_input;
+	for(size_t pos = 0; pos < strlen(input); pos += 3) {
+		status = push_parser.parse();
+		EXPECT_TRUE(status == Push_status::need_more_input);
+
+		ssize_t written = write(fds[1], input + pos, std::min((size_t) 3, strlen(input + pos)));
+		EXPECT_TRUE(written > 0);
+	}
+
+	// end of input is reached, when the write end of the pipe is closed.
+	close(fds[1]);
+	status = push_parser.parse();
+	EXPECT_TRUE(status == Push_status::success);
+
+	std::stringstream sout;
+	ExprEof::dumpJson(sout, (ExprEof::AstType *) push_parser.result().get_ast() );
+	EXPECT_EQ(sout.str(), parse_all(input));
+
+	// the reads of the empty pipe have left EAGAIN in errno
+	errno = 0;
+}
+
+} // namespace
+
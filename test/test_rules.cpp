@@ -7,6 +7,12 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <string.h>
+#include <sstream>
+#include <chrono>
+#include <list>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 
 
@@ -31,7 +37,8 @@ Parse_result test_string(Char_t *test_string) {
 	Parse_result res = Parser::parse(chparser);
 	
 	if (!res.success()) {
-		printf("Error: parser error at: line: %d column: %d text: %s\n", res.get_start_pos().line(), res.get_start_pos().column(), test_string);
+		Line_column error_pos = text_stream.line_column(res.get_start_pos().offset());
+		printf("Error: parser error at: line: %d column: %d text: %s\n", error_pos.line(), error_pos.column(), test_string);
 	}
 
 	return res;
@@ -47,8 +54,8 @@ TEST(TestRules,testIntParser) {
 
 	//printf("resul pos: start(line: %d col: %d) end(line: %d col: %d)\n", result.start_.line_, result.start_.column_, result.end_.line_, result.end_.column_ );
 	
-	EXPECT_TRUE(result.start_ == Position(1,2));
-	EXPECT_TRUE(result.end_ ==  Position(1,6));
+	EXPECT_TRUE(result.start_.offset() == 2);
+	EXPECT_TRUE(result.end_.offset() == 6);
 	EXPECT_TRUE(result.get_ast()->getRuleId() ==  1);
 
 	TokenIntParser::AstType *type = (TokenIntParser::AstType *) result.get_ast();
@@ -66,8 +73,8 @@ TEST(TestRules,testIntParser) {
 
 	//printf("resul pos: start(line: %d col: %d) end(line: %d col: %d)\n", result.start_.line_, result.start_.column_, result.end_.line_, result.end_.column_ );
 	
-	EXPECT_TRUE(result.start_ == Position(1,2));
-	EXPECT_TRUE(result.end_ ==  Position(1,6));
+	EXPECT_TRUE(result.start_.offset() == 2);
+	EXPECT_TRUE(result.end_.offset() == 6);
 	EXPECT_TRUE(result.get_ast()->getRuleId() ==  1);
 
 	type = (TokenIntParser::AstType *) result.get_ast();
@@ -91,8 +98,8 @@ TEST(TestRules,testAnyCharParser) {
 
 	//printf("resul pos: start(line: %d col: %d) end(line: %d col: %d)\n", result.start_.line_, result.start_.column_, result.end_.line_, result.end_.column_ );
 	
-	EXPECT_TRUE(result.start_ == Position(1,2));
-	EXPECT_TRUE(result.end_ ==  Position(1,2));
+	EXPECT_TRUE(result.start_.offset() == 2);
+	EXPECT_TRUE(result.end_.offset() == 2);
 	EXPECT_TRUE(result.get_ast()->getRuleId() ==  1);
 	
 
@@ -123,8 +130,10 @@ TEST(TestRules,testTokenParser) {
 
 	//printf("resul pos: start(line: %d col: %d) end(line: %d col: %d)\n", result.start_.line_, result.start_.column_, result.end_.line_, result.end_.column_ );
 	
-	EXPECT_TRUE(result.start_ == Position(1,2));
-	EXPECT_TRUE(result.end_ ==  Position(1,3));
+	EXPECT_TRUE(result.start_.offset() == 2);
+	EXPECT_TRUE(result.end_.offset() == 3);
+	EXPECT_TRUE(text_stream.line_column(result.start_.offset()) == Line_column(1,2));
+	EXPECT_TRUE(text_stream.line_column(result.end_.offset()) == Line_column(1,3));
 }
 
 TEST(TestRules,testAnyParser) {
@@ -296,6 +305,568 @@ TEST(TestRules,testWithAndParser) {
 }
 
 
+TEST(TestRules,testPredicateParser) {
 
+	struct Ident : PTokIdentifierCStyle<1> {};
+	struct TokenElseParser : PTok<2, CSTR4("else")> {};
+
+	// an identifier that is not the keyword, followed by an equal sign. the predicates don't consume input.
+	struct Target : PSeq<3, PNotPredicate<TokenElseParser>, Ident, PAndPredicate<PTok<4, CSTR1("=")> > > {};
+
+	auto result = test_string<Target>((Char_t *) "a = 1");
+	EXPECT_TRUE(result.success());
+	EXPECT_EQ(result.get_end_pos().offset(), 1);
+
+	Target::AstType *seqAst = (Target::AstType *) result.get_ast();
+	EXPECT_TRUE(seqAst != nullptr);
+	EXPECT_EQ(std::get<1>(seqAst->entry_)->ruleId_, 1);
+	EXPECT_EQ(std::get<0>(seqAst->entry_)->get_start_pos().offset(), 0);
+	EXPECT_EQ(std::get<2>(seqAst->entry_)->get_start_pos().offset(), 1);
+
+	Text_memory_stream else_stream("else = 1");
+	MemoryCharParser else_parser(else_stream);
+	EXPECT_FALSE(Target::parse(else_parser).success());
+
+	Text_memory_stream colon_stream("a : int");
+	MemoryCharParser colon_parser(colon_stream);
+	EXPECT_FALSE(Target::parse(colon_parser).success());
+
+	// the same in recognize mode
+	Text_memory_stream recognize_stream("a = 1");
+	MemoryCharParser recognize_parser(recognize_stream);
+	result = recognize<Target>(recognize_parser);
+	EXPECT_TRUE(result.success());
+	EXPECT_TRUE(result.get_ast() == nullptr);
+	EXPECT_EQ(result.get_end_pos().offset(), 1);
+
+	Text_memory_stream recognize_else_stream("else = 1");
+	MemoryCharParser recognize_else_parser(recognize_else_stream);
+	EXPECT_FALSE(recognize<Target>(recognize_else_parser).success());
+}
+
+TEST(TestRules,testCutParser) {
+
+	struct Ident : PTokIdentifierCStyle<1> {};
+	struct Assign : PSeq<2, Ident, PTok<3, CSTR1("=")>, PCut, PTokInt<4>, PTok<5, CSTR1(";")> > {};
+	struct Decl : PSeq<6, Ident, PTok<7, CSTR1(":")>, Ident, PTok<8, CSTR1(";")> > {};
+	struct Stmt : PAny<9, Assign, Decl> {};
+	struct Stmts : PStar<10, Stmt> {};
+
+	auto result = test_string<Stmts>((Char_t *) "a = 1; b : int; c = 22;" );
+	EXPECT_TRUE(result.success());
+	EXPECT_EQ( ((Stmts::AstType *) result.get_ast())->entry_.size(), (size_t) 3);
+
+	// fails before the cut: the repetition ends
+	result = test_string<Stmts>((Char_t *) "a = 1; b ; c = 2;" );
+	EXPECT_TRUE(result.success());
+	EXPECT_EQ( ((Stmts::AstType *) result.get_ast())->entry_.size(), (size_t) 1);
+
+	// fails after the cut: the enclosing rules fail, the next alternative is not tried.
+	result = test_string<Stmts>((Char_t *) "a = 1; b = x; c = 2;" );
+	EXPECT_FALSE(result.success());
+}
+
+TEST(TestRules,testCutBoundedBuffer) {
+
+	struct Ident : PTokIdentifierCStyle<1> {};
+	struct Assign : PSeq<2, Ident, PTok<3, CSTR1("=")>, PCut, PTokInt<4>, PTok<5, CSTR1(";")> > {};
+	struct Stmts : PStar<6, Assign> {};
+
+	struct AssignNoCut : PSeq<2, Ident, PTok<3, CSTR1("=")>, PTokInt<4>, PTok<5, CSTR1(";")> > {};
+	struct StmtsNoCut : PStar<6, AssignNoCut> {};
+
+	char fname[] = "/tmp/test_cutXXXXXX";
+	int fd = mkstemp(fname);
+	EXPECT_TRUE(fd != -1);
+
+	const int num_records = 100000;
+	std::string text;
+	for(int i = 0; i < num_records; ++i) {
+		text += "value" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+	}
+	ssize_t written = write(fd, text.c_str(), text.size());
+	EXPECT_EQ(written, (ssize_t) text.size());
+	close(fd);
+
+	for(int with_cut = 0; with_cut < 2; ++with_cut) {
+
+		// the lookahead buffer doesn't grow
+		Text_stream text_stream(false);
+		bool isok = text_stream.open(fname, 4096);
+		EXPECT_EQ(isok, true);
+
+		CharParser chparser(text_stream);
+
+		if (with_cut) {
+			auto result = Stmts::parse( chparser );
+			EXPECT_TRUE(result.success());
+			EXPECT_EQ( ((Stmts::AstType *) result.get_ast())->entry_.size(), (size_t) num_records);
+		} else {
+			auto result = StmtsNoCut::parse( chparser );
+			EXPECT_TRUE( ((StmtsNoCut::AstType *) result.get_ast())->entry_.size() < (size_t) num_records);
+		}
+	}
+
+	unlink(fname);
+}
+
+
+TEST(TestRules,testWhitespaceRun) {
+
+	std::string text;
+	const char chars[] = " \t\n\v\f\rab\x80\x08\x0e";
+	for(int i = 0; i < 4096; ++i) {
+		text += chars[ (i * 7 + i / 13) % (sizeof(chars) - 1) ];
+	}
+
+	for(size_t start = 0; start < 256; ++start) {
+		size_t expected = start;
+		while(expected < text.size() && isspace((unsigned char) text[expected])) {
+			++expected;
+		}
+		EXPECT_EQ(start + whitespace_run(text.data() + start, text.size() - start), expected);
+	}
+
+	std::string spaces(100, ' ');
+	EXPECT_EQ(whitespace_run(spaces.data(), spaces.size()), (size_t) 100);
+}
+
+TEST(TestRules,testCommentSkipper) {
+
+	struct Ident : PTokIdentifierCStyle<1> {};
+	struct Assign : PSeq<2, Ident, PTok<3, CSTR1("=")>, PTokInt<4>, PTok<5, CSTR1(";")> > {};
+	struct Stmts : PRequireEof<PStar<6, Assign>> {};
+
+	using CommentParser = CharStreamParser<Text_memory_stream, Skip_whitespace_and_comments<C_comments>>;
+
+	const char *with_comments = "// first line\n a = 1; /* block\n comment */ b /**/ = // line comment\n 2 ; // last line";
+	const char *without_comments = "a = 1; b = 2;";
+
+	Text_memory_stream stream(with_comments);
+	CommentParser parser(stream);
+	Parse_result res = Stmts::parse(parser);
+	EXPECT_TRUE(res.success());
+
+	Text_memory_stream plain_stream(without_comments);
+	MemoryCharParser plain_parser(plain_stream);
+	Parse_result plain_res = Stmts::parse(plain_parser);
+	EXPECT_TRUE(plain_res.success());
+
+	std::stringstream sout, plain_sout;
+	Stmts::dumpJson(sout, (Stmts::AstType *) res.get_ast());
+	Stmts::dumpJson(plain_sout, (Stmts::AstType *) plain_res.get_ast());
+	EXPECT_EQ(sout.str(), plain_sout.str());
+
+	// the default skipper doesn't skip comments
+	Text_memory_stream ws_stream(with_comments);
+	MemoryCharParser ws_parser(ws_stream);
+	EXPECT_FALSE(Stmts::parse(ws_parser).success());
+
+	// a block comment that is not terminated is not skipped
+	Text_memory_stream open_stream("a = 1; /* b = 2;");
+	CommentParser open_parser(open_stream);
+	EXPECT_FALSE(Stmts::parse(open_parser).success());
+
+	// a comment that crosses the pages of a paged stream
+	Text_page_pool pool(16);
+	Text_paged_stream paged_stream(&pool);
+	paged_stream.open(-1);
+	paged_stream.write_tail(with_comments, strlen(with_comments));
+
+	CharStreamParser<Text_paged_stream, Skip_whitespace_and_comments<C_comments>> paged_parser(paged_stream);
+	Parse_result paged_res = Stmts::parse(paged_parser);
+	EXPECT_TRUE(paged_res.success());
+}
+
+TEST(TestRules,benchmarkCommentSkipper) {
+
+	struct Ident : PTokIdentifierCStyle<1> {};
+	struct Assign : PSeq<2, Ident, PTok<3, CSTR1("=")>, PTokInt<4>, PTok<5, CSTR1(";")> > {};
+	struct Stmts : PStar<6, Assign> {};
+
+	const int num_records = 100000;
+	std::string text;
+	for(int i = 0; i < num_records; ++i) {
+		text += "        /* value number " + std::to_string(i) + " */\n        value" + std::to_string(i) + " = " + std::to_string(i) + "; // comment\n\n";
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	Text_memory_stream stream(text);
+	CharStreamParser<Text_memory_stream, Skip_whitespace_and_comments<C_comments>> parser(stream);
+	Parse_result res = Stmts::parse(parser);
+	EXPECT_EQ( ((Stmts::AstType *) res.get_ast())->entry_.size(), (size_t) num_records);
+
+	auto end = std::chrono::steady_clock::now();
+	printf("comment skipper: %ld bytes %.3f s\n", (long) text.size(), std::chrono::duration<double>(end - start).count());
+}
+
+
+TEST(TestRules,testTokenMode) {
+
+	struct Ident : PTokIdentifierCStyle<1> {};
+	struct Less : PTok<2, CSTR1("<")> {};
+	struct LessEq : PTok<3, CSTR2("<=")> {};
+	struct Compare : PSeq<4, Ident, PAny<5, Less, LessEq>, PTokInt<6> > {};
+	struct While : PSeq<7, PTok<8, CSTR5("while")>, Compare, PTok<9, CSTR2("do")>, Ident > {};
+	struct Stmts : PRequireEof<PStar<10, PAny<11, While, Compare> > > {};
+
+	const char *input = "while a <= 10 do b  whilex < 2 /* comment */ c<=3";
+
+	Text_memory_stream text(input);
+	Token_stream tokens;
+	EXPECT_TRUE(( tokens.open<Stmts, Skip_whitespace_and_comments<C_comments>>(text) ));
+	EXPECT_EQ(tokens.scan_error_pos(), -1);
+
+	// while is a keyword, whilex is an identifier, <= is one token.
+	std::vector<std::string> expected{ "while", "a", "<=", "10", "do", "b", "whilex", "<", "2", "c", "<=", "3" };
+	EXPECT_EQ(tokens.tokens().size(), expected.size());
+	for(size_t i = 0; i < expected.size() && i < tokens.tokens().size(); ++i) {
+		EXPECT_EQ(tokens.token_text( tokens.tokens()[i] ), expected[i]);
+	}
+
+	Token_parser parser(tokens);
+	Parse_result res = Stmts::parse(parser);
+	EXPECT_TRUE(res.success());
+
+	Stmts::AstType *ast = (Stmts::AstType *) res.get_ast();
+	EXPECT_EQ(ast->entry_.size(), (size_t) 3);
+
+	// positions are offsets in the text
+	EXPECT_EQ(res.get_end_pos().offset(), (FilePos_t) strlen(input));
+
+	// text that isn't a token: the parser fails at the position of the error
+	Text_memory_stream error_text("a < 1 c ? 2");
+	Token_stream error_tokens;
+	EXPECT_FALSE(error_tokens.open<Stmts>(error_text));
+	EXPECT_EQ(error_tokens.scan_error_pos(), 8);
+
+	Token_parser error_parser(error_tokens);
+	EXPECT_FALSE(Stmts::parse(error_parser).success());
+}
+
+
+// counts the calls of parse, to see which alternatives have been tried
+template<typename Type>
+struct Counted : Type {
+
+	static inline int calls_ = 0;
+
+	template<typename ParserBase>
+	static Parse_result parse(ParserBase &base) {
+		calls_ += 1;
+		return Type::parse(base);
+	}
+};
+
+// a run of digits, that may be empty
+static Char_checker_result optional_digits(Char_t current_char, bool iseof, std::string &matched_so_far) {
+	return !iseof && isdigit(current_char) ? Char_checker_result::proceed : Char_checker_result::acceptUnget;
+}
+
+TEST(TestRules,testFirstSetDispatch) {
+
+	struct Ident : PTokIdentifierCStyle<1> {};
+	struct Pointer : PSeq<2, PTok<3, CSTR1("^")>, Ident> {};
+	struct Array : PSeq<4, PTok<5, CSTR5("array")>, PTok<6, CSTR1("[")>, PTokInt<7>, PTok<8, CSTR1("]")>, PTok<9, CSTR2("of")>, Ident> {};
+	struct Set : PSeq<10, PTok<11, CSTR3("set")>, PTok<12, CSTR2("of")>, Ident> {};
+	struct Empty : PSeq<13, POpt<14, PTok<15, CSTR1("-")> >, PTok<16, CSTR1(";")> > {};
+	struct Type : PAny<17, Counted<Pointer>, Counted<Array>, Counted<Set>, Counted<Empty>, Counted<Ident> > {};
+
+	First_set_path path;
+	First_set first = first_set_of<Type>(path);
+	EXPECT_TRUE(first.has('^') && first.has('a') && first.has('Z') && first.has(';') && first.has('-'));
+	EXPECT_FALSE(first.has('1') || first.has('[') || first.has(' '));
+	EXPECT_FALSE(first.nullable_);
+
+	First_set opt_first = first_set_of< POpt<18, Pointer> >(path);
+	EXPECT_TRUE(opt_first.has('^') && opt_first.nullable_);
+
+	// a rule that isn't known may start with anything
+	First_set user_first = first_set_of< POnPreconditionFails<Ident, Pointer> >(path);
+	EXPECT_TRUE(user_first.has('1') && user_first.nullable_);
+
+	struct Input {
+		const char *text_;
+		size_t alternative_;
+		int tried_;	// number of alternatives that have been tried
+	};
+
+	// only the alternatives that can start with the first character are tried: array is tried before the identifier abc, but not before foo.
+	std::vector<Input> inputs{ { "  ^ foo", 0, 1 }, { "array [ 10 ] of foo", 1, 1 }, { "set of foo", 2, 1 }, { " - ;", 3, 1 }, { ";", 3, 1 }, { "abc", 4, 2 }, { "foo", 4, 1 } };
+
+	for(auto &input : inputs) {
+		Counted<Pointer>::calls_ = Counted<Array>::calls_ = Counted<Set>::calls_ = Counted<Empty>::calls_ = Counted<Ident>::calls_ = 0;
+
+		Parse_result res = test_string<Type>( (Char_t *) input.text_ );
+		EXPECT_TRUE(res.success());
+		EXPECT_EQ(((Type::AstType *) res.get_ast())->entry_.index(), input.alternative_);
+
+		int tried = Counted<Pointer>::calls_ + Counted<Array>::calls_ + Counted<Set>::calls_ + Counted<Empty>::calls_ + Counted<Ident>::calls_;
+		EXPECT_EQ(tried, input.tried_);
+	}
+
+	// no alternative can start with a digit: the error is at the digit.
+	Parse_result res = test_string<Type>( (Char_t *) "  12" );
+	EXPECT_FALSE(res.success());
+	EXPECT_EQ(res.get_start_pos().offset(), 2);
+
+	// a token that can be empty is tried at the end of the input
+	struct Digits : PTokVar<19, optional_digits, PTokVarCanAcceptEmptyInput> {};
+	struct Count : PAny<20, PTok<21, CSTR1("*")>, Digits> {};
+
+	First_set digits_first = first_set_of<Digits>(path);
+	EXPECT_TRUE(digits_first.has('1') && digits_first.nullable_);
+
+	for(const char *text : { "12", "  ", "" }) {
+		Text_memory_stream stream(text);
+		MemoryCharParser parser(stream);
+
+		res = Count::parse(parser);
+		EXPECT_TRUE(res.success());
+		EXPECT_EQ(((Count::AstType *) res.get_ast())->entry_.index(), (size_t) 1);
+	}
+}
+
+TEST(TestRules,testSmallVector) {
+
+	Small_vector<std::unique_ptr<int>, 4> vec;
+	for(int i = 0; i < 4; ++i) {
+		vec.push_back( std::make_unique<int>(i) );
+	}
+	EXPECT_TRUE(vec.is_inline());
+
+	vec.push_back( std::make_unique<int>(4) );
+	EXPECT_FALSE(vec.is_inline());
+	EXPECT_EQ(vec.size(), (size_t) 5);
+
+	Small_vector<std::unique_ptr<int>, 4> other;
+	other.emplace_back( new int(5) );
+	vec.append( std::move(other) );
+	EXPECT_TRUE(other.empty());
+
+	Small_vector<std::unique_ptr<int>, 4> moved( std::move(vec) );
+	EXPECT_TRUE(vec.empty());
+
+	int expected = 0;
+	for(auto &entry : moved) {
+		EXPECT_EQ(*entry, expected++);
+	}
+	EXPECT_EQ(expected, 6);
+
+	Small_vector<std::unique_ptr<int>, 4> small;
+	small.push_back( std::make_unique<int>(7) );
+	moved = std::move(small);
+	EXPECT_EQ(moved.size(), (size_t) 1);
+	EXPECT_EQ(*moved[0], 7);
+}
+
+size_t heap_in_use() {
+#ifdef __GLIBC__
+	return mallinfo2().uordblks;
+#else
+	return 0;
+#endif
 }
 
+TEST(TestRules,benchmarkRepeatStorage) {
+
+	struct Ident : PTokIdentifierCStyle<1> {};
+	struct Assign : PSeq<2, Ident, PTok<3, CSTR1("=")>, PTokInt<4>, PTok<5, CSTR1(";")> > {};
+	struct Stmts : PStar<6, Assign> {};
+
+	const int num_records = 500000;
+	std::string text;
+	for(int i = 0; i < num_records; ++i) {
+		text += "a" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+	}
+
+	Text_memory_stream stream(text);
+	MemoryCharParser parser(stream);
+	Parse_result res = Stmts::parse(parser);
+	Stmts::AstType *ast = (Stmts::AstType *) res.get_ast();
+	EXPECT_EQ(ast->entry_.size(), (size_t) num_records);
+
+	// the same elements in a std::list (the storage of the elements before)
+	Parse_result list_res = Stmts::parse( *std::make_unique<MemoryCharParser>( *std::make_unique<Text_memory_stream>(text) ) );
+	std::list<Stmts::AstTypeEntry> list;
+	for(auto &entry : ((Stmts::AstType *) list_res.get_ast())->entry_) {
+		list.push_back( std::move(entry) );
+	}
+
+	auto traverse = [](auto &entries) {
+		FilePos_t sum = 0;
+		for(auto &entry : entries) {
+			sum += entry->get_end_pos().offset();
+		}
+		return sum;
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	FilePos_t sum = traverse(ast->entry_);
+	auto end = std::chrono::steady_clock::now();
+	double vector_traverse = std::chrono::duration<double>(end - start).count();
+
+	start = std::chrono::steady_clock::now();
+	FilePos_t list_sum = traverse(list);
+	end = std::chrono::steady_clock::now();
+	double list_traverse = std::chrono::duration<double>(end - start).count();
+	EXPECT_EQ(sum, list_sum);
+
+	start = std::chrono::steady_clock::now();
+	list.clear();
+	end = std::chrono::steady_clock::now();
+	double list_teardown = std::chrono::duration<double>(end - start).count();
+
+	start = std::chrono::steady_clock::now();
+	res.ast_.reset();
+	end = std::chrono::steady_clock::now();
+	double vector_teardown = std::chrono::duration<double>(end - start).count();
+
+	// (freeing the element ASTs dominates the teardown, it depends on the order of the blocks in the heap more than on the container)
+	printf("repeat of %d elements: traverse vector %.4f s list %.4f s, teardown with elements vector %.4f s list %.4f s\n", num_records, vector_traverse, list_traverse, vector_teardown, list_teardown);
+
+	// memory and teardown of the containers (without the elements)
+	size_t before = heap_in_use();
+
+	auto vec = std::make_unique< Small_vector<Stmts::AstTypeEntry, 4> >();
+	for(int i = 0; i < num_records; ++i) {
+		vec->push_back( nullptr );
+	}
+	size_t vector_bytes = heap_in_use() - before;
+
+	auto nodes = std::make_unique< std::list<Stmts::AstTypeEntry> >();
+	for(int i = 0; i < num_records; ++i) {
+		nodes->push_back( nullptr );
+	}
+	size_t list_bytes = heap_in_use() - before - vector_bytes;
+
+	start = std::chrono::steady_clock::now();
+	vec.reset();
+	end = std::chrono::steady_clock::now();
+	vector_teardown = std::chrono::duration<double>(end - start).count();
+
+	start = std::chrono::steady_clock::now();
+	nodes.reset();
+	end = std::chrono::steady_clock::now();
+	list_teardown = std::chrono::duration<double>(end - start).count();
+
+	printf("container: bytes per element vector %.1f list %.1f, teardown vector %.4f s list %.4f s\n", (double) vector_bytes / num_records, (double) list_bytes / num_records, vector_teardown, list_teardown);
+}
+
+
+// memory resource that counts the bytes that are allocated from the upstream resource
+struct Counting_resource : std::pmr::memory_resource {
+
+	Counting_resource(std::pmr::memory_resource *upstream = std::pmr::new_delete_resource()) : upstream_(upstream) {
+	}
+
+	void *do_allocate(size_t bytes, size_t alignment) override {
+		allocated_ += bytes;
+		allocations_ += 1;
+		return upstream_->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void *ptr, size_t bytes, size_t alignment) override {
+		deallocated_ += bytes;
+		upstream_->deallocate(ptr, bytes, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &arg) const noexcept override {
+		return this == &arg;
+	}
+
+	std::pmr::memory_resource *upstream_;
+	size_t allocated_ = 0;
+	size_t deallocated_ = 0;
+	size_t allocations_ = 0;
+};
+
+TEST(TestRules,testMemoryResource) {
+
+	struct Ident : PTokIdentifierCStyle<1> {};
+	struct Assign : PSeq<2, Ident, PTok<3, CSTR1("=")>, PTokInt<4>, PTok<5, CSTR1(";")> > {};
+	struct Stmts : PStar<6, Assign> {};
+
+	std::string text;
+	for(int i = 0; i < 100; ++i) {
+		text += "a_rather_long_identifier_" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+	}
+
+	// all nodes, token strings and the element array of the repetition come from the resource of the parser, and are returned to it.
+	Counting_resource counting;
+	{
+		Text_memory_stream stream(text);
+		MemoryCharParser parser(stream);
+		parser.set_memory_resource(&counting);
+
+		Parse_result res = Stmts::parse(parser);
+		EXPECT_TRUE(res.success());
+
+		Stmts::AstType *ast = (Stmts::AstType *) res.get_ast();
+		EXPECT_EQ(ast->entry_.size(), (size_t) 100);
+		EXPECT_EQ(ast->entry_.resource(), &counting);
+		EXPECT_EQ(std::get<0>( ast->entry_[7]->entry_ )->entry_, "a_rather_long_identifier_7");
+		EXPECT_EQ(std::get<0>( ast->entry_[7]->entry_ )->entry_.get_allocator().resource(), &counting);
+
+		EXPECT_TRUE(counting.allocations_ > 100 * 5);
+	}
+	EXPECT_EQ(counting.allocated_, counting.deallocated_);
+
+	// a monotonic buffer for the whole parse: the AST is dropped without running the destructors, the memory is released at once.
+	Counting_resource upstream;
+	{
+		std::pmr::monotonic_buffer_resource arena(&upstream);
+
+		Text_memory_stream stream(text);
+		MemoryCharParser parser(stream);
+		parser.set_memory_resource(&arena);
+
+		Parse_result res = Stmts::parse(parser);
+		EXPECT_TRUE(res.success());
+		EXPECT_TRUE(upstream.allocations_ < 20);
+
+		res.ast_.release();
+	}
+	EXPECT_EQ(upstream.allocated_, upstream.deallocated_);
+}
+
+TEST(TestRules,benchmarkMemoryResource) {
+
+	struct Ident : PTokIdentifierCStyle<1> {};
+	struct Assign : PSeq<2, Ident, PTok<3, CSTR1("=")>, PTokInt<4>, PTok<5, CSTR1(";")> > {};
+	struct Stmts : PStar<6, Assign> {};
+
+	const int num_records = 300000;
+	std::string text;
+	for(int i = 0; i < num_records; ++i) {
+		text += "a_rather_long_identifier_" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	{
+		Text_memory_stream stream(text);
+		MemoryCharParser parser(stream);
+		Parse_result res = Stmts::parse(parser);
+		EXPECT_TRUE(res.success());
+	}
+	auto end = std::chrono::steady_clock::now();
+	double heap_time = std::chrono::duration<double>(end - start).count();
+
+	start = std::chrono::steady_clock::now();
+	{
+		std::pmr::monotonic_buffer_resource arena;
+		Text_memory_stream stream(text);
+		MemoryCharParser parser(stream);
+		parser.set_memory_resource(&arena);
+		Parse_result res = Stmts::parse(parser);
+		EXPECT_TRUE(res.success());
+		res.ast_.release();
+	}
+	end = std::chrono::steady_clock::now();
+	double arena_time = std::chrono::duration<double>(end - start).count();
+
+	printf("parse and free %d statements: heap %.4f s monotonic buffer %.4f s\n", num_records, heap_time, arena_time);
+}
+
+}
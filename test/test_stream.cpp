@@ -7,6 +7,10 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <string.h>
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <signal.h>
 
 namespace {
 
@@ -192,9 +196,748 @@ TEST(TextStream,writeTest) {
 	}
 	ASSERT_TRUE(pos==15);
 }
+
+static std::string make_text(size_t len, char first) {
+	std::string ret;
+	for(size_t i = 0; i < len; ++i) {
+		ret += (char) (first + i % 26);
+	}
+	return ret;
+}
+
+TEST(TextStream,peekSpanWrapAround) {
+	Text_stream stream(false);
+
+	bool isok = stream.open(-1, 4096);
+	EXPECT_EQ(isok, true);
+
+	std::string first = make_text(3000, 'a');
+	isok = stream.write_tail((Char_t *) first.c_str(), first.size());
+	EXPECT_EQ(isok, true);
+
+	std::string_view view = stream.peek(first.size());
+	ASSERT_EQ(view.size(), first.size());
+	EXPECT_TRUE(view == first);
+	stream.advance(view.size());
+
+	isok = stream.move_on( stream.pos_at_cursor() );
+	EXPECT_EQ(isok, true);
+
+	// the next write wraps around the end of the ring buffer
+	std::string second = make_text(3000, 'A');
+	isok = stream.write_tail((Char_t *) second.c_str(), second.size());
+	EXPECT_EQ(isok, true);
+
+	// with a mirrored buffer the view is contiguous across the wrap, otherwise it ends at the end of the buffer.
+	view = stream.peek(second.size());
+	EXPECT_TRUE(view.size() > 0 && view.size() <= second.size());
+	EXPECT_TRUE(view == std::string_view(second).substr(0, view.size()));
+
+	std::string read;
+	for(view = stream.span(); !view.empty(); view = stream.span()) {
+		read += view;
+		stream.advance(view.size());
+	}
+	EXPECT_TRUE(read == second);
+	EXPECT_EQ(stream.pos_at_cursor().buffer_pos_, (FilePos_t) (first.size() + second.size()));
+}
+
+TEST(TextStream,resizeWrapped) {
+	Text_stream stream;
+
+	bool isok = stream.open(-1, 4096);
+	EXPECT_EQ(isok, true);
+
+	std::string first = make_text(3000, 'a');
+	isok = stream.write_tail((Char_t *) first.c_str(), first.size());
+	EXPECT_EQ(isok, true);
+
+	stream.advance(2500);
+	isok = stream.move_on( stream.pos_at_cursor() );
+	EXPECT_EQ(isok, true);
+
+	// wraps around the end of the buffer, then grows the buffer while the data is wrapped.
+	std::string second = make_text(3000, 'A');
+	isok = stream.write_tail((Char_t *) second.c_str(), second.size());
+	EXPECT_EQ(isok, true);
+
+	std::string third = make_text(10000, '0');
+	isok = stream.write_tail((Char_t *) third.c_str(), third.size());
+	EXPECT_EQ(isok, true);
+
+	std::string expected = first.substr(2500) + second + third;
+	std::string read;
+	for(Text_stream::Next_char_value nch = stream.next_char(); nch.first; nch = stream.next_char()) {
+		read += (char) nch.second;
+	}
+	EXPECT_TRUE(read == expected);
+}
  
 
 
+TEST(TextStream,readCharsMmap) {
+	FILE *fp = fopen(__FILE__,"r");
+	EXPECT_TRUE(fp != NULL);
+
+	fseek(fp, 0, SEEK_END);
+	long file_size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	Text_mmap_stream stream;
+
+	bool isok = stream.open(__FILE__);
+	EXPECT_EQ(isok, true);
+	EXPECT_EQ(stream.size(), file_size);
+
+	for(long pos=0; ; ++pos) {
+			int ch = fgetc(fp);
+
+			if (pos != 0 && pos % 4096 == 0) {
+				isok = stream.move_on( stream.pos_at_cursor() );
+				ASSERT_TRUE( isok );
+			}
+
+			Text_stream::Next_char_value nch = stream.next_char();
+			if (!nch.first) {
+				ASSERT_TRUE( ch == EOF );
+				ASSERT_TRUE( pos == file_size );
+				break;
+			}
+			ASSERT_TRUE(nch.second == ch);
+	}
+	EXPECT_TRUE(stream.error() == 0);
+
+	isok = stream.close();
+	EXPECT_EQ(isok, true);
+
+	// the file is mapped again: the positions of the previous mapping are not valid
+	uint32_t generation = stream.generation();
+	isok = stream.open(__FILE__);
+	EXPECT_EQ(isok, true);
+	EXPECT_NE(stream.generation(), generation);
+	EXPECT_EQ(stream.pos_at_cursor().buffer_pos_, 0);
+
+	isok = stream.close();
+	EXPECT_EQ(isok, true);
+
+	fclose(fp);
+}
+
+static std::string make_number_file(long min_size) {
+
+	char fname[] = "/tmp/test_streamXXXXXX";
+	int fd = mkstemp(fname);
+	EXPECT_TRUE(fd != -1);
+
+	std::string line;
+	for(int i = 0; i < 1000; ++i) {
+		line += std::to_string(i) + ((i % 10 == 9) ? "\n" : " ");
+	}
+	for(long written = 0; written < min_size; written += line.size()) {
+		ssize_t rt = write(fd, line.c_str(), line.size());
+		EXPECT_EQ(rt, (ssize_t) line.size());
+	}
+	close(fd);
+	return fname;
+}
+
+TEST(TextStream,parseMmap) {
+
+	struct Numbers : PStar<1, PTokInt<2>> {};
+
+	std::string fname = make_number_file(64 * 1024);
+
+	Text_stream stream;
+	bool isok = stream.open(fname.c_str());
+	EXPECT_EQ(isok, true);
+
+	CharParser chparser(stream);
+	Parse_result res = Numbers::parse(chparser);
+	EXPECT_TRUE(res.success());
+
+	Text_mmap_stream mmap_stream;
+	isok = mmap_stream.open(fname.c_str());
+	EXPECT_EQ(isok, true);
+
+	CharStreamParser<Text_mmap_stream> mmap_parser(mmap_stream);
+	Parse_result mmap_res = Numbers::parse(mmap_parser);
+	EXPECT_TRUE(mmap_res.success());
+
+	Numbers::AstType *ast = (Numbers::AstType *) res.get_ast();
+	Numbers::AstType *mmap_ast = (Numbers::AstType *) mmap_res.get_ast();
+
+	EXPECT_TRUE(ast->entry_.size() > 0);
+	EXPECT_EQ(ast->entry_.size(), mmap_ast->entry_.size());
+	EXPECT_TRUE(res.get_end_pos() == mmap_res.get_end_pos());
+
+	unlink(fname.c_str());
+}
+
+TEST(TextStream,lineColumn) {
+
+	struct Numbers : PStar<1, PTokInt<2>> {};
+
+	std::string fname = make_number_file(16 * 1024);
+
+	// line and column of each offset in the file
+	std::vector<Line_column> expected;
+	FILE *fp = fopen(fname.c_str(), "r");
+	EXPECT_TRUE(fp != NULL);
+
+	int line = 1, column = 0;
+	for(int ch = fgetc(fp); ch != EOF; ch = fgetc(fp)) {
+		expected.push_back( Line_column(line, column) );
+		if (ch == '\n') {
+			++line;
+			column = 0;
+		} else {
+			++column;
+		}
+	}
+	fclose(fp);
+
+	// the offsets are looked up after the parse, the whole line index is kept
+	Text_stream stream;
+	stream.keep_line_index(true);
+	bool isok = stream.open(fname.c_str());
+	EXPECT_EQ(isok, true);
+
+	CharParser chparser(stream);
+	Parse_result res = Numbers::parse(chparser);
+	EXPECT_TRUE(res.success());
+
+	Text_mmap_stream mmap_stream;
+	isok = mmap_stream.open(fname.c_str());
+	EXPECT_EQ(isok, true);
+
+	CharStreamParser<Text_mmap_stream> mmap_parser(mmap_stream);
+	Parse_result mmap_res = Numbers::parse(mmap_parser);
+	EXPECT_TRUE(mmap_res.success());
+
+	Numbers::AstType *ast = (Numbers::AstType *) res.get_ast();
+	EXPECT_TRUE(ast->entry_.size() > 0);
+
+	for(auto &entry : ast->entry_) {
+		FilePos_t start = entry->get_start_pos().offset();
+		FilePos_t end = entry->get_end_pos().offset();
+
+		ASSERT_TRUE(end < (FilePos_t) expected.size());
+		EXPECT_TRUE(stream.line_column(start) == expected[ start ]);
+		EXPECT_TRUE(stream.line_column(end) == expected[ end ]);
+		EXPECT_TRUE(mmap_stream.line_column(start) == expected[ start ]);
+	}
+
+	// lookups in reverse order (the line of the last lookup is cached)
+	for(FilePos_t pos = (FilePos_t) expected.size() - 1; pos >= 0; pos -= 7) {
+		EXPECT_TRUE(stream.line_column(pos) == expected[ pos ]);
+		EXPECT_TRUE(mmap_stream.line_column(pos) == expected[ pos ]);
+	}
+
+	unlink(fname.c_str());
+}
+
+TEST(TextStream,lineIndexBounded) {
+
+	// a record per line, each record is looked up while it's after the head of the stream
+	struct Record : PSeq<1, PTokInt<2>, PTok<3, CSTR1(";")> > {};
+
+	const int num_lines = 100000;
+	std::string text;
+	for(int i = 0; i < num_lines; ++i) {
+		text += std::to_string(i) + ";\n";
+	}
+
+	Text_stream stream;
+	bool isok = stream.open(-1);
+	EXPECT_EQ(isok, true);
+
+	CharParser chparser(stream);
+	size_t max_entries = 0;
+	int line = 1;
+	size_t pos = 0;
+	while(pos < text.size()) {
+		// the text is added in pieces, as it arrives
+		size_t len = std::min( (size_t) 1000, text.size() - pos );
+		isok = stream.write_tail(text.c_str() + pos, len);
+		EXPECT_EQ(isok, true);
+		pos += len;
+
+		for(;;) {
+			Parse_result res = Record::parse(chparser);
+			if (!res.success()) {
+				break;
+			}
+			Line_column start = stream.line_column(res.get_start_pos().offset());
+			EXPECT_EQ(start.line(), line);
+			EXPECT_EQ(start.column(), 0);
+			line += 1;
+			PCut::parse(chparser);
+			max_entries = std::max(max_entries, stream.line_index_entries());
+		}
+	}
+	EXPECT_EQ(line, num_lines + 1);
+
+	// the newlines before the head have been dropped
+	EXPECT_TRUE(max_entries < 4096);
+	EXPECT_EQ(stream.line_column(0).line(), 0);
+}
+
+TEST(TextStream,readAhead) {
+
+	struct Numbers : PStar<1, PTokInt<2>> {};
+
+	std::string fname = make_number_file(1024 * 1024);
+
+	Text_stream stream;
+	bool isok = stream.open(fname.c_str());
+	EXPECT_EQ(isok, true);
+
+	CharParser chparser(stream);
+	Parse_result res = Numbers::parse(chparser);
+	EXPECT_TRUE(res.success());
+
+	// small segments, so that the parser has to switch between the segments many times
+	Text_stream ra_stream;
+	isok = ra_stream.open(fname.c_str());
+	EXPECT_EQ(isok, true);
+	isok = ra_stream.start_read_ahead(1000);
+	EXPECT_EQ(isok, true);
+
+	CharParser ra_parser(ra_stream);
+	Parse_result ra_res = Numbers::parse(ra_parser);
+	EXPECT_TRUE(ra_res.success());
+
+	Numbers::AstType *ast = (Numbers::AstType *) res.get_ast();
+	Numbers::AstType *ra_ast = (Numbers::AstType *) ra_res.get_ast();
+
+	EXPECT_TRUE(ast->entry_.size() > 0);
+	EXPECT_EQ(ast->entry_.size(), ra_ast->entry_.size());
+	EXPECT_TRUE(res.get_end_pos() == ra_res.get_end_pos());
+	EXPECT_TRUE(ra_stream.error() == 0);
+
+	Read_ahead_stats stats = ra_stream.read_ahead_stats();
+	struct stat st;
+	stat(fname.c_str(), &st);
+	EXPECT_EQ(stats.bytes_read_, (size_t) st.st_size);
+
+	isok = ra_stream.close();
+	EXPECT_EQ(isok, true);
+
+	unlink(fname.c_str());
+}
+
+TEST(TextStream,readAheadPipe) {
+
+	struct Numbers : PStar<1, PTokInt<2>> {};
+
+	// the input is a pipe, the text is written in pieces
+	int fds[2];
+	EXPECT_EQ(pipe(fds), 0);
+
+	Text_stream stream;
+	bool isok = stream.open(fds[0]);
+	EXPECT_EQ(isok, true);
+	isok = stream.start_read_ahead();
+	EXPECT_EQ(isok, true);
+
+	std::thread writer( [&fds]() {
+		for(int i = 0; i < 1000; ++i) {
+			std::string text = std::to_string(i) + "\n";
+			EXPECT_EQ(write(fds[1], text.data(), text.size()), (ssize_t) text.size());
+		}
+		close(fds[1]);
+	});
+
+	CharParser chparser(stream);
+	Parse_result res = Numbers::parse(chparser);
+	writer.join();
+
+	EXPECT_TRUE(res.success());
+	EXPECT_EQ(((Numbers::AstType *) res.get_ast())->entry_.size(), (size_t) 1000);
+	EXPECT_TRUE(stream.close());
+
+	// the read-ahead thread waits for input that doesn't come: it is woken up when the stream is closed
+	EXPECT_EQ(pipe(fds), 0);
+
+	Text_stream idle_stream;
+	isok = idle_stream.open(fds[0]);
+	EXPECT_EQ(isok, true);
+	isok = idle_stream.start_read_ahead();
+	EXPECT_EQ(isok, true);
+
+	std::this_thread::sleep_for( std::chrono::milliseconds(10) );
+	EXPECT_TRUE(idle_stream.close());
+	close(fds[1]);
+}
+
+static void on_signal(int) {
+}
+
+TEST(TextStream,readInterrupted) {
+
+	struct Numbers : PStar<1, PTokInt<2>> {};
+
+	// the read from the pipe is interrupted by a signal (without SA_RESTART) before the text is written: the read is retried.
+	struct sigaction action, old_action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = on_signal;
+	EXPECT_EQ(sigaction(SIGUSR1, &action, &old_action), 0);
+
+	int fds[2];
+	EXPECT_EQ(pipe(fds), 0);
+
+	Text_stream stream;
+	bool isok = stream.open(fds[0]);
+	EXPECT_EQ(isok, true);
+
+	pthread_t reader = pthread_self();
+	std::thread writer( [&fds, reader]() {
+		std::this_thread::sleep_for( std::chrono::milliseconds(20) );
+		pthread_kill(reader, SIGUSR1);
+		std::this_thread::sleep_for( std::chrono::milliseconds(20) );
+
+		std::string text = "1 2 3";
+		EXPECT_EQ(write(fds[1], text.data(), text.size()), (ssize_t) text.size());
+		close(fds[1]);
+	});
+
+	CharParser chparser(stream);
+	Parse_result res = Numbers::parse(chparser);
+	writer.join();
+
+	EXPECT_TRUE(res.success());
+	EXPECT_EQ(((Numbers::AstType *) res.get_ast())->entry_.size(), (size_t) 3);
+	EXPECT_EQ(stream.error(), 0);
+	EXPECT_TRUE(stream.close());
+
+	EXPECT_EQ(sigaction(SIGUSR1, &old_action, nullptr), 0);
+	errno = 0;
+}
+
+TEST(TextStream,memoryStream) {
+
+	struct Numbers : PStar<1, PTokInt<2>> {};
+
+	std::string text = "12 345\n 6789 0 1\n22";
+
+	Text_stream stream;
+	bool isok = stream.open(-1);
+	EXPECT_EQ(isok, true);
+	isok = stream.write_tail(text.c_str(), text.size());
+	EXPECT_EQ(isok, true);
+
+	CharParser chparser(stream);
+	Parse_result res = Numbers::parse(chparser);
+	EXPECT_TRUE(res.success());
+
+	Text_memory_stream mem_stream(text);
+	MemoryCharParser mem_parser(mem_stream);
+	Parse_result mem_res = Numbers::parse(mem_parser);
+	EXPECT_TRUE(mem_res.success());
+
+	std::stringstream sout, mem_sout;
+	Numbers::dumpJson(sout, (Numbers::AstType *) res.get_ast());
+	Numbers::dumpJson(mem_sout, (Numbers::AstType *) mem_res.get_ast());
+	EXPECT_EQ(sout.str(), mem_sout.str());
+	EXPECT_TRUE(res.get_end_pos() == mem_res.get_end_pos());
+
+	// the text is not copied
+	EXPECT_TRUE(mem_stream.data() == text.c_str());
+	EXPECT_TRUE(mem_stream.line_column(mem_res.get_end_pos().offset()) == stream.line_column(res.get_end_pos().offset()));
+	EXPECT_EQ(mem_stream.line_column(mem_res.get_end_pos().offset()).line(), 3);
+
+	// can't go back before the head
+	mem_stream.move_on( mem_stream.pos_at_cursor() );
+	EXPECT_FALSE(mem_stream.seek(Text_position()));
+}
+
+TEST(TextStream,skipCache) {
+
+	struct Int : PTokInt<1> {};
+
+	// the second number is tried at the end of the available text, then the whitespace before it is written.
+	Text_stream stream;
+	bool isok = stream.open(-1);
+	EXPECT_EQ(isok, true);
+	isok = stream.write_tail("1", 1);
+	EXPECT_EQ(isok, true);
+
+	CharParser chparser(stream);
+	EXPECT_TRUE(Int::parse(chparser).success());
+	EXPECT_FALSE(Int::parse(chparser).success());
+
+	isok = stream.write_tail("   2", 4);
+	EXPECT_EQ(isok, true);
+	Parse_result res = Int::parse(chparser);
+	EXPECT_TRUE(res.success());
+	EXPECT_EQ(res.get_start_pos().offset(), 4);
+
+	// the stream is opened again with another text, the skipped run of the first text is not used.
+	Text_memory_stream mem_stream;
+	mem_stream.open("1   234", 7);
+	MemoryCharParser mem_parser(mem_stream);
+	EXPECT_TRUE(Int::parse(mem_parser).success());
+	EXPECT_EQ(Int::parse(mem_parser).get_start_pos().offset(), 4);
+
+	mem_stream.open("1 234", 5, 1);
+	res = Int::parse(mem_parser);
+	EXPECT_TRUE(res.success());
+	EXPECT_EQ(res.get_start_pos().offset(), 2);
+	EXPECT_EQ(res.get_end_pos().offset(), 4);
+}
+
+TEST(TextStream,benchmarkMemoryStream) {
+
+	struct Numbers : PStar<1, PTokInt<2>> {};
+
+	const int num_messages = 100000;
+	std::string message = "1 22 333 4444 55555";
+
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < num_messages; ++i) {
+		Text_stream stream;
+		stream.open(-1);
+		stream.write_tail(message.c_str(), message.size());
+
+		CharParser chparser(stream);
+		Parse_result res = Numbers::parse(chparser);
+		EXPECT_TRUE(res.success());
+	}
+	auto end = std::chrono::steady_clock::now();
+	double copy_secs = std::chrono::duration<double>(end - start).count();
+
+	start = std::chrono::steady_clock::now();
+	for(int i = 0; i < num_messages; ++i) {
+		Text_memory_stream stream(message);
+
+		MemoryCharParser chparser(stream);
+		Parse_result res = Numbers::parse(chparser);
+		EXPECT_TRUE(res.success());
+	}
+	end = std::chrono::steady_clock::now();
+	double mem_secs = std::chrono::duration<double>(end - start).count();
+
+	printf("%d messages: Text_stream with write_tail %.3f s, Text_memory_stream %.3f s\n", num_messages, copy_secs, mem_secs);
+}
+
+TEST(TextStream,pagedStream) {
+
+	struct Numbers : PStar<1, PTokInt<2>> {};
+
+	std::string fname = make_number_file(256 * 1024);
+
+	Text_stream stream;
+	bool isok = stream.open(fname.c_str());
+	EXPECT_EQ(isok, true);
+
+	CharParser chparser(stream);
+	Parse_result res = Numbers::parse(chparser);
+	EXPECT_TRUE(res.success());
+
+	// small pages, numbers cross the page boundaries
+	Text_page_pool pool(1000);
+	EXPECT_EQ(pool.page_size(), (uint32_t) 1024);
+
+	Text_paged_stream paged_stream(&pool);
+	isok = paged_stream.open(fname.c_str());
+	EXPECT_EQ(isok, true);
+
+	PagedCharParser paged_parser(paged_stream);
+	Parse_result paged_res = Numbers::parse(paged_parser);
+	EXPECT_TRUE(paged_res.success());
+
+	std::stringstream sout, paged_sout;
+	Numbers::dumpJson(sout, (Numbers::AstType *) res.get_ast());
+	Numbers::dumpJson(paged_sout, (Numbers::AstType *) paged_res.get_ast());
+	EXPECT_TRUE(sout.str() == paged_sout.str());
+	EXPECT_TRUE(paged_stream.line_column(paged_res.get_end_pos().offset()) == stream.line_column(res.get_end_pos().offset()));
+
+	// the whole file is in the lookahead buffer, move_on returns the pages to the pool
+	EXPECT_TRUE(paged_stream.num_pages() >= 256);
+	size_t allocated = pool.allocated();
+
+	paged_stream.move_on( paged_stream.pos_at_cursor() );
+	EXPECT_TRUE(paged_stream.num_pages() <= 1);
+
+	paged_stream.close();
+	isok = paged_stream.open(fname.c_str());
+	EXPECT_EQ(isok, true);
+
+	// pages are reused
+	paged_res = Numbers::parse(paged_parser);
+	EXPECT_TRUE(paged_res.success());
+	EXPECT_EQ(pool.allocated(), allocated);
+
+	unlink(fname.c_str());
+}
+
+TEST(TextStream,pagedStreamPeek) {
+
+	Text_page_pool pool(16);
+	Text_paged_stream stream(&pool);
+
+	bool isok = stream.open(-1);
+	EXPECT_EQ(isok, true);
+
+	std::string text = make_text(100, 'a');
+	isok = stream.write_tail(text.c_str(), text.size());
+	EXPECT_EQ(isok, true);
+
+	stream.advance(10);
+
+	// within the page, and across page boundaries
+	EXPECT_TRUE(stream.peek(6) == text.substr(10, 6));
+	EXPECT_TRUE(stream.peek(40) == text.substr(10, 40));
+	EXPECT_TRUE(stream.peek(200) == text.substr(10));
+	EXPECT_EQ(stream.span().size(), (size_t) 6);
+
+	std::string read;
+	for(std::string_view view = stream.span(); !view.empty(); view = stream.span()) {
+		read += view;
+		stream.advance(view.size());
+	}
+	EXPECT_TRUE(read == text.substr(10));
+
+	// backtracking across pages
+	Text_position pos;
+	pos.buffer_pos_ = 20;
+	EXPECT_TRUE(stream.seek(pos));
+	EXPECT_EQ(stream.next_char().second, text[20]);
+}
+
+TEST(TextStream,benchmarkPagedStream) {
+
+	// the whole input is kept in the lookahead buffer, as if parsing a single rule that spans the whole input
+	std::string fname = make_number_file(4 * 1024 * 1024);
+	struct stat st;
+	stat(fname.c_str(), &st);
+
+	for(int paged = 0; paged < 2; ++paged) {
+		Text_stream stream;
+		Text_paged_stream paged_stream;
+
+		bool isok = paged ? paged_stream.open(fname.c_str()) : stream.open(fname.c_str());
+		EXPECT_EQ(isok, true);
+
+		auto start = std::chrono::steady_clock::now();
+		long sum = 0, pos;
+		for(pos = 0; ; ++pos) {
+			Text_stream::Next_char_value nch = paged ? paged_stream.next_char() : stream.next_char();
+			if (!nch.first) {
+				break;
+			}
+			sum += nch.second;
+		}
+		auto end = std::chrono::steady_clock::now();
+		EXPECT_EQ(pos, st.st_size);
+		EXPECT_TRUE(sum > 0);
+
+		printf("%s: lookahead of %ld bytes %.3f s\n", paged ? "Text_paged_stream" : "Text_stream", (long) st.st_size, std::chrono::duration<double>(end - start).count());
+	}
+
+	unlink(fname.c_str());
+}
+
+TEST(TextStream,benchmarkReadAhead) {
+
+	std::string fname = make_number_file(32 * 1024 * 1024);
+	struct stat st;
+	stat(fname.c_str(), &st);
+	double mbytes = st.st_size / (1024.0 * 1024.0);
+
+	for(int read_ahead = 0; read_ahead < 2; ++read_ahead) {
+
+		Text_stream stream;
+		bool isok = stream.open(fname.c_str(), 64 * 1024);
+		EXPECT_EQ(isok, true);
+		if (read_ahead) {
+			isok = stream.start_read_ahead();
+			EXPECT_EQ(isok, true);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		long sum = 0, pos;
+		for(pos = 0; ; ++pos) {
+			if (pos % 4096 == 0) {
+				stream.move_on( stream.pos_at_cursor() );
+			}
+			Text_stream::Next_char_value nch = stream.next_char();
+			if (!nch.first) {
+				break;
+			}
+			sum += nch.second;
+		}
+		auto end = std::chrono::steady_clock::now();
+		EXPECT_EQ(pos, st.st_size);
+		EXPECT_TRUE(sum > 0);
+
+		double secs = std::chrono::duration<double>(end - start).count();
+		printf("%s: %.1f MB/s\n", read_ahead ? "read-ahead" : "readv", mbytes / secs);
+
+		if (read_ahead) {
+			Read_ahead_stats stats = stream.read_ahead_stats();
+			printf("read-ahead: blocked on input %.3f s (%ld waits) parsing %.3f s, read system calls %.3f s\n", stats.blocked_secs_, (long) stats.waits_, stats.parse_secs_, stats.read_secs_);
+		}
+	}
+
+	unlink(fname.c_str());
+}
+
+TEST(TextStream,benchmarkMmap) {
+
+	std::string fname = make_number_file(32 * 1024 * 1024);
+	struct stat st;
+	stat(fname.c_str(), &st);
+	double mbytes = st.st_size / (1024.0 * 1024.0);
+
+	Text_stream stream;
+	bool isok = stream.open(fname.c_str(), 64 * 1024);
+	EXPECT_EQ(isok, true);
+
+	auto start = std::chrono::steady_clock::now();
+	long sum = 0, pos;
+	for(pos = 0; ; ++pos) {
+		if (pos % 4096 == 0) {
+			stream.move_on( stream.pos_at_cursor() );
+		}
+		Text_stream::Next_char_value nch = stream.next_char();
+		if (!nch.first) {
+			break;
+		}
+		sum += nch.second;
+	}
+	auto end = std::chrono::steady_clock::now();
+	EXPECT_EQ(pos, st.st_size);
+
+	double read_secs = std::chrono::duration<double>(end - start).count();
+
+	Text_mmap_stream mmap_stream;
+	isok = mmap_stream.open(fname.c_str());
+	EXPECT_EQ(isok, true);
+
+	start = std::chrono::steady_clock::now();
+	long mmap_sum = 0;
+	for(pos = 0; ; ++pos) {
+		if (pos % 4096 == 0) {
+			mmap_stream.move_on( mmap_stream.pos_at_cursor() );
+		}
+		Text_stream::Next_char_value nch = mmap_stream.next_char();
+		if (!nch.first) {
+			break;
+		}
+		mmap_sum += nch.second;
+	}
+	end = std::chrono::steady_clock::now();
+	EXPECT_EQ(pos, st.st_size);
+	EXPECT_EQ(sum, mmap_sum);
+
+	double mmap_secs = std::chrono::duration<double>(end - start).count();
+
+	printf("readv stream: %.1f MB/s mmap stream: %.1f MB/s\n", mbytes / read_secs, mbytes / mmap_secs);
+
+	unlink(fname.c_str());
+}
+
 } // namespace
 
 